@@ -0,0 +1,1054 @@
+/*
+ * consoleprofile.c - compile and apply console profiles
+ *
+ * A profile bundles the keymap, font, Unicode map, screen map and palette
+ * of a console in a single file, so that they can be applied with one read
+ * of the profile and without parsing any of the source files again.
+ *
+ * This file is part of kbd project.
+ *
+ * This file is covered by the GNU General Public License,
+ * which should be included with kbd as the file COPYING.
+ */
+#include "config.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include <getopt.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <errno.h>
+#include <sysexits.h>
+#include <sys/ioctl.h>
+#include <poll.h>
+#include <linux/kd.h>
+#include <linux/vt.h>
+
+#include <keymap.h>
+#include <kfont.h>
+
+#include "libcommon.h"
+
+/*
+ * Profile layout (native byte order, it is not meant to be portable):
+ *
+ *   struct profile_header
+ *   nr_sections x { struct profile_section; char data[size]; }
+ *
+ * Section data:
+ *
+ *   PROFILE_KEYMAP:  struct profile_keymap
+ *                    nr_keys   x struct profile_key
+ *                    nr_funcs  x { struct profile_func; char string[len]; }
+ *                    nr_diacrs x struct profile_diacr
+ *   PROFILE_FONT:    struct profile_font; glyphs as returned by KDFONTOP
+ *   PROFILE_UNIMAP:  uint32_t count; count x struct unipair
+ *   PROFILE_SCRNMAP: uint16_t map[E_TABSZ]
+ *   PROFILE_PALETTE: uint8_t cmap[3 * 16]
+ *
+ * Each section appears at most once. Whatever their order in the file, the
+ * sections are applied in the order above.
+ */
+#define PROFILE_MAGIC   "kbdprof"
+#define PROFILE_VERSION 1
+
+enum profile_section_type {
+	PROFILE_KEYMAP = 1,
+	PROFILE_FONT,
+	PROFILE_UNIMAP,
+	PROFILE_SCRNMAP,
+	PROFILE_PALETTE,
+	PROFILE_MAX_SECTION
+};
+
+struct profile_header {
+	char magic[7];
+	uint8_t version;
+	uint32_t nr_sections;
+};
+
+struct profile_section {
+	uint32_t type;
+	uint32_t size;
+};
+
+struct profile_keymap {
+	uint32_t flags;
+	uint32_t keywords;
+	uint32_t nr_keys;
+	uint32_t nr_funcs;
+	uint32_t nr_diacrs;
+	uint8_t maps[MAX_NR_KEYMAPS / 8];
+};
+
+struct profile_key {
+	uint16_t table;
+	uint16_t index;
+	uint16_t value;
+};
+
+struct profile_func {
+	uint16_t func;
+	uint16_t len;
+};
+
+struct profile_diacr {
+	uint32_t diacr;
+	uint32_t base;
+	uint32_t result;
+};
+
+struct profile_font {
+	uint32_t count;
+	uint32_t width;
+	uint32_t height;
+	uint32_t vpitch;
+};
+
+#define ACTIVE_VT "/sys/class/tty/tty0/active"
+
+static const struct kfont_console_ops fake_console_ops = {
+	.ioctl = kbd_fake_console_ioctl,
+};
+
+static const struct lk_console_ops fake_keymap_ops = {
+	.ioctl = kbd_fake_console_ioctl,
+};
+
+/* The emulated console of a dry run, NULL when the real one is used. */
+static struct kbd_fake_console *emulated;
+
+static int
+console_ioctl(int fd, unsigned long request, void *arg)
+{
+	if (emulated)
+		return kbd_fake_console_ioctl(emulated, fd, request, (unsigned long) arg);
+	return ioctl(fd, request, arg);
+}
+
+static void KBD_ATTR_NORETURN
+usage(int rc, const struct kbd_help *options)
+{
+	fprintf(stderr, _("Usage: %s [option...] -o profile\n"
+	                  "   or: %s [-C DEV] [-w] profile\n"
+	                  "   or: %s -n [-o output] profile\n"),
+	        get_progname(), get_progname(), get_progname());
+	fprintf(stderr, "\n");
+	fprintf(stderr, _("Compiles a keymap, a console font, a Unicode map, a screen map\n"
+	                  "and a palette into a console profile, or applies a profile to\n"
+	                  "the console.\n"));
+
+	print_options(options);
+	print_report_bugs();
+
+	exit(rc);
+}
+
+/* Output buffer, the profile is written with a single write. */
+struct buffer {
+	unsigned char *data;
+	size_t len;
+	size_t size;
+};
+
+static void
+buf_append(struct buffer *b, const void *data, size_t len)
+{
+	if (b->len + len > b->size) {
+		size_t size = b->size ? b->size : 4096;
+
+		while (size < b->len + len)
+			size *= 2;
+
+		if (!(b->data = realloc(b->data, size)))
+			kbd_error(EXIT_FAILURE, errno, "realloc");
+
+		b->size = size;
+	}
+
+	memcpy(b->data + b->len, data, len);
+	b->len += len;
+}
+
+static size_t
+begin_section(struct buffer *b, uint32_t type)
+{
+	struct profile_section sec = { .type = type, .size = 0 };
+	size_t offset = b->len;
+
+	buf_append(b, &sec, sizeof(sec));
+	return offset;
+}
+
+static void
+end_section(struct buffer *b, size_t offset)
+{
+	struct profile_section sec;
+
+	memcpy(&sec, b->data + offset, sizeof(sec));
+	sec.size = (uint32_t) (b->len - offset - sizeof(sec));
+	memcpy(b->data + offset, &sec, sizeof(sec));
+}
+
+static void
+compile_keymap(struct buffer *b, struct lk_ctx *ctx)
+{
+	struct profile_keymap pk;
+	struct profile_key key;
+	struct profile_func func;
+	struct profile_diacr pd;
+	struct kmapinfo info;
+	struct kbsentry kbs;
+	struct lk_kbdiacr dcr;
+	size_t offset, head;
+	int i, j, value;
+
+	memset(&pk, 0, sizeof(pk));
+
+	lk_get_kmapinfo(ctx, &info);
+
+	pk.flags    = (uint32_t) info.flags;
+	pk.keywords = (uint32_t) info.keywords;
+
+	offset = begin_section(b, PROFILE_KEYMAP);
+	head   = b->len;
+	buf_append(b, &pk, sizeof(pk));
+
+	for (i = 0; i < MAX_NR_KEYMAPS; i++) {
+		if (!lk_map_exists(ctx, i))
+			continue;
+
+		pk.maps[i / 8] |= (uint8_t) (1 << (i % 8));
+
+		for (j = 0; j < NR_KEYS; j++) {
+			if (!lk_key_exists(ctx, i, j))
+				continue;
+
+			value = lk_get_key(ctx, i, j);
+
+			if (value < 0 || value > UINT16_MAX) {
+				kbd_warning(0, _("can not bind key %d to value %d because it is too large"),
+				            j, value);
+				continue;
+			}
+
+			key.table = (uint16_t) i;
+			key.index = (uint16_t) j;
+			key.value = (uint16_t) value;
+
+			buf_append(b, &key, sizeof(key));
+			pk.nr_keys++;
+		}
+	}
+
+	for (i = 0; i < MAX_NR_FUNC; i++) {
+		if (!lk_func_exists(ctx, i))
+			continue;
+
+		kbs.kb_func = (unsigned char) i;
+
+		if (lk_get_func(ctx, &kbs) < 0)
+			kbd_error(EXIT_FAILURE, 0, _("Unable to get function key string %d"), i);
+
+		func.func = (uint16_t) i;
+		func.len  = (uint16_t) strlen((char *) kbs.kb_string);
+
+		buf_append(b, &func, sizeof(func));
+		buf_append(b, kbs.kb_string, func.len);
+		pk.nr_funcs++;
+	}
+
+	for (i = 0; i < info.composes_total; i++) {
+		if (!lk_diacr_exists(ctx, i))
+			continue;
+
+		if (lk_get_diacr(ctx, i, &dcr) < 0)
+			kbd_error(EXIT_FAILURE, 0, _("Unable to get compose definition %d"), i);
+
+		pd.diacr  = dcr.diacr;
+		pd.base   = dcr.base;
+		pd.result = dcr.result;
+
+		buf_append(b, &pd, sizeof(pd));
+		pk.nr_diacrs++;
+	}
+
+	/* the counters are known only now */
+	memcpy(b->data + head, &pk, sizeof(pk));
+
+	end_section(b, offset);
+}
+
+static void
+compile_font(struct buffer *b, struct kfont_context *kfont)
+{
+	struct profile_font pf;
+	unsigned char *buf;
+	unsigned int count, width, height, vpitch;
+	size_t offset;
+
+	if (!(buf = malloc(MAXFONTSIZE)))
+		kbd_error(EXIT_FAILURE, errno, "malloc");
+
+	count = MAXFONTSIZE / (64 * 128 / 8); /* max size 64x128, 8 bits/byte */
+
+	if (kfont_get_font(kfont, 0, buf, &count, &width, &height, &vpitch) < 0)
+		kbd_error(EXIT_FAILURE, 0, _("Unable to get the font"));
+
+	pf.count  = count;
+	pf.width  = width;
+	pf.height = height;
+	pf.vpitch = vpitch;
+
+	offset = begin_section(b, PROFILE_FONT);
+	buf_append(b, &pf, sizeof(pf));
+	buf_append(b, buf, (size_t) count * vpitch * ((width + 7) / 8));
+	end_section(b, offset);
+
+	free(buf);
+}
+
+static void
+compile_unimap(struct buffer *b, struct kfont_context *kfont)
+{
+	struct unimapdesc ud;
+	uint32_t count;
+	size_t offset;
+
+	if (kfont_get_unicodemap(kfont, 0, &ud) < 0)
+		kbd_error(EXIT_FAILURE, 0, _("Unable to get the Unicode mapping table"));
+
+	count = ud.entry_ct;
+
+	offset = begin_section(b, PROFILE_UNIMAP);
+	buf_append(b, &count, sizeof(count));
+	buf_append(b, ud.entries, count * sizeof(struct unipair));
+	end_section(b, offset);
+
+	free(ud.entries);
+}
+
+static void
+compile_scrnmap(struct buffer *b, struct kfont_context *kfont)
+{
+	unsigned short map[E_TABSZ];
+	size_t offset;
+
+	if (kfont_get_uniscrnmap(kfont, 0, map) < 0)
+		kbd_error(EXIT_FAILURE, 0, _("Unable to get the screen map"));
+
+	offset = begin_section(b, PROFILE_SCRNMAP);
+	buf_append(b, map, sizeof(map));
+	end_section(b, offset);
+}
+
+static void
+compile_palette(struct buffer *b, int fd)
+{
+	unsigned char cmap[3 * 16];
+	size_t offset;
+
+	if (console_ioctl(fd, GIO_CMAP, cmap) == -1)
+		kbd_error(EXIT_FAILURE, errno, _("Unable to get the palette"));
+
+	offset = begin_section(b, PROFILE_PALETTE);
+	buf_append(b, cmap, sizeof(cmap));
+	end_section(b, offset);
+}
+
+static void
+load_palette(const char *filename)
+{
+	unsigned char cmap[3 * 16];
+	FILE *f;
+
+	if (!strcmp(filename, "vga")) {
+		memcpy(cmap, kbd_vga_colors, sizeof(cmap));
+	} else {
+		if ((f = fopen(filename, "r")) == NULL)
+			kbd_error(EXIT_FAILURE, errno, _("Unable to open file: %s"), filename);
+
+		kbd_parse_vtrgb(f, filename, cmap);
+		fclose(f);
+	}
+
+	if (console_ioctl(0, PIO_CMAP, cmap) == -1)
+		kbd_error(EXIT_FAILURE, errno, "ioctl");
+}
+
+#define HAS_SECTION(sections, type) ((sections) & (1U << (type)))
+
+/*
+ * Writes the profile. The keymap section is taken from keymap, the raw
+ * keymap section when it is NULL, and the other sections listed in
+ * sections are read from the emulated console.
+ */
+static void
+write_profile(const char *output, struct lk_ctx *ctx,
+              const unsigned char *keymap, size_t keymap_size,
+              struct kfont_context *kfont, unsigned int sections)
+{
+	struct profile_header hdr;
+	struct profile_section sec;
+	struct buffer b = { NULL, 0, 0 };
+	FILE *f;
+
+	memset(&hdr, 0, sizeof(hdr));
+	memcpy(hdr.magic, PROFILE_MAGIC, sizeof(hdr.magic));
+	hdr.version = PROFILE_VERSION;
+
+	buf_append(&b, &hdr, sizeof(hdr));
+
+	if (ctx) {
+		compile_keymap(&b, ctx);
+		hdr.nr_sections++;
+	} else if (keymap) {
+		sec.type = PROFILE_KEYMAP;
+		sec.size = (uint32_t) keymap_size;
+
+		buf_append(&b, &sec, sizeof(sec));
+		buf_append(&b, keymap, keymap_size);
+		hdr.nr_sections++;
+	}
+
+	if (HAS_SECTION(sections, PROFILE_FONT)) {
+		compile_font(&b, kfont);
+		hdr.nr_sections++;
+	}
+
+	if (HAS_SECTION(sections, PROFILE_UNIMAP)) {
+		compile_unimap(&b, kfont);
+		hdr.nr_sections++;
+	}
+
+	if (HAS_SECTION(sections, PROFILE_SCRNMAP)) {
+		compile_scrnmap(&b, kfont);
+		hdr.nr_sections++;
+	}
+
+	if (HAS_SECTION(sections, PROFILE_PALETTE)) {
+		compile_palette(&b, 0);
+		hdr.nr_sections++;
+	}
+
+	memcpy(b.data, &hdr, sizeof(hdr));
+
+	if ((f = fopen(output, "w")) == NULL)
+		kbd_error(EXIT_FAILURE, errno, _("Unable to open file: %s"), output);
+
+	if (fwrite(b.data, 1, b.len, f) != b.len || fclose(f))
+		kbd_error(EXIT_FAILURE, errno, _("Unable to write file: %s"), output);
+
+	free(b.data);
+}
+
+static void
+use_emulated_console(struct lk_ctx *ctx, struct kfont_context *kfont)
+{
+	if ((emulated = kbd_fake_console_new()) == NULL)
+		kbd_error(EXIT_FAILURE, errno, "kbd_fake_console_new");
+
+	lk_set_console_ops(ctx, &fake_keymap_ops, emulated);
+	kfont_set_console_ops(kfont, &fake_console_ops, emulated);
+}
+
+static void
+drop_emulated_console(struct lk_ctx *ctx, struct kfont_context *kfont)
+{
+	lk_set_console_ops(ctx, NULL, NULL);
+	kfont_set_console_ops(kfont, NULL, NULL);
+
+	kbd_fake_console_free(emulated);
+	emulated = NULL;
+}
+
+static int
+compile_profile(struct lk_ctx *ctx, struct kfont_context *kfont,
+                const char *output, const char *keymap,
+                const char *const *fonts, int nfonts,
+                const char *unimap, const char *scrnmap, const char *palette)
+{
+	struct kbdfile_ctx *fctx;
+	struct kbdfile *fp;
+	unsigned int sections = 0;
+	int rc;
+
+	if (keymap) {
+		if (!(fctx = kbdfile_context_new()))
+			kbd_error(EXIT_FAILURE, errno, _("Unable to create kbdfile context"));
+
+		if (!(fp = kbdfile_new(fctx)))
+			kbd_error(EXIT_FAILURE, 0, _("Unable to create kbdfile instance: %m"));
+
+		if (kbdfile_find(keymap, kbd_keymap_dirpath(), kbd_keymap_suffixes, fp))
+			kbd_error(EXIT_FAILURE, 0, _("Unable to find file: %s"), keymap);
+
+		rc = lk_parse_keymap(ctx, fp);
+
+		kbdfile_free(fp);
+		kbdfile_context_free(fctx);
+
+		if (rc < 0)
+			return -1;
+	}
+
+	/*
+	 * The font, the maps and the palette are loaded into an emulated
+	 * console and read back, so the profile gets them in the form the
+	 * kernel takes.
+	 */
+	use_emulated_console(ctx, kfont);
+
+	if (nfonts && kfont_load_fonts(kfont, 0, fonts, nfonts, 0, 0, 0, unimap != NULL) < 0)
+		return -1;
+
+	if (unimap && kfont_load_unicodemap(kfont, 0, unimap) < 0)
+		return -1;
+
+	if (scrnmap && kfont_load_consolemap(kfont, 0, scrnmap) < 0)
+		return -1;
+
+	if (palette)
+		load_palette(palette);
+
+	if (nfonts)
+		sections |= 1U << PROFILE_FONT;
+
+	/*
+	 * Loading a font replaces the Unicode map of the console: with the
+	 * table of the font, or with an empty one. The profile keeps the map
+	 * the console ended up with.
+	 */
+	if (nfonts || unimap)
+		sections |= 1U << PROFILE_UNIMAP;
+
+	if (scrnmap)
+		sections |= 1U << PROFILE_SCRNMAP;
+
+	if (palette)
+		sections |= 1U << PROFILE_PALETTE;
+
+	write_profile(output, keymap ? ctx : NULL, NULL, 0, kfont, sections);
+
+	drop_emulated_console(ctx, kfont);
+	return 0;
+}
+
+/* Reads the profile, all its sections are checked before anything is applied. */
+struct cursor {
+	const unsigned char *data;
+	size_t left;
+};
+
+static int
+take(struct cursor *c, void *dst, size_t len)
+{
+	if (len > c->left)
+		return -1;
+
+	if (dst)
+		memcpy(dst, c->data, len);
+
+	c->data += len;
+	c->left -= len;
+	return 0;
+}
+
+struct profile {
+	const unsigned char *section[PROFILE_MAX_SECTION];
+	size_t size[PROFILE_MAX_SECTION];
+
+	struct lk_ctx *keymap;
+
+	struct profile_font font;
+	const unsigned char *glyphs;
+
+	struct unimapdesc unimap;
+
+	unsigned short scrnmap[E_TABSZ];
+	unsigned char palette[3 * 16];
+};
+
+static int
+read_keymap(struct profile *p, struct lk_ctx *ctx)
+{
+	struct cursor c = { p->section[PROFILE_KEYMAP], p->size[PROFILE_KEYMAP] };
+	struct profile_keymap pk;
+	struct profile_key key;
+	struct profile_func func;
+	struct profile_diacr pd;
+	struct kbsentry kbs;
+	struct lk_kbdiacr dcr;
+	unsigned int i;
+
+	if (take(&c, &pk, sizeof(pk)) < 0)
+		return -1;
+
+	p->keymap = ctx;
+
+	for (i = 0; i < MAX_NR_KEYMAPS; i++) {
+		if ((pk.maps[i / 8] & (1 << (i % 8))) && lk_add_map(p->keymap, (int) i) < 0)
+			return -1;
+	}
+
+	/*
+	 * The keys are stored as they were after parsing, so the keywords are
+	 * set only after they are added: 'alt_is_meta' has already done its job.
+	 */
+	for (i = 0; i < pk.nr_keys; i++) {
+		if (take(&c, &key, sizeof(key)) < 0 ||
+		    key.table >= MAX_NR_KEYMAPS || key.index >= NR_KEYS ||
+		    !lk_map_exists(p->keymap, key.table) ||
+		    lk_add_key(p->keymap, key.table, key.index, key.value) < 0)
+			return -1;
+	}
+
+	for (i = 0; i < pk.nr_funcs; i++) {
+		if (take(&c, &func, sizeof(func)) < 0 ||
+		    func.func >= MAX_NR_FUNC || func.len >= sizeof(kbs.kb_string) ||
+		    take(&c, kbs.kb_string, func.len) < 0)
+			return -1;
+
+		kbs.kb_func = (unsigned char) func.func;
+		kbs.kb_string[func.len] = '\0';
+
+		if (lk_add_func(p->keymap, &kbs) < 0)
+			return -1;
+	}
+
+	for (i = 0; i < pk.nr_diacrs; i++) {
+		if (take(&c, &pd, sizeof(pd)) < 0)
+			return -1;
+
+		dcr.diacr  = pd.diacr;
+		dcr.base   = pd.base;
+		dcr.result = pd.result;
+
+		if (lk_append_diacr(p->keymap, &dcr) < 0)
+			return -1;
+	}
+
+	if (c.left)
+		return -1;
+
+	lk_set_keywords(p->keymap, (lk_keywords) pk.keywords);
+	lk_set_parser_flags(p->keymap, (lk_flags) pk.flags);
+
+	return 0;
+}
+
+static int
+read_font(struct profile *p)
+{
+	struct cursor c = { p->section[PROFILE_FONT], p->size[PROFILE_FONT] };
+
+	if (take(&c, &p->font, sizeof(p->font)) < 0)
+		return -1;
+
+	if (!p->font.count || !p->font.width || p->font.width > 64 ||
+	    !p->font.vpitch || p->font.vpitch > 128 || p->font.height > p->font.vpitch ||
+	    p->font.count > MAXFONTSIZE / (64 * 128 / 8))
+		return -1;
+
+	p->glyphs = c.data;
+
+	if (c.left != (size_t) p->font.count * p->font.vpitch * ((p->font.width + 7) / 8))
+		return -1;
+
+	return 0;
+}
+
+static int
+read_unimap(struct profile *p)
+{
+	struct cursor c = { p->section[PROFILE_UNIMAP], p->size[PROFILE_UNIMAP] };
+	uint32_t count;
+
+	if (take(&c, &count, sizeof(count)) < 0 ||
+	    count > UINT16_MAX || c.left != count * sizeof(struct unipair))
+		return -1;
+
+	p->unimap.entry_ct = (unsigned short) count;
+	p->unimap.entries  = NULL;
+
+	if (!count)
+		return 0;
+
+	/* the section is not aligned for struct unipair */
+	if (!(p->unimap.entries = malloc(c.left)))
+		kbd_error(EXIT_FAILURE, errno, "malloc");
+
+	return take(&c, p->unimap.entries, c.left);
+}
+
+static int
+read_fixed(struct profile *p, enum profile_section_type type, void *dst, size_t len)
+{
+	struct cursor c = { p->section[type], p->size[type] };
+
+	if (c.left != len)
+		return -1;
+
+	return take(&c, dst, len);
+}
+
+static int
+read_profile(struct profile *p, struct lk_ctx *ctx, const unsigned char *data, size_t len)
+{
+	struct cursor c = { data, len };
+	struct profile_header hdr;
+	struct profile_section sec;
+	uint32_t i;
+
+	if (take(&c, &hdr, sizeof(hdr)) < 0 ||
+	    memcmp(hdr.magic, PROFILE_MAGIC, sizeof(hdr.magic)) ||
+	    hdr.version != PROFILE_VERSION)
+		return -1;
+
+	for (i = 0; i < hdr.nr_sections; i++) {
+		if (take(&c, &sec, sizeof(sec)) < 0 ||
+		    !sec.type || sec.type >= PROFILE_MAX_SECTION ||
+		    p->section[sec.type])
+			return -1;
+
+		p->section[sec.type] = c.data;
+		p->size[sec.type]    = sec.size;
+
+		if (take(&c, NULL, sec.size) < 0)
+			return -1;
+	}
+
+	if (c.left)
+		return -1;
+
+	if (p->section[PROFILE_KEYMAP] && read_keymap(p, ctx) < 0)
+		return -1;
+
+	if (p->section[PROFILE_FONT] && read_font(p) < 0)
+		return -1;
+
+	if (p->section[PROFILE_UNIMAP] && read_unimap(p) < 0)
+		return -1;
+
+	if (p->section[PROFILE_SCRNMAP] &&
+	    read_fixed(p, PROFILE_SCRNMAP, p->scrnmap, sizeof(p->scrnmap)) < 0)
+		return -1;
+
+	if (p->section[PROFILE_PALETTE] &&
+	    read_fixed(p, PROFILE_PALETTE, p->palette, sizeof(p->palette)) < 0)
+		return -1;
+
+	return 0;
+}
+
+/* Per console state: font, Unicode map and the activated screen map. */
+static int
+apply_console(struct profile *p, struct kfont_context *kfont, int fd)
+{
+	if (p->glyphs &&
+	    kfont_put_font(kfont, fd, (unsigned char *) p->glyphs, p->font.count,
+	                   p->font.width, p->font.height, p->font.vpitch) < 0)
+		return -1;
+
+	if (p->section[PROFILE_UNIMAP] &&
+	    kfont_put_unicodemap(kfont, fd, NULL, p->unimap.entry_ct ? &p->unimap : NULL) < 0)
+		return -1;
+
+	if (p->section[PROFILE_SCRNMAP]) {
+		if (kfont_put_uniscrnmap(kfont, fd, p->scrnmap) < 0)
+			return -1;
+		if (!emulated)
+			kfont_activatemap(fd);
+	}
+
+	return 0;
+}
+
+static int
+apply_profile(struct profile *p, struct kfont_context *kfont, int fd)
+{
+	int kbd_mode;
+
+	if (p->keymap) {
+		if (console_ioctl(fd, KDGKBMODE, &kbd_mode))
+			kbd_error(EXIT_FAILURE, errno, _("Unable to read keyboard mode"));
+
+		/* same as loadkeys, no need to switch a Unicode keyboard to Unicode */
+		if (kbd_mode == K_UNICODE) {
+			lk_flags flags = lk_get_parser_flags(p->keymap);
+
+			flags |= LK_FLAG_PREFER_UNICODE;
+			flags &= (lk_flags) ~LK_FLAG_UNICODE_MODE;
+
+			lk_set_parser_flags(p->keymap, flags);
+		}
+
+		if (lk_load_keymap(p->keymap, fd, kbd_mode) < 0)
+			return -1;
+	}
+
+	if (apply_console(p, kfont, fd) < 0)
+		return -1;
+
+	if (p->section[PROFILE_PALETTE] && console_ioctl(fd, PIO_CMAP, p->palette) == -1)
+		kbd_error(EXIT_FAILURE, errno, "ioctl");
+
+	return 0;
+}
+
+static int
+read_active_vt(int fd)
+{
+	char buf[32];
+	unsigned int vt;
+	ssize_t n;
+
+	/* sysfs needs the attribute to be read again after each event */
+	if ((n = pread(fd, buf, sizeof(buf) - 1, 0)) <= 0)
+		return -1;
+
+	buf[n] = '\0';
+
+	if (sscanf(buf, "tty%u", &vt) != 1 || !vt || vt >= 64)
+		return -1;
+
+	return (int) vt;
+}
+
+/*
+ * Keeps the profile in memory and applies the per console part of it to
+ * every console that shows up, instead of running setfont for each of them.
+ * The kernel signals console switches only, so new consoles are found when
+ * they or any other console get activated. Consoles from 1 to 15 that were
+ * closed get the profile again when they are reused. Consoles in graphics
+ * mode are skipped and tried again at the next switch.
+ */
+static void KBD_ATTR_NORETURN
+watch_consoles(struct profile *p, struct kfont_context *kfont, int fd)
+{
+	struct pollfd pfd;
+	struct vt_stat vtstat;
+	uint64_t applied = 0, present;
+	unsigned int i;
+	int vt, vtfd;
+
+	if ((pfd.fd = open(ACTIVE_VT, O_RDONLY)) < 0)
+		kbd_error(EXIT_FAILURE, errno, _("Unable to open file: %s"), ACTIVE_VT);
+
+	pfd.events = POLLPRI | POLLERR;
+
+	while (1) {
+		if ((vt = read_active_vt(pfd.fd)) < 0)
+			kbd_error(EXIT_FAILURE, errno, _("Unable to read file: %s"), ACTIVE_VT);
+
+		if (ioctl(fd, VT_GETSTATE, &vtstat))
+			kbd_error(EXIT_FAILURE, errno, "ioctl VT_GETSTATE");
+
+		present = vtstat.v_state & 0xfffe;
+		applied &= present | ~(uint64_t) 0xffff;
+		present |= (uint64_t) 1 << vt;
+
+		for (i = 1; i < 64; i++) {
+			if (!(present & ((uint64_t) 1 << i)) || (applied & ((uint64_t) 1 << i)))
+				continue;
+
+			/* consoles in graphics mode are skipped */
+			if ((vtfd = kbd_open_text_vt(i, kfont_get_verbosity(kfont))) < 0)
+				continue;
+
+			if (apply_console(p, kfont, vtfd) == 0) {
+				applied |= (uint64_t) 1 << i;
+
+				if (kfont_get_verbosity(kfont)) {
+					printf(_("Console profile applied to tty%u\n"), i);
+					fflush(stdout);
+				}
+			}
+
+			close(vtfd);
+		}
+
+		while (poll(&pfd, 1, -1) < 0) {
+			if (errno != EINTR)
+				kbd_error(EXIT_FAILURE, errno, "poll");
+		}
+	}
+}
+
+int main(int argc, char **argv)
+{
+	const char *fonts[MAXIFILES];
+	const char *output = NULL, *keymap = NULL, *unimap = NULL;
+	const char *scrnmap = NULL, *palette = NULL, *console = NULL;
+	struct profile profile;
+	struct lk_ctx *ctx;
+	struct kfont_context *kfont;
+	unsigned char *data;
+	size_t len;
+	unsigned int i, sections;
+	int c, fd, ret, nfonts = 0, watch = 0, dry_run = 0;
+
+	set_progname(argv[0]);
+	setuplocale();
+
+	const char *short_opts = "o:k:uf:U:m:p:C:wnqvhV";
+	const struct option long_opts[] = {
+		{ "output",     required_argument, NULL, 'o' },
+		{ "keymap",     required_argument, NULL, 'k' },
+		{ "unicode",    no_argument,       NULL, 'u' },
+		{ "font",       required_argument, NULL, 'f' },
+		{ "unimap",     required_argument, NULL, 'U' },
+		{ "consolemap", required_argument, NULL, 'm' },
+		{ "palette",    required_argument, NULL, 'p' },
+		{ "console",    required_argument, NULL, 'C' },
+		{ "watch",      no_argument,       NULL, 'w' },
+		{ "dry-run",    no_argument,       NULL, 'n' },
+		{ "quiet",      no_argument,       NULL, 'q' },
+		{ "verbose",    no_argument,       NULL, 'v' },
+		{ "help",       no_argument,       NULL, 'h' },
+		{ "version",    no_argument,       NULL, 'V' },
+		{ NULL,         0,                 NULL,  0  }
+	};
+	const struct kbd_help opthelp[] = {
+		{ "-o, --output=FILE",     _("compile a profile into FILE.") },
+		{ "-k, --keymap=FILE",     _("add a keymap to the profile.") },
+		{ "-u, --unicode",         _("compile the keymap for a Unicode console.") },
+		{ "-f, --font=FILE",       _("add a console font to the profile.") },
+		{ "-U, --unimap=FILE",     _("add a Unicode mapping table to the profile.") },
+		{ "-m, --consolemap=FILE", _("add a console screen map to the profile.") },
+		{ "-p, --palette=FILE",    _("add a palette in the format of setvtrgb, or 'vga'.") },
+		{ "-C, --console=DEV",     _("the console device to be used.") },
+		{ "-w, --watch",           _("stay resident and apply the profile to new consoles.") },
+		{ "-n, --dry-run",         _("apply the profile to an emulated console only.") },
+		{ "-q, --quiet",           _("suppress all normal output.") },
+		{ "-v, --verbose",         _("be more verbose.") },
+		{ "-V, --version",         _("print version number.")     },
+		{ "-h, --help",            _("print this usage message.") },
+		{ NULL, NULL }
+	};
+
+	if (!(ctx = lk_init()))
+		exit(EXIT_FAILURE);
+
+	if ((ret = kfont_init(get_progname(), &kfont)) < 0)
+		return -ret;
+
+	while ((c = getopt_long(argc, argv, short_opts, long_opts, NULL)) != -1) {
+		switch (c) {
+			case 'o':
+				output = optarg;
+				break;
+			case 'k':
+				keymap = optarg;
+				break;
+			case 'u':
+				lk_set_parser_flags(ctx, LK_FLAG_UNICODE_MODE | LK_FLAG_PREFER_UNICODE);
+				break;
+			case 'f':
+				if (nfonts >= MAXIFILES)
+					kbd_error(EX_USAGE, 0, _("Too many input files."));
+				fonts[nfonts++] = optarg;
+				break;
+			case 'U':
+				unimap = optarg;
+				break;
+			case 'm':
+				scrnmap = optarg;
+				break;
+			case 'p':
+				palette = optarg;
+				break;
+			case 'C':
+				if (optarg == NULL || optarg[0] == '\0')
+					usage(EX_USAGE, opthelp);
+				console = optarg;
+				break;
+			case 'w':
+				watch = 1;
+				break;
+			case 'n':
+				dry_run = 1;
+				break;
+			case 'q':
+				lk_set_log_priority(ctx, LOG_ERR);
+				break;
+			case 'v':
+				lk_set_log_priority(ctx, LOG_INFO);
+				kfont_inc_verbosity(kfont);
+				break;
+			case 'V':
+				print_version_and_exit();
+				break;
+			case 'h':
+				usage(EXIT_SUCCESS, opthelp);
+				break;
+			case '?':
+				usage(EX_USAGE, opthelp);
+				break;
+		}
+	}
+
+	if (output && !dry_run) {
+		if (optind != argc || console || watch)
+			usage(EX_USAGE, opthelp);
+
+		ret = compile_profile(ctx, kfont, output, keymap, fonts, nfonts,
+		                      unimap, scrnmap, palette);
+
+		lk_free(ctx);
+		kfont_free(kfont);
+
+		return ret < 0 ? EXIT_FAILURE : EXIT_SUCCESS;
+	}
+
+	if (optind + 1 != argc || keymap || nfonts || unimap || scrnmap || palette ||
+	    (dry_run && (console || watch)))
+		usage(EX_USAGE, opthelp);
+
+	memset(&profile, 0, sizeof(profile));
+
+	data = kbd_read_file(argv[optind], &len);
+
+	if (read_profile(&profile, ctx, data, len) < 0)
+		kbd_error(EXIT_FAILURE, 0, _("%s: invalid console profile"), argv[optind]);
+
+	if (dry_run) {
+		use_emulated_console(ctx, kfont);
+
+		ret = apply_profile(&profile, kfont, 0);
+
+		/* the keymap section is copied, the rest is read back */
+		if (ret == 0 && output) {
+			sections = 0;
+			for (i = PROFILE_FONT; i < PROFILE_MAX_SECTION; i++) {
+				if (profile.section[i])
+					sections |= 1U << i;
+			}
+
+			write_profile(output, NULL, profile.section[PROFILE_KEYMAP],
+			              profile.size[PROFILE_KEYMAP], kfont, sections);
+		}
+
+		drop_emulated_console(ctx, kfont);
+	} else {
+		if ((fd = getfd(console)) < 0)
+			kbd_error(EXIT_FAILURE, 0, _("Couldn't get a file descriptor referring to the console."));
+
+		ret = apply_profile(&profile, kfont, fd);
+
+		if (ret == 0 && watch)
+			watch_consoles(&profile, kfont, fd);
+
+		close(fd);
+	}
+
+	free(profile.unimap.entries);
+	free(data);
+
+	lk_free(ctx);
+	kfont_free(kfont);
+
+	return ret < 0 ? EXIT_FAILURE : EXIT_SUCCESS;
+}
@@ -50,7 +50,7 @@ usage(int rc, const struct kbd_help *options)
 
 int main(int argc, char *argv[])
 {
-	int c, rc;
+	int c, rc = 0;
 	int kbd_mode;
 
 	char long_info       = 0;
@@ -61,8 +61,13 @@ int main(int argc, char *argv[])
 	char keys_only       = 0;
 	char diac_only       = 0;
 	char *console        = NULL;
+	char need_keys       = 1;
+	char need_funcs      = 1;
+	char need_diacs      = 1;
+	char snapshot        = 0;
 
 	struct lk_ctx *ctx;
+	struct lk_kernel_keys_filter filter;
 
 	set_progname(argv[0]);
 	setuplocale();
@@ -81,6 +86,7 @@ int main(int argc, char *argv[])
 		{ "compose-only", no_argument, NULL, 'd' },
 		{ "charset", required_argument, NULL, 'c' },
 		{ "console", required_argument, NULL, 'C' },
+		{ "snapshot", no_argument, NULL, 'B' },
 		{ "verbose", no_argument, NULL, 'v' },
 		{ "version", no_argument, NULL, 'V' },
 		{ NULL, 0, NULL, 0 }
@@ -97,6 +103,7 @@ int main(int argc, char *argv[])
 		{ "-d, --compose-only",     _("display only compose key combinations.") },
 		{ "-c, --charset=CHARSET",  _("interpret character action codes to be from the specified character set.") },
 		{ "-C, --console=DEV",      _("the console device to be used.") },
+		{ "    --snapshot",         _("write a binary snapshot of the keyboard state to stdout.") },
 		{ "-v, --verbose",          _("be more verbose.") },
 		{ "-V, --version",          _("print version number.")     },
 		{ "-h, --help",             _("print this usage message.") },
@@ -152,6 +159,9 @@ int main(int argc, char *argv[])
 			case 'C':
 				console = optarg;
 				break;
+			case 'B':
+				snapshot = 1;
+				break;
 			case 'V':
 				print_version_and_exit();
 				break;
@@ -178,7 +188,29 @@ int main(int argc, char *argv[])
 		lk_set_parser_flags(ctx, LK_FLAG_PREFER_UNICODE);
 	}
 
-	if ((rc = lk_kernel_keymap(ctx, fd)) < 0)
+	if (snapshot) {
+		rc = lk_kernel_snapshot(ctx, fd, stdout);
+		goto fail;
+	}
+
+	/* read from the kernel only what is going to be printed */
+	lk_kernel_keys_filter_init(&filter);
+
+	if (short_info || long_info) {
+		/* the summary only counts tables, keycode 0 is enough for that */
+		filter.last = 0;
+		need_funcs  = 0;
+	} else if (diac_only) {
+		need_keys = need_funcs = 0;
+	} else if (funcs_only) {
+		need_keys = need_diacs = 0;
+	} else if (keys_only) {
+		need_diacs = 0;
+	}
+
+	if ((need_keys && (rc = lk_kernel_keys_filtered(ctx, fd, &filter)) < 0) ||
+	    (need_funcs && (rc = lk_kernel_funcs(ctx, fd)) < 0) ||
+	    (need_diacs && (rc = lk_kernel_diacrs(ctx, fd)) < 0))
 		goto fail;
 
 	if (short_info || long_info) {
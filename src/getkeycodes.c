@@ -28,23 +28,59 @@ usage(int rc, const struct kbd_help *options)
 	exit(rc);
 }
 
+/*
+ * One "scancode keycode" line per mapped scancode, in the syntax that
+ * setkeycodes accepts on its command line and with --file.
+ */
+static void
+print_raw(int fd)
+{
+	struct kbkeycode a;
+	unsigned int sc;
+
+	for (sc = 1; sc < 256; sc++) {
+		a.scancode = sc;
+		a.keycode  = 0;
+
+		if (ioctl(fd, KDGETKEYCODE, &a)) {
+			if (errno == EINVAL)
+				continue;
+			kbd_error(EXIT_FAILURE, errno, _("failed to get keycode for scancode 0x%x: "
+			                                 "ioctl KDGETKEYCODE"),
+			          sc);
+		}
+
+		/* the scancode is not mapped */
+		if (!a.keycode)
+			continue;
+
+		if (sc < 128)
+			printf("%02x %u\n", sc, a.keycode);
+		else
+			printf("e0%02x %u\n", sc - 128, a.keycode);
+	}
+}
+
 int main(int argc, char **argv)
 {
 	int fd, c;
+	int raw = 0;
 	unsigned int sc, sc0;
 	struct kbkeycode a;
 
 	set_progname(argv[0]);
 	setuplocale();
 
-	const char *const short_opts = "hV";
+	const char *const short_opts = "rhV";
 	const struct option long_opts[] = {
+		{ "raw",     no_argument, NULL, 'r' },
 		{ "help",    no_argument, NULL, 'h' },
 		{ "version", no_argument, NULL, 'V' },
 		{ NULL, 0, NULL, 0 }
 	};
 
 	const struct kbd_help opthelp[] = {
+		{ "-r, --raw",     _("print the table as scancode keycode lines for setkeycodes.") },
 		{ "-h, --help",    _("print this usage message.") },
 		{ "-V, --version", _("print version number.")     },
 		{ NULL, NULL }
@@ -52,6 +88,9 @@ int main(int argc, char **argv)
 
 	while ((c = getopt_long(argc, argv, short_opts, long_opts, NULL)) != -1) {
 		switch (c) {
+			case 'r':
+				raw = 1;
+				break;
 			case 'V':
 				print_version_and_exit();
 				break;
@@ -67,6 +106,11 @@ int main(int argc, char **argv)
 	if ((fd = getfd(NULL)) < 0)
 		kbd_error(EXIT_FAILURE, 0, _("Couldn't get a file descriptor referring to the console."));
 
+	if (raw) {
+		print_raw(fd);
+		return EXIT_SUCCESS;
+	}
+
 	/* Old kernels don't support changing scancodes below SC_LIM. */
 	a.scancode = 0;
 	a.keycode  = 0;
@@ -43,6 +43,7 @@ usage(int rc, const struct kbd_help *options)
 int main(int argc, char **argv)
 {
 	int sortflag = 0;
+	int binary   = 0;
 	char mb[]    = { 0, 0, 0, 0, 0, 0, 0, 0 };
 	int mb_length;
 	int fd, c, i;
@@ -52,9 +53,10 @@ int main(int argc, char **argv)
 	set_progname(argv[0]);
 	setuplocale();
 
-	const char *const short_opts = "hVsC:";
+	const char *const short_opts = "hVsbC:";
 	const struct option long_opts[] = {
 		{ "sort",    no_argument,       NULL, 's' },
+		{ "binary",  no_argument,       NULL, 'b' },
 		{ "console", required_argument, NULL, 'C' },
 		{ "help",    no_argument,       NULL, 'h' },
 		{ "version", no_argument,       NULL, 'V' },
@@ -62,6 +64,7 @@ int main(int argc, char **argv)
 	};
 	const struct kbd_help opthelp[] = {
 		{ "-s, --sort",        _("sort and merge elements.") },
+		{ "-b, --binary",      _("output the map in binary (.unib) format.") },
 		{ "-C, --console=DEV", _("the console device to be used.") },
 		{ "-V, --version",     _("print version number.")     },
 		{ "-h, --help",        _("print this usage message.") },
@@ -73,6 +76,9 @@ int main(int argc, char **argv)
 			case 's':
 				sortflag = 1;
 				break;
+			case 'b':
+				binary = 1;
+				break;
 			case 'C':
 				console = optarg;
 				break;
@@ -103,7 +109,10 @@ int main(int argc, char **argv)
 	if (kfont_get_unicodemap(kfont, fd, &ud))
 		return EXIT_FAILURE;
 
-	if (sortflag) {
+	if (binary) {
+		if (kfont_write_binary_unicodemap(kfont, stdout, &ud) < 0)
+			return EXIT_FAILURE;
+	} else if (sortflag) {
 		printf("# sorted kernel unimap - count=%d\n", ud.entry_ct);
 		/* sort and merge entries */
 		qsort(ud.entries, ud.entry_ct, sizeof(ud.entries[0]),
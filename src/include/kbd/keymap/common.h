@@ -71,6 +71,17 @@ int lk_set_log_fn(struct lk_ctx *ctx, lk_logger_t log_fn, const void *data);
 lk_logger_t lk_get_log_fn(struct lk_ctx *ctx);
 void *lk_get_log_data(struct lk_ctx *ctx);
 
+/** Set the backend used to access the console.
+ * @param ctx is a keymap library context.
+ * @param ops is the console operations, or NULL to restore the default
+ * backend which calls ioctl(2). The operations must stay valid while
+ * the context uses them.
+ * @param data is the pointer passed to the operations.
+ *
+ * @return 0 on success, -1 on error.
+ */
+int lk_set_console_ops(struct lk_ctx *ctx, const struct lk_console_ops *ops, void *data);
+
 lk_keywords lk_get_keywords(struct lk_ctx *ctx);
 int lk_set_keywords(struct lk_ctx *ctx, lk_keywords keywords);
 
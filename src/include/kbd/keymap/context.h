@@ -40,6 +40,25 @@ struct lk_kbdiacr {
 	unsigned int diacr, base, result;
 };
 
+/**
+ * @brief Console operations used by the library.
+ *
+ * By default the library calls ioctl(2) on the console file descriptor.
+ * Another backend can be installed with lk_set_console_ops(), for example
+ * to run against an emulated console.
+ */
+struct lk_console_ops {
+	/**
+	 * Performs a console ioctl. Must behave like ioctl(2): return 0 on
+	 * success, or -1 and set errno on failure.
+	 * @param data is the pointer passed to lk_set_console_ops().
+	 * @param fd is the console file descriptor.
+	 * @param request is the ioctl request.
+	 * @param arg is the ioctl argument.
+	 */
+	int (*ioctl)(void *data, int fd, unsigned long request, unsigned long arg);
+};
+
 /**
  * @brief Opaque object representing the library context.
  */
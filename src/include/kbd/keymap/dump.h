@@ -79,6 +79,60 @@ void lk_dump_keymap(struct lk_ctx *ctx, FILE *fd, lk_table_shape table, char num
 void lk_dump_keys(struct lk_ctx *ctx, FILE *fd, lk_table_shape table, char numeric)
 	KBD_ATTR_NONNULL(1, 2);
 
+/**
+ * @brief Precomputed layout of the key table used to produce keycode dumps.
+ *
+ * A plan is built in one sweep over the key table and holds the action code
+ * of every (keycode, table) pair together with the per-keycode data that the
+ * short-hand heuristics need. It can be used to output the keycodes in
+ * several shapes without reading the key table again. The plan is a copy:
+ * changes made to the keymap after it was built are not visible through it.
+ */
+struct lk_dump_plan;
+
+/**
+ * Builds a dump plan for the current keymap.
+ * @param ctx is a keymap library context.
+ *
+ * @return the new plan, or NULL on error.
+ */
+struct lk_dump_plan *lk_dump_plan_new(struct lk_ctx *ctx)
+	KBD_ATTR_NONNULL(1);
+
+/**
+ * Frees a dump plan.
+ * @param plan is the plan returned by @ref lk_dump_plan_new.
+ */
+void lk_dump_plan_free(struct lk_dump_plan *plan);
+
+/**
+ * Outputs keycodes using a precomputed plan.
+ * @param plan is the plan returned by @ref lk_dump_plan_new.
+ * @param fd is a FILE pointer for output.
+ * @param table specifies the output format of the keycode table.
+ * @param numeric indicates whether to output the keycodes in numerical form.
+ */
+void lk_dump_plan_keys(const struct lk_dump_plan *plan, FILE *fd,
+                       lk_table_shape table, char numeric)
+	KBD_ATTR_NONNULL(1, 2);
+
+/**
+ * Formats keycodes into a memory buffer instead of a FILE. Like getline(3),
+ * @p buf and @p size describe a buffer allocated with malloc(3) (or NULL and 0)
+ * that is reused and grown as needed, so it can be passed to repeated calls.
+ * The result is NUL-terminated; the caller must free the buffer.
+ * @param ctx is a keymap library context.
+ * @param buf points to the buffer.
+ * @param size points to the allocated size of the buffer.
+ * @param table specifies the output format of the keycode table.
+ * @param numeric indicates whether to output the keycodes in numerical form.
+ *
+ * @return length of the text on success, -1 on error.
+ */
+ssize_t lk_dump_keys_to_buffer(struct lk_ctx *ctx, char **buf, size_t *size,
+                               lk_table_shape table, char numeric)
+	KBD_ATTR_NONNULL(1, 2, 3);
+
 /**
  * Outputs 'keymaps' line.
  * @param ctx is a keymap library context.
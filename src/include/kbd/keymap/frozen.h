@@ -0,0 +1,85 @@
+// SPDX-License-Identifier: LGPL-2.0-or-later
+/**
+ * @file frozen.h
+ * @brief Immutable compiled keymaps that can be shared between threads.
+ */
+#ifndef _KBD_LIBKEYMAP_FROZEN_H_
+#define _KBD_LIBKEYMAP_FROZEN_H_
+
+#include <kbd/compiler_attributes.h>
+
+#include <kbd/keymap/context.h>
+
+/**
+ * @brief Opaque object representing a frozen keymap.
+ *
+ * A frozen keymap is a read-only copy of the key tables of a context,
+ * together with everything needed to name keysyms. It does not refer back
+ * to the context, which can be freed or reused once the keymap is frozen.
+ * All query functions only read the object, so any number of threads may
+ * use one frozen keymap at the same time without locking. The reference
+ * count is updated atomically.
+ */
+struct lk_frozen_keymap;
+
+/**
+ * Compiles the keymap of the context into a frozen keymap. The constant
+ * keys are added to the context first, as when the keymap is loaded.
+ * @param ctx is a keymap library context.
+ *
+ * @return a frozen keymap with a reference count of one, or NULL on error.
+ */
+struct lk_frozen_keymap *lk_keymap_freeze(struct lk_ctx *ctx)
+	KBD_ATTR_NONNULL(1);
+
+/**
+ * Takes a new reference to a frozen keymap.
+ * @param km is a frozen keymap.
+ *
+ * @return km.
+ */
+struct lk_frozen_keymap *lk_frozen_ref(struct lk_frozen_keymap *km)
+	KBD_ATTR_NONNULL(1);
+
+/**
+ * Drops a reference to a frozen keymap and frees it when the last
+ * reference is gone.
+ * @param km is a frozen keymap or NULL.
+ */
+void lk_frozen_unref(struct lk_frozen_keymap *km);
+
+/**
+ * Checks whether the table exists in a frozen keymap.
+ * @param km is a frozen keymap.
+ * @param k_table is a table number.
+ *
+ * @return 1 if the table exists, 0 otherwise.
+ */
+int lk_frozen_map_exists(const struct lk_frozen_keymap *km, int k_table)
+	KBD_ATTR_NONNULL(1);
+
+/**
+ * Gets the action code bound to a key.
+ * @param km is a frozen keymap.
+ * @param k_table is a table number.
+ * @param k_index is a keycode.
+ *
+ * @return the action code, K_HOLE if the key is not bound, or -1 if the
+ * table does not exist.
+ */
+int lk_frozen_get_key(const struct lk_frozen_keymap *km, int k_table, int k_index)
+	KBD_ATTR_NONNULL(1);
+
+/**
+ * Converts an action code to the name of its keysym using the charset that
+ * was set when the keymap was frozen.
+ * @param km is a frozen keymap.
+ * @param code is a numeric representation of ksym.
+ *
+ * @return a static string that must not be freed, or NULL if the code has no
+ * name.
+ */
+const char *lk_frozen_code_to_ksym(const struct lk_frozen_keymap *km, int code)
+	KBD_ATTR_NONNULL(1);
+
+#endif /* _KBD_LIBKEYMAP_FROZEN_H_ */
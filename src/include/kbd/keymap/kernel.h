@@ -6,6 +6,8 @@
 #ifndef _KBD_LIBKEYMAP_KERNEL_H_
 #define _KBD_LIBKEYMAP_KERNEL_H_
 
+#include <stdio.h>
+
 #include <kbd/compiler_attributes.h>
 
 #include <kbd/keymap/context.h>
@@ -31,6 +33,59 @@ int lk_kernel_keymap(struct lk_ctx *ctx, int console)
 int lk_kernel_keys(struct lk_ctx *ctx, int console)
 	KBD_ATTR_NONNULL(1);
 
+/**
+ * @brief Describes which part of the kernel keymap to read.
+ */
+struct lk_kernel_keys_filter {
+	/**
+	 * Bitmap of tables to read. Tables not marked here are not probed at all.
+	 */
+	unsigned char tables[MAX_NR_KEYMAPS / 8];
+
+	/**
+	 * First keycode to read.
+	 */
+	unsigned short first;
+
+	/**
+	 * Last keycode to read (inclusive).
+	 */
+	unsigned short last;
+};
+
+/**
+ * Marks table @p t as selected in @p filter.
+ */
+#define LK_FILTER_SET_TABLE(filter, t) \
+	((filter)->tables[(t) / 8] |= (unsigned char) (1 << ((t) % 8)))
+
+/**
+ * Checks whether table @p t is selected in @p filter.
+ */
+#define LK_FILTER_HAS_TABLE(filter, t) \
+	(((filter)->tables[(t) / 8] >> ((t) % 8)) & 1)
+
+/**
+ * Initializes a filter that selects all tables and the whole keycode range.
+ * @param filter is the filter to initialize.
+ */
+void lk_kernel_keys_filter_init(struct lk_kernel_keys_filter *filter)
+	KBD_ATTR_NONNULL(1);
+
+/**
+ * Reads the part of the keymap described by @p filter from the kernel. Tables
+ * that are not allocated in the kernel are detected with a single probe and
+ * skipped; for allocated tables only the requested keycode range is read.
+ * @param ctx is a keymap library context.
+ * @param console is open file descriptor.
+ * @param filter selects tables and keycodes; NULL means everything.
+ *
+ * @return 0 on success, -1 on error.
+ */
+int lk_kernel_keys_filtered(struct lk_ctx *ctx, int console,
+                            const struct lk_kernel_keys_filter *filter)
+	KBD_ATTR_NONNULL(1);
+
 /**
  * Loads function keys into the kernel.
  * @param ctx is a keymap library context.
@@ -51,4 +106,31 @@ int lk_kernel_funcs(struct lk_ctx *ctx, int console)
 int lk_kernel_diacrs(struct lk_ctx *ctx, int console)
 	KBD_ATTR_NONNULL(1);
 
+/**
+ * Saves the complete keyboard state of the console (keys, function key
+ * strings, accent table, meta mode and keyboard mode) as a binary snapshot.
+ * The snapshot is in native byte order and is meant to be restored on the
+ * same machine with @ref lk_kernel_restore.
+ * @param ctx is a keymap library context.
+ * @param console is open file descriptor.
+ * @param fp is a FILE pointer for output.
+ *
+ * @return 0 on success, -1 on error.
+ */
+int lk_kernel_snapshot(struct lk_ctx *ctx, int console, FILE *fp)
+	KBD_ATTR_NONNULL(1, 3);
+
+/**
+ * Restores the keyboard state saved by @ref lk_kernel_snapshot. The whole
+ * snapshot is validated before anything is changed, and only what differs
+ * from the current state of the console is written.
+ * @param ctx is a keymap library context.
+ * @param console is open file descriptor.
+ * @param fp is a FILE pointer to read the snapshot from.
+ *
+ * @return 0 on success, -1 on error.
+ */
+int lk_kernel_restore(struct lk_ctx *ctx, int console, FILE *fp)
+	KBD_ATTR_NONNULL(1, 3);
+
 #endif /* _KBD_LIBKEYMAP_KERNEL_H_ */
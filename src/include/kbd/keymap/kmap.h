@@ -63,6 +63,9 @@ int lk_append_diacr(struct lk_ctx *ctx, struct lk_kbdiacr *dcr)
 int lk_append_compose(struct lk_ctx *ctx, struct lk_kbdiacr *dcr)
 	KBD_ATTR_NONNULL(1, 2);
 
+int lk_find_compose(struct lk_ctx *ctx, struct lk_kbdiacr *dcr)
+	KBD_ATTR_NONNULL(1, 2);
+
 int lk_add_constants(struct lk_ctx *ctx) KBD_ATTR_NONNULL(1);
 
 #include <kbdfile.h>
@@ -0,0 +1,107 @@
+// SPDX-License-Identifier: LGPL-2.0-or-later
+/**
+ * @file translator.h
+ * @brief Functions for translating key events in userspace.
+ */
+#ifndef _KBD_LIBKEYMAP_TRANSLATOR_H_
+#define _KBD_LIBKEYMAP_TRANSLATOR_H_
+
+#include <stddef.h>
+
+#include <kbd/compiler_attributes.h>
+
+#include <kbd/keymap/context.h>
+
+/**
+ * @brief Output buffer size that is enough for any single key event.
+ */
+#define LK_TRANSLATE_BUFSIZE 520
+
+/**
+ * @brief Flags that control the output of the translator.
+ */
+typedef enum {
+	LK_TRANSLATE_UNICODE  = (1 << 1), /**< Output UTF-8 instead of 8-bit characters */
+	LK_TRANSLATE_META_ESC = (1 << 2), /**< Meta keys send an ESC prefix instead of setting the high bit */
+	LK_TRANSLATE_CRLF     = (1 << 3)  /**< Enter sends CR LF instead of CR */
+} lk_translate_flags;
+
+/**
+ * @brief Opaque object representing a key translator.
+ *
+ * The translator does in userspace what the kernel keyboard driver does
+ * with a loaded keymap: it tracks modifiers, locks, LEDs and dead keys,
+ * and turns key events into the characters and strings they produce.
+ * The key tables are frozen with @ref lk_keymap_freeze and the accent table
+ * is copied when the translator is created, so the context can be freed or
+ * changed afterwards.
+ */
+struct lk_translator;
+
+/**
+ * Creates a translator for the keymap of the context. The constant keys are
+ * added to the context first, as when the keymap is loaded.
+ * @param ctx is a keymap library context.
+ * @param flags is a combination of @ref lk_translate_flags.
+ *
+ * @return a new translator, or NULL on error.
+ */
+struct lk_translator *lk_translator_new(struct lk_ctx *ctx, lk_translate_flags flags)
+	KBD_ATTR_NONNULL(1);
+
+/**
+ * Frees a translator.
+ * @param tr is a translator or NULL.
+ */
+void lk_translator_free(struct lk_translator *tr);
+
+/**
+ * Forgets all pressed keys, modifiers, locks, LEDs and pending dead keys.
+ * @param tr is a translator.
+ */
+void lk_translator_reset(struct lk_translator *tr)
+	KBD_ATTR_NONNULL(1);
+
+/**
+ * Translates a key event.
+ * @param tr is a translator.
+ * @param keycode is a keycode.
+ * @param down is 0 for a release, 1 for a press and 2 for an autorepeat,
+ * as in the value of a key input event.
+ * @param buf is the output buffer.
+ * @param size is the size of the output buffer.
+ *
+ * @return the number of bytes produced by the event, or -1 if the keycode
+ * is out of range. If the return value is larger than size, the output was
+ * truncated. The output is not NUL-terminated.
+ */
+int lk_translate(struct lk_translator *tr, int keycode, int down, char *buf, size_t size)
+	KBD_ATTR_NONNULL(1);
+
+/**
+ * Gets the LED state.
+ * @param tr is a translator.
+ *
+ * @return a combination of LED_SCR, LED_NUM and LED_CAP.
+ */
+unsigned int lk_translator_get_leds(const struct lk_translator *tr)
+	KBD_ATTR_NONNULL(1);
+
+/**
+ * Sets the LED state, for example to start with NumLock on.
+ * @param tr is a translator.
+ * @param leds is a combination of LED_SCR, LED_NUM and LED_CAP.
+ */
+void lk_translator_set_leds(struct lk_translator *tr, unsigned int leds)
+	KBD_ATTR_NONNULL(1);
+
+/**
+ * Gets the number of the table that the next key press will be looked up in.
+ * @param tr is a translator.
+ *
+ * @return the table number.
+ */
+int lk_translator_get_table(const struct lk_translator *tr)
+	KBD_ATTR_NONNULL(1);
+
+#endif /* _KBD_LIBKEYMAP_TRANSLATOR_H_ */
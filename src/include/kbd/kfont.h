@@ -98,6 +98,34 @@ struct psf2_header {
 #define PSF1_MAGIC_OK(x) ((x)[0] == PSF1_MAGIC0 && (x)[1] == PSF1_MAGIC1)
 #define PSF2_MAGIC_OK(x) ((x)[0] == PSF2_MAGIC0 && (x)[1] == PSF2_MAGIC1 && (x)[2] == PSF2_MAGIC2 && (x)[3] == PSF2_MAGIC3)
 
+/*
+ * Format of a binary unicode map (.unib):
+ *
+ * 1. The header
+ * 2. An array of length (struct unipair) entries, sorted by font
+ *    position and then by Unicode value.
+ *
+ * The integers in the header and the entries are little endian.
+ * The entries can be passed to PIO_UNIMAP as is, so loading a
+ * binary map doesn't require any parsing.
+ */
+#define UNIB_MAGIC0 0x55 /* 'U' */
+#define UNIB_MAGIC1 0x4e /* 'N' */
+#define UNIB_MAGIC2 0x49 /* 'I' */
+#define UNIB_MAGIC3 0x42 /* 'B' */
+
+struct unib_header {
+	unsigned char magic[4] KBD_ATTR_NONSTRING;
+	unsigned int version;
+	unsigned int headersize; /* offset of entries in file */
+	unsigned int length;     /* number of entries */
+};
+
+/* max version recognized so far */
+#define UNIB_MAXVERSION 0
+
+#define UNIB_MAGIC_OK(x) ((x)[0] == UNIB_MAGIC0 && (x)[1] == UNIB_MAGIC1 && (x)[2] == UNIB_MAGIC2 && (x)[3] == UNIB_MAGIC3)
+
 struct kfont_context;
 
 /* unicode.c */
@@ -139,27 +167,72 @@ void kfont_set_option(struct kfont_context *ctx, enum kfont_option opt)
 void kfont_unset_option(struct kfont_context *ctx, enum kfont_option opt)
 	KBD_ATTR_NONNULL(1);
 
+/*
+ * Console operations used by the library. The ioctl callback must behave
+ * like ioctl(2). By default the library calls ioctl(2) directly; another
+ * backend, for example an emulated console, can be installed with
+ * kfont_set_console_ops(). Passing NULL restores the default.
+ */
+struct kfont_console_ops {
+	int (*ioctl)(void *data, int fd, unsigned long request, unsigned long arg);
+};
+
+void kfont_set_console_ops(struct kfont_context *ctx,
+		const struct kfont_console_ops *ops, void *data)
+	KBD_ATTR_NONNULL(1);
+
 /* mapscrn.c */
 
 int kfont_load_consolemap(struct kfont_context *ctx, int consolefd,
 		const char *filename)
 	KBD_ATTR_NONNULL(1);
 
+/*
+ * Same as kfont_load_consolemap(), but the map is read and parsed once and
+ * then loaded into each of the @p nconsoles consoles in @p consolefds.
+ * Loading stops at the first console that fails.
+ */
+int kfont_load_consolemap_multi(struct kfont_context *ctx,
+		const int *consolefds, unsigned int nconsoles,
+		const char *filename)
+	KBD_ATTR_NONNULL(1, 2);
+
 int kfont_save_consolemap(struct kfont_context *ctx, int consolefd,
 		const char *filename)
 	KBD_ATTR_NONNULL(1, 3);
 
 /* loadunimap.c */
 
-/* save humanly readable */
+/* save humanly readable, or in binary format if filename ends with .unib */
 int kfont_save_unicodemap(struct kfont_context *ctx, int consolefd,
 		const char *filename)
 	KBD_ATTR_NONNULL(1, 3);
 
+#include <stdio.h>
+#include <linux/kd.h>
+
+/*
+ * Write unicode map in binary format. The entries of UD are sorted
+ * in place.
+ */
+int kfont_write_binary_unicodemap(struct kfont_context *ctx, FILE *fp,
+		struct unimapdesc *ud)
+	KBD_ATTR_NONNULL(1, 2, 3);
+
 int kfont_load_unicodemap(struct kfont_context *ctx, int consolefd,
 		const char *filename)
 	KBD_ATTR_NONNULL(1, 3);
 
+/*
+ * Same as kfont_load_unicodemap(), but the map is read and parsed once and
+ * then loaded into each of the @p nconsoles consoles in @p consolefds.
+ * Loading stops at the first console that fails.
+ */
+int kfont_load_unicodemap_multi(struct kfont_context *ctx,
+		const int *consolefds, unsigned int nconsoles,
+		const char *filename)
+	KBD_ATTR_NONNULL(1, 2, 4);
+
 /* kdfontop.c */
 
 /*
@@ -230,9 +303,42 @@ int kfont_load_fonts(struct kfont_context *ctx,
 		unsigned int iunit, unsigned int hwunit, int no_m, int no_u)
 	KBD_ATTR_NONNULL(1);
 
+/*
+ * Same as kfont_load_fonts(), but the font and its Unicode table are read
+ * and prepared once and then loaded into each of the @p nconsoles consoles
+ * in @p consolefds. Loading stops at the first console that fails.
+ */
+int kfont_load_font_multi(struct kfont_context *ctx,
+		const int *consolefds, unsigned int nconsoles,
+		const char *const *files, int filect,
+		unsigned int iunit, unsigned int hwunit, int no_m, int no_u)
+	KBD_ATTR_NONNULL(1, 2);
+
 void kfont_activatemap(int fd);
 void kfont_disactivatemap(int fd);
 
+/* snapshot.c */
+
+/*
+ * Save the font, the Unicode map, the Unicode screen map and the palette
+ * of the console into one blob allocated with malloc(), returned in
+ * @p blob with its length in @p size.
+ * Return 0 on success, -EX_* on failure.
+ */
+int kfont_snapshot(struct kfont_context *ctx, int consolefd,
+		unsigned char **blob, size_t *size)
+	KBD_ATTR_NONNULL(1, 3, 4);
+
+/*
+ * Restore the state saved by kfont_snapshot(). Only the components that
+ * differ from the current state of the console are loaded. The Unicode
+ * screen map is not activated; see kfont_activatemap().
+ * Return 0 on success, -EX_* on failure.
+ */
+int kfont_restore(struct kfont_context *ctx, int consolefd,
+		const unsigned char *blob, size_t size)
+	KBD_ATTR_NONNULL(1, 3);
+
 /* psffontop.c */
 
 #include <stdio.h>
@@ -5,9 +5,11 @@
 #include <kbd/keymap/context.h>
 #include <kbd/keymap/common.h>
 #include <kbd/keymap/dump.h>
+#include <kbd/keymap/frozen.h>
 #include <kbd/keymap/kernel.h>
 #include <kbd/keymap/kmap.h>
 #include <kbd/keymap/logging.h>
 #include <kbd/keymap/charset.h>
+#include <kbd/keymap/translator.h>
 
 #endif /* _KBD_LIBKEYMAP_H_ */
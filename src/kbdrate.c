@@ -76,9 +76,11 @@ beats rebuilding the kernel!
 #include <string.h>
 #include <errno.h>
 #include <getopt.h>
+#include <termios.h>
 #include <sysexits.h>
 #include <sys/file.h>
 #include <sys/ioctl.h>
+#include <sys/uio.h>
 #include <linux/kd.h>
 
 #ifdef __sparc__
@@ -307,6 +309,153 @@ ioport_set(double rate, int delay, int silent)
 	return 1;
 }
 
+/*
+ * Measurement of the autorepeat as it is actually delivered. The console
+ * is switched to MEDIUMRAW for the duration, as showkey does, and every
+ * event is stamped with the monotonic clock.
+ */
+#define MEASURE_TIMEOUT 3 /* seconds without events that end the measurement */
+
+static volatile sig_atomic_t measure_kbmode = -1;
+static struct termios measure_termios;
+
+static void
+measure_clean_up(void)
+{
+	if (measure_kbmode < 0)
+		return;
+
+	if (ioctl(0, KDSKBMODE, measure_kbmode))
+		kbd_warning(errno, "ioctl KDSKBMODE");
+	if (tcsetattr(0, TCSAFLUSH, &measure_termios) == -1)
+		kbd_warning(errno, "tcsetattr");
+
+	measure_kbmode = -1;
+}
+
+/* Only async-signal-safe calls here: no stdio, no gettext. */
+static void KBD_ATTR_NORETURN
+measure_die(int sig KBD_ATTR_UNUSED)
+{
+	static const char msg[] = ": caught signal, cleaning up...\n";
+	struct iovec iov[2];
+	ssize_t rc KBD_ATTR_UNUSED;
+
+	if (measure_kbmode >= 0) {
+		ioctl(0, KDSKBMODE, measure_kbmode);
+		tcsetattr(0, TCSAFLUSH, &measure_termios);
+	}
+
+	iov[0].iov_base = (void *) get_progname();
+	iov[0].iov_len  = strlen(get_progname());
+	iov[1].iov_base = (void *) msg;
+	iov[1].iov_len  = sizeof(msg) - 1;
+
+	rc = writev(STDERR_FILENO, iov, 2);
+	_exit(EXIT_FAILURE);
+}
+
+static int
+nearest(const int *table, size_t count, double value)
+{
+	size_t i, best = 0;
+	double d, best_d = -1;
+
+	for (i = 0; i < count; i++) {
+		d = table[i] > value ? table[i] - value : value - table[i];
+		if (best_d < 0 || d < best_d) {
+			best_d = d;
+			best   = i;
+		}
+	}
+
+	return table[best];
+}
+
+static void
+measure_repeat(void)
+{
+	struct kbd_key_timing kt;
+	struct kbd_series_stats delay_st, period_st;
+	struct termios raw;
+	int rc, flags, value, kbmode;
+	double cps;
+
+	memset(&kt, 0, sizeof(kt));
+
+	if (ioctl(0, KDGKBMODE, &kbmode))
+		kbd_error(EXIT_FAILURE, errno, _("Unable to read keyboard mode"));
+
+	if (tcgetattr(0, &measure_termios) == -1)
+		kbd_error(EXIT_FAILURE, errno, "tcgetattr");
+
+	measure_kbmode = kbmode;
+
+	signal(SIGHUP, measure_die);
+	signal(SIGINT, measure_die);
+	signal(SIGQUIT, measure_die);
+	signal(SIGTERM, measure_die);
+
+	raw = measure_termios;
+	raw.c_lflag &= ~((tcflag_t)(ICANON | ECHO | ISIG));
+	raw.c_iflag     = 0;
+	raw.c_cc[VMIN]  = 1;
+	raw.c_cc[VTIME] = 0;
+
+	if (tcsetattr(0, TCSAFLUSH, &raw) == -1)
+		kbd_warning(errno, "tcsetattr");
+
+	if (ioctl(0, KDSKBMODE, K_MEDIUMRAW)) {
+		rc = errno;
+		measure_clean_up();
+		kbd_error(EXIT_FAILURE, rc, "ioctl KDSKBMODE");
+	}
+
+	if ((flags = fcntl(0, F_GETFL)) < 0 || fcntl(0, F_SETFL, flags | O_NONBLOCK) < 0) {
+		rc = errno;
+		measure_clean_up();
+		kbd_error(EXIT_FAILURE, rc, "fcntl");
+	}
+
+	printf(_("press and hold a key until it repeats, then release it; do it several\n"
+	         "times for more samples (measurement ends %ds after the last event)...\n"),
+	       MEASURE_TIMEOUT);
+	fflush(stdout);
+
+	if (kbd_key_timing_read(&kt, 0, MEASURE_TIMEOUT, NULL, NULL) < 0) {
+		rc = errno;
+		measure_clean_up();
+		kbd_error(EXIT_FAILURE, rc, "read");
+	}
+
+	fcntl(0, F_SETFL, flags);
+	measure_clean_up();
+
+	printf("\n");
+	kbd_series_print(&kt.delays, _("Autorepeat delay"));
+	kbd_series_print(&kt.repeats, _("Autorepeat period"));
+
+	if (kbd_series_stats(&kt.delays, &delay_st) == 0) {
+		value = nearest(valid_delays, DELAY_COUNT, delay_st.p50);
+
+		printf(_("Measured delay %.1f ms (jitter %.1f ms), nearest valid delay %d ms (%+.1f ms)\n"),
+		       delay_st.p50, delay_st.jitter, value, delay_st.p50 - value);
+	}
+
+	if (kbd_series_stats(&kt.repeats, &period_st) == 0 && period_st.mean > 0) {
+		cps   = 1000.0 / period_st.mean;
+		value = nearest(valid_rates, RATE_COUNT, cps * 10);
+
+		printf(_("Measured rate %.1f cps (jitter %.1f ms), nearest valid rate %.1f cps (%+.1f cps)\n"),
+		       cps, period_st.jitter, value / 10.0, cps - value / 10.0);
+	}
+
+	if (!kt.delays.count)
+		printf(_("No autorepeat was seen: hold a key down longer.\n"));
+
+	kbd_key_timing_free(&kt);
+}
+
 #ifdef __sparc__
 static double rate = 5.0; /* Default rate */
 static int delay   = 200; /* Default delay */
@@ -330,17 +479,20 @@ usage(int rc, const struct kbd_help *options)
 
 int main(int argc, char **argv)
 {
-	int silent = 0;
+	int silent  = 0;
+	int measure = 0;
+	int set     = 0;
 	int c;
 
 	set_progname(argv[0]);
 	setuplocale();
 
-	const char *short_opts = "r:d:pshV";
+	const char *short_opts = "r:d:pmshV";
 	const struct option long_opts[] = {
 		{ "rate", required_argument, NULL, 'r' },
 		{ "delay", required_argument, NULL, 'd' },
 		{ "print", no_argument, NULL, 'p' },
+		{ "measure", no_argument, NULL, 'm' },
 		{ "silent", no_argument, NULL, 's' },
 		{ "help", no_argument, NULL, 'h' },
 		{ "version", no_argument, NULL, 'V' },
@@ -350,6 +502,7 @@ int main(int argc, char **argv)
 		{ "-r, --rate=NUM",    _("set the rate in characters per second.") },
 		{ "-d, --delay=NUM",   _("set the amount of time the key must remain depressed before it will start to repeat.") },
 		{ "-p, --print",       _("do not set new values, but only display the current ones.") },
+		{ "-m, --measure",     _("measure the delay and rate the keyboard actually repeats at.") },
 		{ "-s, --silent",      _("suppress all normal output.") },
 		{ "-V, --version",     _("print version number.")     },
 		{ "-h, --help",        _("print this usage message.") },
@@ -360,13 +513,18 @@ int main(int argc, char **argv)
 		switch (c) {
 			case 'r':
 				rate = atof(optarg);
+				set  = 1;
 				break;
 			case 'd':
 				delay = atoi(optarg);
+				set   = 1;
 				break;
 			case 'p':
 				print_only = 1;
 				break;
+			case 'm':
+				measure = 1;
+				break;
 			case 's':
 				silent = 1;
 				break;
@@ -380,14 +538,19 @@ int main(int argc, char **argv)
 		}
 	}
 
-	if (KDKBDREP_ioctl_ok(rate, delay, silent)) /* m68k/i386? */
+	/* without new values, --measure checks the current settings */
+	if (measure && !set) {
+		measure_repeat();
 		return EXIT_SUCCESS;
+	}
 
-	if (KIOCSRATE_ioctl_ok(rate, delay, silent)) /* sparc? */
-		return EXIT_SUCCESS;
+	if (!KDKBDREP_ioctl_ok(rate, delay, silent) && /* m68k/i386? */
+	    !KIOCSRATE_ioctl_ok(rate, delay, silent) && /* sparc? */
+	    !ioport_set(rate, delay, silent))           /* The ioport way */
+		return EXIT_FAILURE;
 
-	if (ioport_set(rate, delay, silent)) /* The ioport way */
-		return EXIT_SUCCESS;
+	if (measure)
+		measure_repeat();
 
-	return EXIT_FAILURE;
+	return EXIT_SUCCESS;
 }
@@ -0,0 +1,636 @@
+/*
+ * fakeconsole.c
+ *
+ * In-memory emulation of the console ioctls used by libkeymap and libkfont.
+ * It keeps the state the kernel would keep for one virtual console and
+ * counts every request, so that the libraries can be tested and measured
+ * without a real VT.
+ *
+ * The behaviour follows drivers/tty/vt/keyboard.c, vt_ioctl.c and
+ * consolemap.c closely enough for round trips through the libraries.
+ */
+#include "config.h"
+
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <linux/kd.h>
+#include <linux/keyboard.h>
+
+#include "libcommon.h"
+
+#define MAX_REQUESTS 32
+
+#define FONT_MAX_COUNT  512
+#define FONT_MAX_WIDTH  64
+#define FONT_MAX_HEIGHT 128
+
+struct request_counter {
+	unsigned long request;
+	unsigned long count;
+};
+
+struct kbd_fake_console {
+	/* keyboard */
+	unsigned short *key_maps[MAX_NR_KEYMAPS];
+	char *func_table[MAX_NR_FUNC];
+	struct kbdiacruc diacrs[MAX_DIACR];
+	unsigned int nr_diacrs;
+	int kbd_mode;
+	int meta_mode;
+	int kd_mode;
+	unsigned char leds;
+	unsigned char led_flags;
+
+	/* font, stored with a glyph pitch of font_vpitch rows */
+	unsigned char *font;
+	unsigned int font_count;
+	unsigned int font_width;
+	unsigned int font_height;
+	unsigned int font_vpitch;
+
+	/* application charset map and Unicode to font position map */
+	unsigned short uni_scrnmap[E_TABSZ];
+	unsigned short *unimap; /* font position plus one, 0 if unmapped */
+	unsigned int unimap_count;
+
+	/* palette */
+	unsigned char cmap[3 * 16];
+
+	/* counters */
+	struct request_counter requests[MAX_REQUESTS];
+	unsigned long calls;
+	unsigned long failures;
+};
+
+/* Largest value of each action type, as in the kernel. */
+static const unsigned char max_vals[] = {
+	[KT_LATIN]  = 255,
+	[KT_FN]     = MAX_NR_FUNC - 1,
+	[KT_SPEC]   = 19,
+	[KT_PAD]    = NR_PAD - 1,
+	[KT_DEAD]   = 26,
+	[KT_CONS]   = 255,
+	[KT_CUR]    = 3,
+	[KT_SHIFT]  = NR_SHIFT - 1,
+	[KT_META]   = 255,
+	[KT_ASCII]  = NR_ASCII - 1,
+	[KT_LOCK]   = NR_LOCK - 1,
+	[KT_LETTER] = 255,
+	[KT_SLOCK]  = NR_LOCK - 1,
+	[KT_DEAD2]  = 255,
+	[KT_BRL]    = NR_BRL - 1,
+};
+
+#define NR_TYPES (sizeof(max_vals) / sizeof(max_vals[0]))
+
+static int
+fail(int err)
+{
+	errno = err;
+	return -1;
+}
+
+static unsigned short *
+new_key_map(unsigned short first)
+{
+	unsigned short *map;
+	int i;
+
+	map = malloc(NR_KEYS * sizeof(unsigned short));
+	if (!map)
+		return NULL;
+
+	map[0] = first;
+	for (i = 1; i < NR_KEYS; i++)
+		map[i] = K_HOLE;
+
+	return map;
+}
+
+static void
+set_default_font(struct kbd_fake_console *con)
+{
+	free(con->font);
+
+	con->font_count  = 256;
+	con->font_width  = 8;
+	con->font_height = 16;
+	con->font_vpitch = 32;
+	con->font        = calloc(con->font_count, con->font_vpitch);
+}
+
+static void
+clear_unimap(struct kbd_fake_console *con)
+{
+	if (con->unimap)
+		memset(con->unimap, 0, 0x10000 * sizeof(unsigned short));
+	con->unimap_count = 0;
+}
+
+struct kbd_fake_console *
+kbd_fake_console_new(void)
+{
+	struct kbd_fake_console *con;
+	int i;
+
+	con = calloc(1, sizeof(*con));
+	if (!con)
+		return NULL;
+
+	/* the plain table is static and always exists */
+	con->key_maps[0] = new_key_map(K_HOLE);
+
+	set_default_font(con);
+
+	if (!con->key_maps[0] || !con->font) {
+		kbd_fake_console_free(con);
+		return NULL;
+	}
+
+	con->kbd_mode  = K_XLATE;
+	con->meta_mode = K_METABIT;
+	con->kd_mode   = KD_TEXT;
+
+	for (i = 0; i < E_TABSZ; i++)
+		con->uni_scrnmap[i] = (unsigned short) (0xf000 | i);
+
+	memcpy(con->cmap, kbd_vga_colors, sizeof(con->cmap));
+
+	return con;
+}
+
+void
+kbd_fake_console_free(struct kbd_fake_console *con)
+{
+	int i;
+
+	if (!con)
+		return;
+
+	for (i = 0; i < MAX_NR_KEYMAPS; i++)
+		free(con->key_maps[i]);
+
+	for (i = 0; i < MAX_NR_FUNC; i++)
+		free(con->func_table[i]);
+
+	free(con->font);
+	free(con->unimap);
+	free(con);
+}
+
+unsigned long
+kbd_fake_console_calls(const struct kbd_fake_console *con, unsigned long request)
+{
+	int i;
+
+	if (!request)
+		return con->calls;
+
+	for (i = 0; i < MAX_REQUESTS && con->requests[i].request; i++) {
+		if (con->requests[i].request == request)
+			return con->requests[i].count;
+	}
+
+	return 0;
+}
+
+unsigned long
+kbd_fake_console_failures(const struct kbd_fake_console *con)
+{
+	return con->failures;
+}
+
+void
+kbd_fake_console_reset_calls(struct kbd_fake_console *con)
+{
+	memset(con->requests, 0, sizeof(con->requests));
+	con->calls    = 0;
+	con->failures = 0;
+}
+
+static void
+count_request(struct kbd_fake_console *con, unsigned long request)
+{
+	int i;
+
+	con->calls++;
+
+	for (i = 0; i < MAX_REQUESTS; i++) {
+		if (!con->requests[i].request)
+			con->requests[i].request = request;
+		if (con->requests[i].request == request) {
+			con->requests[i].count++;
+			return;
+		}
+	}
+}
+
+static int
+get_kbent(struct kbd_fake_console *con, struct kbentry *ke)
+{
+	unsigned short *map, val;
+
+	map = con->key_maps[ke->kb_table];
+	if (!map) {
+		ke->kb_value = ke->kb_index ? K_HOLE : K_NOSUCHMAP;
+		return 0;
+	}
+
+	val = map[ke->kb_index];
+	if (con->kbd_mode != K_UNICODE && KTYP(val) >= NR_TYPES)
+		val = K_HOLE;
+
+	ke->kb_value = val;
+	return 0;
+}
+
+static int
+set_kbent(struct kbd_fake_console *con, const struct kbentry *ke)
+{
+	unsigned short *map, v = ke->kb_value;
+
+	if (!ke->kb_index && v == K_NOSUCHMAP) {
+		/* deallocate map */
+		map = con->key_maps[ke->kb_table];
+		if (ke->kb_table && map) {
+			con->key_maps[ke->kb_table] = NULL;
+			free(map);
+		}
+		return 0;
+	}
+
+	if (KTYP(v) < NR_TYPES) {
+		if (KVAL(v) > max_vals[KTYP(v)])
+			return fail(EINVAL);
+	} else if (con->kbd_mode != K_UNICODE) {
+		return fail(EINVAL);
+	}
+
+	/* assignment to entry 0 only tests validity of args */
+	if (!ke->kb_index)
+		return 0;
+
+	map = con->key_maps[ke->kb_table];
+	if (!map) {
+		map = new_key_map(K_ALLOCATED);
+		if (!map)
+			return fail(ENOMEM);
+		con->key_maps[ke->kb_table] = map;
+	}
+
+	map[ke->kb_index] = v;
+	return 0;
+}
+
+static int
+get_kbsent(struct kbd_fake_console *con, struct kbsentry *kbs)
+{
+	const char *s = con->func_table[kbs->kb_func];
+	size_t len    = s ? strlen(s) : 0;
+
+	if (len >= sizeof(kbs->kb_string))
+		len = sizeof(kbs->kb_string) - 1;
+
+	if (len)
+		memcpy(kbs->kb_string, s, len);
+	kbs->kb_string[len] = 0;
+
+	return 0;
+}
+
+static int
+set_kbsent(struct kbd_fake_console *con, const struct kbsentry *kbs)
+{
+	char *s = strndup((const char *) kbs->kb_string, sizeof(kbs->kb_string) - 1);
+
+	if (!s)
+		return fail(ENOMEM);
+
+	free(con->func_table[kbs->kb_func]);
+	con->func_table[kbs->kb_func] = s;
+
+	return 0;
+}
+
+static unsigned char
+uni_to_8bit(unsigned int c)
+{
+	return (unsigned char) (c < 0x100 ? c : '?');
+}
+
+static int
+diacr_ioctl(struct kbd_fake_console *con, unsigned long request, unsigned long arg)
+{
+	unsigned int i;
+
+	switch (request) {
+		case KDGKBDIACR: {
+			struct kbdiacrs *kd = (struct kbdiacrs *) arg;
+
+			kd->kb_cnt = con->nr_diacrs;
+			for (i = 0; i < con->nr_diacrs; i++) {
+				kd->kbdiacr[i].diacr  = uni_to_8bit(con->diacrs[i].diacr);
+				kd->kbdiacr[i].base   = uni_to_8bit(con->diacrs[i].base);
+				kd->kbdiacr[i].result = uni_to_8bit(con->diacrs[i].result);
+			}
+			return 0;
+		}
+		case KDSKBDIACR: {
+			const struct kbdiacrs *kd = (const struct kbdiacrs *) arg;
+
+			if (kd->kb_cnt > MAX_DIACR)
+				return fail(EINVAL);
+
+			con->nr_diacrs = kd->kb_cnt;
+			for (i = 0; i < kd->kb_cnt; i++) {
+				con->diacrs[i].diacr  = kd->kbdiacr[i].diacr;
+				con->diacrs[i].base   = kd->kbdiacr[i].base;
+				con->diacrs[i].result = kd->kbdiacr[i].result;
+			}
+			return 0;
+		}
+		case KDGKBDIACRUC: {
+			struct kbdiacrsuc *kdu = (struct kbdiacrsuc *) arg;
+
+			kdu->kb_cnt = con->nr_diacrs;
+			memcpy(kdu->kbdiacruc, con->diacrs, con->nr_diacrs * sizeof(struct kbdiacruc));
+			return 0;
+		}
+		case KDSKBDIACRUC: {
+			const struct kbdiacrsuc *kdu = (const struct kbdiacrsuc *) arg;
+
+			if (kdu->kb_cnt > MAX_DIACR)
+				return fail(EINVAL);
+
+			con->nr_diacrs = kdu->kb_cnt;
+			memcpy(con->diacrs, kdu->kbdiacruc, kdu->kb_cnt * sizeof(struct kbdiacruc));
+			return 0;
+		}
+	}
+
+	return fail(ENOTTY);
+}
+
+static void
+copy_glyphs(unsigned char *dst, unsigned int dst_pitch,
+            const unsigned char *src, unsigned int src_pitch,
+            unsigned int count, unsigned int width, unsigned int height)
+{
+	unsigned int bytewidth = (width + 7) / 8;
+	unsigned int i;
+
+	for (i = 0; i < count; i++) {
+		memset(dst + i * dst_pitch * bytewidth, 0, dst_pitch * bytewidth);
+		memcpy(dst + i * dst_pitch * bytewidth, src + i * src_pitch * bytewidth,
+		       height * bytewidth);
+	}
+}
+
+static int
+font_op(struct kbd_fake_console *con, struct console_font_op *op)
+{
+	unsigned int vpitch = 32;
+	unsigned int max_width = 32, max_height = 32;
+	unsigned char *font;
+
+	switch (op->op) {
+#ifdef KD_FONT_OP_SET_TALL
+		case KD_FONT_OP_SET_TALL:
+			vpitch     = op->height;
+			max_width  = FONT_MAX_WIDTH;
+			max_height = FONT_MAX_HEIGHT;
+			/* fallthrough */
+#endif
+		case KD_FONT_OP_SET:
+			if (!op->data || !op->charcount || op->charcount > FONT_MAX_COUNT ||
+			    !op->width || op->width > max_width ||
+			    !op->height || op->height > max_height)
+				return fail(EINVAL);
+
+			font = malloc(op->charcount * vpitch * ((op->width + 7) / 8));
+			if (!font)
+				return fail(ENOMEM);
+
+			copy_glyphs(font, vpitch, op->data, vpitch,
+			            op->charcount, op->width, op->height);
+
+			free(con->font);
+			con->font        = font;
+			con->font_count  = op->charcount;
+			con->font_width  = op->width;
+			con->font_height = op->height;
+			con->font_vpitch = vpitch;
+			return 0;
+
+#ifdef KD_FONT_OP_GET_TALL
+		case KD_FONT_OP_GET_TALL:
+			vpitch = con->font_height;
+			/* fallthrough */
+#endif
+		case KD_FONT_OP_GET:
+			if (op->data && con->font_count > op->charcount)
+				return fail(ENOSPC);
+			if (con->font_width > op->width || con->font_height > op->height ||
+			    con->font_height > vpitch)
+				return fail(ENOSPC);
+
+			op->width     = con->font_width;
+			op->height    = con->font_height;
+			op->charcount = con->font_count;
+
+			if (op->data)
+				copy_glyphs(op->data, vpitch, con->font, con->font_vpitch,
+				            con->font_count, con->font_width, con->font_height);
+			return 0;
+
+		case KD_FONT_OP_SET_DEFAULT:
+			set_default_font(con);
+			return con->font ? 0 : fail(ENOMEM);
+	}
+
+	return fail(ENOSYS);
+}
+
+static int
+get_unimap(struct kbd_fake_console *con, struct unimapdesc *ud)
+{
+	unsigned int i, n = 0, room = ud->entry_ct;
+
+	for (i = 0; con->unimap && i < 0x10000; i++) {
+		if (!con->unimap[i])
+			continue;
+		if (n < room && ud->entries) {
+			ud->entries[n].unicode = (unsigned short) i;
+			ud->entries[n].fontpos = (unsigned short) (con->unimap[i] - 1);
+		}
+		n++;
+	}
+
+	ud->entry_ct = (unsigned short) n;
+
+	return (n <= room) ? 0 : fail(ENOMEM);
+}
+
+static int
+put_unimap(struct kbd_fake_console *con, const struct unimapdesc *ud)
+{
+	unsigned int i;
+
+	if (!con->unimap) {
+		con->unimap = calloc(0x10000, sizeof(unsigned short));
+		if (!con->unimap)
+			return fail(ENOMEM);
+	}
+
+	for (i = 0; i < ud->entry_ct; i++) {
+		unsigned short *pos = &con->unimap[ud->entries[i].unicode];
+
+		if (ud->entries[i].fontpos >= FONT_MAX_COUNT)
+			return fail(EINVAL);
+		if (!*pos)
+			con->unimap_count++;
+		*pos = (unsigned short) (ud->entries[i].fontpos + 1);
+	}
+
+	return 0;
+}
+
+static int
+get_scrnmap(struct kbd_fake_console *con, unsigned char *map)
+{
+	unsigned int i, ch;
+
+	for (i = 0; i < E_TABSZ; i++) {
+		unsigned short uc = con->uni_scrnmap[i];
+
+		if ((uc & ~0x1ff) == 0xf000)
+			ch = uc & 0x1ff;
+		else if (con->unimap && con->unimap[uc])
+			ch = con->unimap[uc] - 1U;
+		else
+			ch = 0;
+
+		map[i] = (unsigned char) ((ch & ~0xffU) ? 0 : ch);
+	}
+
+	return 0;
+}
+
+int
+kbd_fake_console_ioctl(void *data, int fd KBD_ATTR_UNUSED, unsigned long request, unsigned long arg)
+{
+	struct kbd_fake_console *con = data;
+	int i, rc = 0;
+
+	count_request(con, request);
+
+	switch (request) {
+		case KDGKBENT:
+			rc = get_kbent(con, (struct kbentry *) arg);
+			break;
+		case KDSKBENT:
+			rc = set_kbent(con, (const struct kbentry *) arg);
+			break;
+		case KDGKBSENT:
+			rc = get_kbsent(con, (struct kbsentry *) arg);
+			break;
+		case KDSKBSENT:
+			rc = set_kbsent(con, (const struct kbsentry *) arg);
+			break;
+		case KDGKBDIACR:
+		case KDSKBDIACR:
+		case KDGKBDIACRUC:
+		case KDSKBDIACRUC:
+			rc = diacr_ioctl(con, request, arg);
+			break;
+		case KDGKBMODE:
+			*(int *) arg = con->kbd_mode;
+			break;
+		case KDSKBMODE:
+			if (arg != K_RAW && arg != K_XLATE && arg != K_MEDIUMRAW &&
+			    arg != K_UNICODE && arg != K_OFF)
+				rc = fail(EINVAL);
+			else
+				con->kbd_mode = (int) arg;
+			break;
+		case KDGKBMETA:
+			*(int *) arg = con->meta_mode;
+			break;
+		case KDSKBMETA:
+			if (arg != K_METABIT && arg != K_ESCPREFIX)
+				rc = fail(EINVAL);
+			else
+				con->meta_mode = (int) arg;
+			break;
+		case KDGKBTYPE:
+			*(char *) arg = KB_101;
+			break;
+		case KDGETMODE:
+			*(int *) arg = con->kd_mode;
+			break;
+		case KDSETMODE:
+			if (arg != KD_TEXT && arg != KD_GRAPHICS)
+				rc = fail(EINVAL);
+			else
+				con->kd_mode = (int) arg;
+			break;
+		case KDGETLED:
+			*(char *) arg = (char) con->leds;
+			break;
+		case KDSETLED:
+			if (arg & ~7UL)
+				rc = fail(EINVAL);
+			else
+				con->leds = (unsigned char) arg;
+			break;
+		case KDGKBLED:
+			*(char *) arg = (char) con->led_flags;
+			break;
+		case KDSKBLED:
+			if (arg & ~0x77UL)
+				rc = fail(EINVAL);
+			else
+				con->led_flags = (unsigned char) arg;
+			break;
+		case KDFONTOP:
+			rc = font_op(con, (struct console_font_op *) arg);
+			break;
+		case GIO_SCRNMAP:
+			rc = get_scrnmap(con, (unsigned char *) arg);
+			break;
+		case PIO_SCRNMAP:
+			for (i = 0; i < E_TABSZ; i++)
+				con->uni_scrnmap[i] = (unsigned short) (0xf000 | ((unsigned char *) arg)[i]);
+			break;
+		case GIO_UNISCRNMAP:
+			memcpy((unsigned short *) arg, con->uni_scrnmap, sizeof(con->uni_scrnmap));
+			break;
+		case PIO_UNISCRNMAP:
+			memcpy(con->uni_scrnmap, (const unsigned short *) arg, sizeof(con->uni_scrnmap));
+			break;
+		case PIO_UNIMAPCLR:
+			clear_unimap(con);
+			break;
+		case GIO_UNIMAP:
+			rc = get_unimap(con, (struct unimapdesc *) arg);
+			break;
+		case PIO_UNIMAP:
+			rc = put_unimap(con, (const struct unimapdesc *) arg);
+			break;
+		case GIO_CMAP:
+			memcpy((unsigned char *) arg, con->cmap, sizeof(con->cmap));
+			break;
+		case PIO_CMAP:
+			memcpy(con->cmap, (const unsigned char *) arg, sizeof(con->cmap));
+			break;
+		default:
+			rc = fail(ENOTTY);
+			break;
+	}
+
+	if (rc)
+		con->failures++;
+
+	return rc;
+}
@@ -0,0 +1,68 @@
+/*
+ * files.c
+ *
+ * The keymap search path shared by loadkeys and consoleprofile, and a
+ * reader of whole files.
+ */
+#include "config.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+
+#include "libcommon.h"
+
+static const char *const keymap_dirpath[] = {
+	DATADIR "/" KEYMAPDIR "/**",
+	KERNDIR "/",
+	NULL
+};
+
+const char *const kbd_keymap_suffixes[] = {
+	"",
+	".kmap",
+	".map",
+	NULL
+};
+
+const char *const *
+kbd_keymap_dirpath(void)
+{
+	static const char *dirpath[] = { NULL, NULL };
+
+	if ((dirpath[0] = getenv("LOADKEYS_KEYMAP_PATH")) != NULL)
+		return dirpath;
+
+	return keymap_dirpath;
+}
+
+unsigned char *
+kbd_read_file(const char *filename, size_t *len)
+{
+	unsigned char *data = NULL;
+	size_t size = 0;
+	FILE *fp;
+
+	if (!strcmp(filename, "-"))
+		fp = stdin;
+	else if (!(fp = fopen(filename, "r")))
+		kbd_error(EXIT_FAILURE, errno, _("Unable to open file: %s"), filename);
+
+	*len = 0;
+	do {
+		if (*len == size) {
+			size = size ? size * 2 : 65536;
+			if (!(data = realloc(data, size)))
+				kbd_error(EXIT_FAILURE, errno, "realloc");
+		}
+		*len += fread(data + *len, 1, size - *len, fp);
+	} while (*len == size);
+
+	if (ferror(fp))
+		kbd_error(EXIT_FAILURE, errno, _("Unable to read file: %s"), filename);
+
+	if (fp != stdin)
+		fclose(fp);
+	return data;
+}
@@ -91,3 +91,49 @@ getfd(const char *fnam)
 	/* total failure */
 	exit(1);
 }
+
+/*
+ * The console map is activated by writing an escape sequence to the console,
+ * so try to open it for writing first.
+ */
+static int
+open_vt_device(const char *tty)
+{
+	int fd = open(tty, O_RDWR | O_NOCTTY);
+
+	if (fd < 0 && (errno == EACCES || errno == EPERM))
+		fd = open(tty, O_RDONLY | O_NOCTTY);
+	return fd;
+}
+
+/*
+ * Opens the console VT to change its font and maps. A console in graphics
+ * mode is closed again and skipped, the font can not be changed there.
+ */
+int
+kbd_open_text_vt(unsigned int vt, int verbose)
+{
+	char tty[32];
+	int fd, kd_mode;
+
+	sprintf(tty, "/dev/tty%u", vt);
+	fd = open_vt_device(tty);
+	if (fd < 0 && errno == ENOENT) {
+		sprintf(tty, "/dev/vc/%u", vt);
+		fd = open_vt_device(tty);
+	}
+	if (fd < 0) {
+		kbd_warning(errno, _("unable to open %s"), tty);
+		return -1;
+	}
+
+	kd_mode = -1;
+	if (!ioctl(fd, KDGETMODE, &kd_mode) && kd_mode == KD_GRAPHICS) {
+		if (verbose)
+			kbd_warning(0, "graphics console %s skipped", tty);
+		close(fd);
+		return -1;
+	}
+
+	return fd;
+}
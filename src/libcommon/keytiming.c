@@ -0,0 +1,268 @@
+/*
+ * keytiming.c
+ *
+ * Timing of keyboard events read from a console in MEDIUMRAW mode: the
+ * intervals between the events, the autorepeat delay and the autorepeat
+ * period, with their statistics and histograms.
+ */
+#include "config.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <errno.h>
+#include <poll.h>
+#include <time.h>
+
+#include "libcommon.h"
+
+#define NSEC_PER_MSEC 1000000ULL
+
+/* Histogram buckets are powers of two of milliseconds, from <1 ms up. */
+#define HIST_BUCKETS 12
+#define HIST_WIDTH   40
+
+unsigned long long
+kbd_monotonic_ns(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+
+	return (unsigned long long) ts.tv_sec * 1000000000ULL + (unsigned long long) ts.tv_nsec;
+}
+
+size_t
+kbd_decode_mediumraw(const unsigned char *buf, size_t len, size_t *used,
+                     unsigned long long time, struct kbd_key_event *events)
+{
+	size_t i = 0, n = 0;
+
+	while (i < len) {
+		events[n].time    = time;
+		events[n].pressed = !(buf[i] & 0x80);
+
+		/* 2.6 allows 3-byte reports for keycodes above 127 */
+		if ((buf[i] & 0x7f) == 0) {
+			if (i + 2 >= len)
+				break;
+
+			events[n].keycode = ((unsigned int) (buf[i + 1] & 0x7f) << 7) |
+			                    (buf[i + 2] & 0x7f);
+			i += 3;
+		} else {
+			events[n].keycode = buf[i] & 0x7f;
+			i++;
+		}
+		n++;
+	}
+
+	*used = i;
+	return n;
+}
+
+void
+kbd_series_add(struct kbd_series *s, unsigned long long value)
+{
+	if (s->count == s->size) {
+		s->size   = s->size ? s->size * 2 : 64;
+		s->values = realloc(s->values, s->size * sizeof(s->values[0]));
+
+		if (!s->values)
+			kbd_error(EXIT_FAILURE, errno, "realloc");
+	}
+
+	s->values[s->count++] = value;
+}
+
+void
+kbd_series_free(struct kbd_series *s)
+{
+	free(s->values);
+	memset(s, 0, sizeof(*s));
+}
+
+static int
+compare_values(const void *a, const void *b)
+{
+	unsigned long long x = *(const unsigned long long *) a;
+	unsigned long long y = *(const unsigned long long *) b;
+
+	return (x > y) - (x < y);
+}
+
+static double
+percentile(const struct kbd_series *s, unsigned int p)
+{
+	return (double) s->values[(s->count - 1) * p / 100] / NSEC_PER_MSEC;
+}
+
+int
+kbd_series_stats(struct kbd_series *s, struct kbd_series_stats *st)
+{
+	unsigned long long sum = 0;
+	double dev = 0, v;
+	size_t i;
+
+	if (!s->count)
+		return -1;
+
+	qsort(s->values, s->count, sizeof(s->values[0]), compare_values);
+
+	for (i = 0; i < s->count; i++)
+		sum += s->values[i];
+
+	st->count = s->count;
+	st->mean  = (double) sum / (double) s->count / NSEC_PER_MSEC;
+
+	for (i = 0; i < s->count; i++) {
+		v = (double) s->values[i] / NSEC_PER_MSEC - st->mean;
+		dev += v < 0 ? -v : v;
+	}
+
+	st->jitter = dev / (double) s->count;
+	st->min    = percentile(s, 0);
+	st->p50    = percentile(s, 50);
+	st->p90    = percentile(s, 90);
+	st->p99    = percentile(s, 99);
+	st->max    = percentile(s, 100);
+
+	return 0;
+}
+
+void
+kbd_series_print(struct kbd_series *s, const char *title)
+{
+	struct kbd_series_stats st;
+	size_t hist[HIST_BUCKETS], most = 0, i;
+	unsigned long long ms;
+	unsigned int b, lo, w;
+
+	printf("%s:\n", title);
+
+	if (kbd_series_stats(s, &st) < 0) {
+		printf(_("  no samples\n\n"));
+		return;
+	}
+
+	printf(_("  samples %zu, mean %.3f ms, jitter %.3f ms\n"), st.count, st.mean, st.jitter);
+	printf(_("  min %.3f, p50 %.3f, p90 %.3f, p99 %.3f, max %.3f ms\n"),
+	       st.min, st.p50, st.p90, st.p99, st.max);
+
+	memset(hist, 0, sizeof(hist));
+
+	for (i = 0; i < s->count; i++) {
+		ms = s->values[i] / NSEC_PER_MSEC;
+
+		for (b = 0; b < HIST_BUCKETS - 1 && ms >= (1ULL << b); b++)
+			;
+
+		if (++hist[b] > most)
+			most = hist[b];
+	}
+
+	for (b = 0; b < HIST_BUCKETS; b++) {
+		if (!hist[b])
+			continue;
+
+		lo = b ? 1U << (b - 1) : 0;
+		w  = (unsigned int) ((hist[b] * HIST_WIDTH + most - 1) / most);
+
+		if (b < HIST_BUCKETS - 1)
+			printf("  %5u - %-5u ms %6zu ", lo, 1U << b, hist[b]);
+		else
+			printf("  %5u+        ms %6zu ", lo, hist[b]);
+
+		while (w--)
+			putchar('#');
+		putchar('\n');
+	}
+	putchar('\n');
+}
+
+void
+kbd_key_timing_add(struct kbd_key_timing *kt, const struct kbd_key_event *ev)
+{
+	if (kt->last)
+		kbd_series_add(&kt->events, ev->time - kt->last);
+	kt->last = ev->time;
+
+	if (!ev->pressed) {
+		if (kt->held == ev->keycode + 1)
+			kt->held = 0;
+		return;
+	}
+
+	/* a press without a release of the same key is an autorepeat */
+	if (kt->held == ev->keycode + 1) {
+		if (kt->repeated)
+			kbd_series_add(&kt->repeats, ev->time - kt->repeated);
+		else
+			kbd_series_add(&kt->delays, ev->time - kt->pressed);
+
+		kt->repeated = ev->time;
+		return;
+	}
+
+	kt->held     = ev->keycode + 1;
+	kt->pressed  = ev->time;
+	kt->repeated = 0;
+}
+
+void
+kbd_key_timing_free(struct kbd_key_timing *kt)
+{
+	kbd_series_free(&kt->events);
+	kbd_series_free(&kt->delays);
+	kbd_series_free(&kt->repeats);
+}
+
+int
+kbd_key_timing_read(struct kbd_key_timing *kt, int fd, int timeout,
+                    void (*callback)(const struct kbd_key_event *ev, void *data),
+                    void *data)
+{
+	struct kbd_key_event events[4096];
+	unsigned char buf[4096];
+	unsigned long long now;
+	struct pollfd pfd;
+	size_t pending = 0, used, nev, i;
+	ssize_t n;
+	int rc;
+
+	pfd.fd     = fd;
+	pfd.events = POLLIN;
+
+	while ((rc = poll(&pfd, 1, timeout * 1000)) != 0) {
+		if (rc < 0) {
+			if (errno == EINTR)
+				continue;
+			return -1;
+		}
+
+		/* each read is stamped when it returns, not when poll() woke up */
+		while ((n = read(fd, buf + pending, sizeof(buf) - pending)) > 0) {
+			now = kbd_monotonic_ns();
+			nev = kbd_decode_mediumraw(buf, pending + (size_t) n, &used, now, events);
+
+			for (i = 0; i < nev; i++) {
+				kbd_key_timing_add(kt, &events[i]);
+				if (callback)
+					callback(&events[i], data);
+			}
+
+			pending = pending + (size_t) n - used;
+			memmove(buf, buf + used, pending);
+		}
+
+		if (n < 0 && errno != EAGAIN && errno != EINTR)
+			return -1;
+
+		/* hangup: poll() would keep reporting it */
+		if (n == 0)
+			break;
+	}
+
+	return 0;
+}
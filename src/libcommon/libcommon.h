@@ -1,6 +1,8 @@
 #ifndef _LIBCOMMON_H_
 #define _LIBCOMMON_H_
 
+#include <stdio.h>
+
 #include <kbd/compiler_attributes.h>
 
 #ifndef LOCALEDIR
@@ -39,6 +41,7 @@ struct kbd_help {
 
 // getfd.c
 int getfd(const char *fnam);
+int kbd_open_text_vt(unsigned int vt, int verbose);
 
 // version.c
 extern const char *progname;
@@ -61,4 +64,95 @@ kbd_error(const int exitnum, const int errnum, const char *fmt, ...)
 	KBD_ATTR_PRINTF(3, 4)
 	KBD_ATTR_NORETURN;
 
+// vtrgb.c
+extern const unsigned char kbd_vga_colors[3 * 16];
+
+/* Reads a color map in the decimal or hexadecimal format of setvtrgb into
+ * CMAP, which has room for 3 * 16 values. Exits on error. */
+void kbd_parse_vtrgb(FILE *fd, const char *filename, unsigned char *cmap);
+
+// keytiming.c
+struct kbd_key_event {
+	unsigned long long time; /* CLOCK_MONOTONIC, in nanoseconds */
+	unsigned int keycode;
+	int pressed;
+};
+
+unsigned long long kbd_monotonic_ns(void);
+
+/* Decodes the MEDIUMRAW reports in BUF into EVENTS, which has room for LEN
+ * events, all stamped with TIME. A 3-byte report cut by the end of BUF is
+ * not consumed. Stores the number of bytes used in USED and returns the
+ * number of events. */
+size_t kbd_decode_mediumraw(const unsigned char *buf, size_t len, size_t *used,
+                            unsigned long long time, struct kbd_key_event *events);
+
+/* Series of intervals, in nanoseconds. */
+struct kbd_series {
+	unsigned long long *values;
+	size_t count;
+	size_t size;
+};
+
+/* In milliseconds. The jitter is the mean absolute deviation. */
+struct kbd_series_stats {
+	size_t count;
+	double mean, jitter;
+	double min, p50, p90, p99, max;
+};
+
+void kbd_series_add(struct kbd_series *s, unsigned long long value);
+void kbd_series_free(struct kbd_series *s);
+
+/* Sorts the series. Returns -1 if it is empty. */
+int kbd_series_stats(struct kbd_series *s, struct kbd_series_stats *st);
+
+/* Prints the statistics and a histogram of the series to stdout. */
+void kbd_series_print(struct kbd_series *s, const char *title);
+
+struct kbd_key_timing {
+	struct kbd_series events;  /* between two events */
+	struct kbd_series delays;  /* from a press to its first autorepeat */
+	struct kbd_series repeats; /* between two autorepeats */
+
+	unsigned long long last, pressed, repeated;
+	unsigned int held; /* keycode + 1 of the key being held */
+};
+
+void kbd_key_timing_add(struct kbd_key_timing *kt, const struct kbd_key_event *ev);
+void kbd_key_timing_free(struct kbd_key_timing *kt);
+
+/* Reads the MEDIUMRAW reports of FD, which must be non-blocking, until no
+ * event comes for TIMEOUT seconds or the console hangs up. Each event is
+ * added to KT and then passed to CALLBACK, if it is not NULL. Returns -1
+ * with errno set on error. */
+int kbd_key_timing_read(struct kbd_key_timing *kt, int fd, int timeout,
+                        void (*callback)(const struct kbd_key_event *ev, void *data),
+                        void *data);
+
+// files.c
+extern const char *const kbd_keymap_suffixes[];
+
+/* The directories searched for keymaps, or LOADKEYS_KEYMAP_PATH if it is set. */
+const char *const *kbd_keymap_dirpath(void);
+
+/* Reads the whole file, or stdin if FILENAME is "-", into a buffer to be
+ * freed by the caller and stores its size in LEN. Exits on error. */
+unsigned char *kbd_read_file(const char *filename, size_t *len);
+
+// fakeconsole.c
+struct kbd_fake_console;
+
+struct kbd_fake_console *kbd_fake_console_new(void);
+void kbd_fake_console_free(struct kbd_fake_console *con);
+
+/* Has the signature of the ioctl callback of the libkeymap and libkfont
+ * console operations. Pass the fake console as data. */
+int kbd_fake_console_ioctl(void *data, int fd, unsigned long request, unsigned long arg);
+
+/* Number of calls with the request, or of all calls if request is 0. */
+unsigned long kbd_fake_console_calls(const struct kbd_fake_console *con, unsigned long request);
+unsigned long kbd_fake_console_failures(const struct kbd_fake_console *con);
+void kbd_fake_console_reset_calls(struct kbd_fake_console *con);
+
 #endif /* _LIBCOMMON_H_ */
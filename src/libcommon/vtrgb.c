@@ -0,0 +1,100 @@
+#include "config.h"
+
+#include <stdio.h>
+#include <errno.h>
+#include <stdlib.h>
+
+#include "libcommon.h"
+
+/* Standard VGA terminal colors, matching those hardcoded in the Linux kernel's
+ * drivers/char/vt.c
+ */
+const unsigned char kbd_vga_colors[3 * 16] = {
+	0x00, 0x00, 0x00,
+	0xaa, 0x00, 0x00,
+	0x00, 0xaa, 0x00,
+	0xaa, 0x55, 0x00,
+	0x00, 0x00, 0xaa,
+	0xaa, 0x00, 0xaa,
+	0x00, 0xaa, 0xaa,
+	0xaa, 0xaa, 0xaa,
+	0x55, 0x55, 0x55,
+	0xff, 0x55, 0x55,
+	0x55, 0xff, 0x55,
+	0xff, 0xff, 0x55,
+	0x55, 0x55, 0xff,
+	0xff, 0x55, 0xff,
+	0x55, 0xff, 0xff,
+	0xff, 0xff, 0xff,
+};
+
+static void
+parse_dec_file(FILE *fd, const char *filename, unsigned char *cmap)
+{
+	int c;
+	unsigned int rows, cols, val;
+
+	for (rows = 0; rows < 3; rows++) {
+		for (cols = 0; cols < 16; cols++) {
+			if ((c = fscanf(fd, "%u", &val)) != 1) {
+				if (c == EOF)
+					kbd_error(EXIT_FAILURE, errno, "fscanf");
+
+				kbd_error(EXIT_FAILURE, 0, _("Error: %s: Invalid value in field %u in line %u."),
+				          filename, rows + 1, cols + 1);
+			}
+
+			cmap[rows + cols * 3] = (unsigned char)val;
+
+			if (cols < 15 && fgetc(fd) != ',')
+				kbd_error(EXIT_FAILURE, 0, _("Error: %s: Insufficient number of fields in line %u."),
+				          filename, rows + 1);
+		}
+
+		if ((c = fgetc(fd)) == EOF)
+			kbd_error(EXIT_FAILURE, 0, _("Error: %s: Line %u has ended unexpectedly."),
+			          filename, rows + 1);
+
+		if (c != '\n')
+			kbd_error(EXIT_FAILURE, 0, _("Error: %s: Line %u is too long."),
+			          filename, rows + 1);
+	}
+}
+
+static void
+parse_hex_file(FILE *fd, const char *filename, unsigned char *cmap)
+{
+	int c,l;
+	unsigned int r, g, b;
+
+	for (l = 0; l < 16; l++) {
+		if ((c = fscanf(fd, "#%2x%2x%2x\n", &r, &g, &b)) != 3) {
+			if (c == EOF)
+				kbd_error(EXIT_FAILURE, 0, _("Error: %s: Insufficient number of colors/lines: %u"),
+				          filename, l);
+
+			kbd_error(EXIT_FAILURE, 0, _("Error: %s: Invalid value in line %u."),
+			          filename, l + 1);
+		}
+
+		cmap[l * 3]     = (unsigned char)r;
+		cmap[l * 3 + 1] = (unsigned char)g;
+		cmap[l * 3 + 2] = (unsigned char)b;
+	}
+}
+
+void
+kbd_parse_vtrgb(FILE *fd, const char *filename, unsigned char *cmap)
+{
+	int c = fgetc(fd);
+
+	if (c == EOF)
+		kbd_error(EXIT_FAILURE, 0, _("Error: %s: File ended unexpectedly."),
+		          filename);
+	ungetc(c, fd);
+
+	if (c == '#')
+		parse_hex_file(fd, filename, cmap);
+	else
+		parse_dec_file(fd, filename, cmap);
+}
@@ -3,6 +3,7 @@
 #include <string.h>
 #include <stdlib.h>
 #include <stdarg.h>
+#include <sys/ioctl.h>
 
 #include "keymap.h"
 
@@ -149,6 +150,27 @@ int lk_set_keywords(struct lk_ctx *ctx, lk_keywords keywords)
 	return 0;
 }
 
+static int
+default_ioctl(void *data KBD_ATTR_UNUSED, int fd, unsigned long request, unsigned long arg)
+{
+	return ioctl(fd, request, arg);
+}
+
+static const struct lk_console_ops default_console_ops = {
+	.ioctl = default_ioctl,
+};
+
+int lk_set_console_ops(struct lk_ctx *ctx, const struct lk_console_ops *ops, void *data)
+{
+	if (!ctx || (ops && !ops->ioctl))
+		return -1;
+
+	ctx->console_ops  = ops ? ops : &default_console_ops;
+	ctx->console_data = ops ? data : NULL;
+
+	return 0;
+}
+
 static int
 init_array(struct lk_ctx *ctx, struct lk_array **arr, ssize_t size)
 {
@@ -186,6 +208,7 @@ lk_init(void)
 
 	lk_set_log_fn(ctx, log_file, stderr);
 	lk_set_log_priority(ctx, LOG_ERR);
+	lk_set_console_ops(ctx, NULL, NULL);
 
 	if (init_array(ctx, &ctx->keymap, sizeof(void *)) < 0 ||
 	    init_array(ctx, &ctx->func_table, sizeof(void *)) < 0 ||
@@ -262,6 +285,9 @@ int lk_free(struct lk_ctx *ctx)
 		ctx->accent_table = NULL;
 	}
 
+	free(ctx->compose_index);
+	ctx->compose_index = NULL;
+
 	if (ctx->key_constant) {
 		lk_array_free(ctx->key_constant);
 		free(ctx->key_constant);
@@ -274,6 +300,9 @@ int lk_free(struct lk_ctx *ctx)
 		ctx->key_line = NULL;
 	}
 
+	free(ctx->uni_syms);
+	ctx->uni_syms = NULL;
+
 	if (ctx->kbdfile_ctx != NULL)
 		ctx->kbdfile_ctx = kbdfile_context_free(ctx->kbdfile_ctx);
 
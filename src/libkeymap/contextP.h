@@ -11,6 +11,15 @@
  */
 #define MAX_INCLUDE_DEPTH 20
 
+/**
+ * @brief Entry of the Unicode to keysym name index.
+ */
+struct lk_uni_sym {
+	unsigned short uni;
+	unsigned int order;
+	const char *name;
+};
+
 /**
  * @brief Opaque object representing the library context.
  */
@@ -60,11 +69,31 @@ struct lk_ctx {
 	 */
 	int log_priority;
 
+	/**
+	 * Backend used to access the console.
+	 */
+	const struct lk_console_ops *console_ops;
+	void *console_data;
+
 	/**
 	 * User defined charset.
 	 */
 	unsigned short charset;
 
+	/**
+	 * Unicode to keysym name index, built on first use.
+	 */
+	struct lk_uni_sym *uni_syms;
+	size_t uni_syms_size;
+
+	/**
+	 * Hash index of the accent table keyed by (diacr, base). Slots hold
+	 * a position in the accent table plus one, 0 marks an empty slot.
+	 * Built on first use and dropped when entries are changed by position.
+	 */
+	unsigned int *compose_index;
+	unsigned int compose_index_size;
+
 	/* Fields used by keymap parser */
 
 	struct lk_array *key_constant;
@@ -107,4 +136,43 @@ struct lk_ctx {
  */
 #define ERR(ctx, arg...) lk_log_cond(ctx, LOG_ERR, ##arg)
 
+/**
+ * Performs a console ioctl through the backend of the context.
+ * @param ctx is a keymap library context.
+ * @param fd is the console file descriptor.
+ * @param request is the ioctl request.
+ * @param arg is the ioctl argument.
+ */
+static inline int
+console_ioctl(struct lk_ctx *ctx, int fd, unsigned long request, unsigned long arg)
+{
+	return ctx->console_ops->ioctl(ctx->console_data, fd, request, arg);
+}
+
+/**
+ * Reads one entry of the kernel keymap (KDGKBENT).
+ * @param ctx is a keymap library context.
+ * @param fd is the console file descriptor.
+ * @param t is the table.
+ * @param i is the keycode.
+ * @param value is where the entry is stored.
+ *
+ * @return 0 on success, -1 on error.
+ */
+int kernel_get_key(struct lk_ctx *ctx, int fd, int t, int i, unsigned short *value);
+
+/**
+ * Hash function for the (diacr, base) pairs of the accent table.
+ * @param diacr is a diacritic.
+ * @param base is a base character.
+ */
+static inline unsigned int
+compose_hash(unsigned int diacr, unsigned int base)
+{
+	unsigned int h = diacr * 0x9e3779b1U;
+
+	h ^= base + 0x7f4a7c15U + (h << 6) + (h >> 2);
+	return h * 0x85ebca6bU;
+}
+
 #endif /* LK_CONTEXTP_H */
@@ -39,9 +39,108 @@ int lk_get_diacr(struct lk_ctx *ctx, int index, struct lk_kbdiacr *dcr)
 	return 0;
 }
 
+static void
+compose_index_drop(struct lk_ctx *ctx)
+{
+	free(ctx->compose_index);
+	ctx->compose_index      = NULL;
+	ctx->compose_index_size = 0;
+}
+
+/*
+ * Returns the slot of the index that holds the (diacr, base) pair, or the
+ * empty slot where the pair would be inserted.
+ */
+static unsigned int *
+compose_index_slot(struct lk_ctx *ctx, unsigned int diacr, unsigned int base)
+{
+	unsigned int mask = ctx->compose_index_size - 1;
+	unsigned int h    = compose_hash(diacr, base) & mask;
+
+	while (ctx->compose_index[h]) {
+		struct lk_kbdiacr *ptr;
+
+		ptr = lk_array_get_ptr(ctx->accent_table, ctx->compose_index[h] - 1);
+		if (ptr->diacr == diacr && ptr->base == base)
+			break;
+
+		h = (h + 1) & mask;
+	}
+
+	return &ctx->compose_index[h];
+}
+
+/*
+ * Rebuilds the index with room for count entries. When the accent table
+ * has duplicates, the index points to the last one.
+ */
+static int
+compose_index_build(struct lk_ctx *ctx, unsigned int count)
+{
+	unsigned int size = 64;
+	ssize_t i;
+
+	while (size < 2 * count)
+		size <<= 1;
+
+	compose_index_drop(ctx);
+
+	ctx->compose_index = calloc(size, sizeof(unsigned int));
+	if (!ctx->compose_index)
+		return -1;
+	ctx->compose_index_size = size;
+
+	for (i = 0; i < ctx->accent_table->total; i++) {
+		struct lk_kbdiacr *ptr = lk_array_get_ptr(ctx->accent_table, i);
+		if (ptr)
+			*compose_index_slot(ctx, ptr->diacr, ptr->base) = (unsigned int) i + 1;
+	}
+
+	return 0;
+}
+
+int lk_find_compose(struct lk_ctx *ctx, struct lk_kbdiacr *dcr)
+{
+	struct lk_kbdiacr *ptr;
+	unsigned int *slot;
+
+	if (!ctx->compose_index &&
+	    compose_index_build(ctx, (unsigned int) ctx->accent_table->count) < 0) {
+		ERR(ctx, _("out of memory"));
+		return -1;
+	}
+
+	slot = compose_index_slot(ctx, dcr->diacr, dcr->base);
+	if (!*slot)
+		return -1;
+
+	ptr = lk_array_get_ptr(ctx->accent_table, *slot - 1);
+	dcr->result = ptr->result;
+
+	return (int) *slot - 1;
+}
+
 int lk_append_diacr(struct lk_ctx *ctx, struct lk_kbdiacr *dcr)
 {
 	struct lk_kbdiacr *ptr;
+	unsigned int *slot;
+	unsigned int count = (unsigned int) ctx->accent_table->count + 1;
+	ssize_t pos;
+
+	if (!ctx->compose_index || 2 * count > ctx->compose_index_size) {
+		if (compose_index_build(ctx, count) < 0) {
+			ERR(ctx, _("out of memory"));
+			return -1;
+		}
+	}
+
+	slot = compose_index_slot(ctx, dcr->diacr, dcr->base);
+	if (*slot) {
+		/* a later definition of the same pair replaces the earlier one */
+		ptr = lk_array_get_ptr(ctx->accent_table, *slot - 1);
+		ptr->result = dcr->result;
+		return 0;
+	}
 
 	ptr = malloc(sizeof(struct lk_kbdiacr));
 	if (!ptr) {
@@ -53,7 +152,26 @@ int lk_append_diacr(struct lk_ctx *ctx, struct lk_kbdiacr *dcr)
 	ptr->base   = dcr->base;
 	ptr->result = dcr->result;
 
-	lk_array_append(ctx->accent_table, &ptr);
+	pos = ctx->accent_table->count;
+
+	if (lk_array_append(ctx->accent_table, &ptr) < 0) {
+		free(ptr);
+		ERR(ctx, _("out of memory"));
+		return -1;
+	}
+
+	/*
+	 * If the table has holes, the new entry may have replaced an indexed
+	 * one. Rebuild the index on next use in that case.
+	 */
+	if (pos + 1 < ctx->accent_table->total)
+		compose_index_drop(ctx);
+	else
+		*slot = (unsigned int) pos + 1;
+
+	if (ctx->accent_table->count == MAX_DIACR + 1)
+		ERR(ctx, _("too many compose definitions, only the first %d can be loaded"),
+		    MAX_DIACR);
 
 	return 0;
 }
@@ -73,6 +191,7 @@ int lk_add_diacr(struct lk_ctx *ctx, int index, struct lk_kbdiacr *dcr)
 	ptr->result = dcr->result;
 
 	lk_array_set(ctx->accent_table, index, &ptr);
+	compose_index_drop(ctx);
 
 	return 0;
 }
@@ -80,7 +199,11 @@ int lk_add_diacr(struct lk_ctx *ctx, int index, struct lk_kbdiacr *dcr)
 int lk_del_diacr(struct lk_ctx *ctx, int index)
 {
 	int rc;
+
+	free(lk_array_get_ptr(ctx->accent_table, index));
+
 	rc = lk_array_unset(ctx->accent_table, index);
+	compose_index_drop(ctx);
 	if (rc) {
 		ERR(ctx, _("Unable to remove item from the diacritical table"));
 		return -1;
@@ -12,6 +12,7 @@
 #include "config.h"
 
 #include <stdio.h>
+#include <stdlib.h>
 #include <string.h>
 #include <ctype.h>
 #include <unistd.h>
@@ -49,6 +50,137 @@ dumpchar(FILE *fd, unsigned int c, int comma)
 	fprintf(fd, comma ? "', " : "'");
 }
 
+/*
+ * Output buffer for the key table dumps. When it writes to a FILE it is a
+ * fixed buffer flushed in large chunks, otherwise it grows as needed.
+ */
+struct dump_buf {
+	char *data;
+	size_t len;
+	size_t size;
+	FILE *fp;
+	int error;
+};
+
+#define DUMP_BUF_SIZE 16384
+
+static void
+buf_flush(struct dump_buf *b)
+{
+	if (b->fp && b->len) {
+		if (fwrite(b->data, 1, b->len, b->fp) != b->len)
+			b->error = 1;
+		b->len = 0;
+	}
+}
+
+static int
+buf_reserve(struct dump_buf *b, size_t n)
+{
+	size_t size;
+	char *p;
+
+	if (b->len + n <= b->size)
+		return 0;
+
+	if (b->fp) {
+		buf_flush(b);
+		if (n <= b->size)
+			return 0;
+		b->error = 1;
+		return -1;
+	}
+
+	size = b->size ? b->size : 4096;
+	while (size < b->len + n)
+		size *= 2;
+
+	p = realloc(b->data, size);
+	if (!p) {
+		b->error = 1;
+		return -1;
+	}
+
+	b->data = p;
+	b->size = size;
+
+	return 0;
+}
+
+static void
+buf_write(struct dump_buf *b, const char *s, size_t n)
+{
+	if (buf_reserve(b, n) < 0)
+		return;
+	memcpy(b->data + b->len, s, n);
+	b->len += n;
+}
+
+static void
+buf_putc(struct dump_buf *b, char c)
+{
+	if (buf_reserve(b, 1) < 0)
+		return;
+	b->data[b->len++] = c;
+}
+
+static void
+buf_puts(struct dump_buf *b, const char *s)
+{
+	buf_write(b, s, strlen(s));
+}
+
+/* Same as "%-*s" */
+static void
+buf_pad(struct dump_buf *b, const char *s, size_t width)
+{
+	size_t n = strlen(s);
+
+	buf_write(b, s, n);
+
+	if (n < width && buf_reserve(b, width - n) == 0) {
+		memset(b->data + b->len, ' ', width - n);
+		b->len += width - n;
+	}
+}
+
+/* Same as "%*u" */
+static void
+buf_dec(struct dump_buf *b, unsigned int v, size_t width)
+{
+	char tmp[16];
+	size_t n = 0;
+
+	do {
+		tmp[sizeof(tmp) - ++n] = (char) ('0' + v % 10);
+		v /= 10;
+	} while (v);
+
+	while (n < width && n < sizeof(tmp))
+		tmp[sizeof(tmp) - ++n] = ' ';
+
+	buf_write(b, tmp + sizeof(tmp) - n, n);
+}
+
+/* Same as "%0*x" */
+static void
+buf_hex(struct dump_buf *b, unsigned int v, size_t digits)
+{
+	static const char hex[] = "0123456789abcdef";
+	char tmp[16];
+	size_t n = 0;
+
+	do {
+		tmp[sizeof(tmp) - ++n] = hex[v & 0xf];
+		v >>= 4;
+	} while (v);
+
+	while (n < digits && n < sizeof(tmp))
+		tmp[sizeof(tmp) - ++n] = '0';
+
+	buf_write(b, tmp + sizeof(tmp) - n, n);
+}
+
 int lk_dump_bkeymap(struct lk_ctx *ctx, FILE *fd)
 {
 	int i, j;
@@ -237,8 +369,8 @@ int lk_dump_ctable(struct lk_ctx *ctx, FILE *fd)
 	return 0;
 }
 
-/* void dump_funcs(void) */
-void lk_dump_funcs(struct lk_ctx *ctx, FILE *fd)
+static void
+dump_funcs(struct lk_ctx *ctx, struct dump_buf *b)
 {
 	int i;
 
@@ -247,23 +379,40 @@ void lk_dump_funcs(struct lk_ctx *ctx, FILE *fd)
 		if (!ptr)
 			continue;
 
-		fprintf(fd, "string %s = \"", get_sym(ctx, KT_FN, i));
+		buf_puts(b, "string ");
+		buf_puts(b, get_sym(ctx, KT_FN, i));
+		buf_puts(b, " = \"");
 
 		for (; *ptr; ptr++) {
 			if (*ptr == '"' || *ptr == '\\') {
-				fputc('\\', fd);
-				fputc(*ptr, fd);
+				buf_putc(b, '\\');
+				buf_putc(b, *ptr);
 			} else if (isgraph(*ptr) || *ptr == ' ') {
-				fputc(*ptr, fd);
+				buf_putc(b, *ptr);
 			} else {
-				fprintf(fd, "\\%03hho", *ptr);
+				unsigned char c = (unsigned char) *ptr;
+
+				buf_putc(b, '\\');
+				buf_putc(b, (char) ('0' + (c >> 6)));
+				buf_putc(b, (char) ('0' + ((c >> 3) & 7)));
+				buf_putc(b, (char) ('0' + (c & 7)));
 			}
 		}
-		fputc('"', fd);
-		fputc('\n', fd);
+		buf_putc(b, '"');
+		buf_putc(b, '\n');
 	}
 }
 
+/* void dump_funcs(void) */
+void lk_dump_funcs(struct lk_ctx *ctx, FILE *fd)
+{
+	char data[DUMP_BUF_SIZE];
+	struct dump_buf b = { data, 0, sizeof(data), fd, 0 };
+
+	dump_funcs(ctx, &b);
+	buf_flush(&b);
+}
+
 /* void dump_diacs(void) */
 void lk_dump_diacs(struct lk_ctx *ctx, FILE *fd)
 {
@@ -306,12 +455,25 @@ void lk_dump_diacs(struct lk_ctx *ctx, FILE *fd)
 	}
 }
 
-void lk_dump_keymaps(struct lk_ctx *ctx, FILE *fd)
+static void
+print_range(struct dump_buf *b, int s, int n, int m)
+{
+	buf_putc(b, s ? ',' : ' ');
+	buf_dec(b, (unsigned int) n, 0);
+
+	if (n != m) {
+		buf_putc(b, '-');
+		buf_dec(b, (unsigned int) m, 0);
+	}
+}
+
+static void
+dump_keymaps(struct lk_ctx *ctx, struct dump_buf *b)
 {
 	int i, n, m, s;
 	i = n = m = s = 0;
 
-	fprintf(fd, "keymaps");
+	buf_puts(b, "keymaps");
 
 	for (i = 0; i < ctx->keymap->total; i++) {
 		if (ctx->keywords & LK_KEYWORD_ALTISMETA && i == (i | M_ALT))
@@ -321,9 +483,7 @@ void lk_dump_keymaps(struct lk_ctx *ctx, FILE *fd)
 			if (!m)
 				continue;
 			n--, m--;
-			(n == m)
-			    ? fprintf(fd, "%c%d", (s ? ',' : ' '), n)
-			    : fprintf(fd, "%c%d-%d", (s ? ',' : ' '), n, m);
+			print_range(b, s, n, m);
 			n = m = 0;
 			s = 1;
 		} else {
@@ -335,194 +495,282 @@ void lk_dump_keymaps(struct lk_ctx *ctx, FILE *fd)
 
 	if (m) {
 		n--, m--;
-		(n == m)
-		    ? fprintf(fd, "%c%d", (s ? ',' : ' '), n)
-		    : fprintf(fd, "%c%d-%d", (s ? ',' : ' '), n, m);
+		print_range(b, s, n, m);
 	}
 
-	fprintf(fd, "\n");
+	buf_putc(b, '\n');
+}
+
+void lk_dump_keymaps(struct lk_ctx *ctx, FILE *fd)
+{
+	char data[DUMP_BUF_SIZE];
+	struct dump_buf b = { data, 0, sizeof(data), fd, 0 };
+
+	dump_keymaps(ctx, &b);
+	buf_flush(&b);
 }
 
 static void
-print_mod(FILE *fd, int x)
+print_mod(struct dump_buf *b, int x)
 {
 	if (x) {
 		modifier_t *mod = (modifier_t *)modifiers;
 		while (mod->name) {
-			if (x & (1 << mod->bit))
-				fprintf(fd, "%s\t", mod->name);
+			if (x & (1 << mod->bit)) {
+				buf_puts(b, mod->name);
+				buf_putc(b, '\t');
+			}
 			mod++;
 		}
 	} else {
-		fprintf(fd, "plain\t");
+		buf_puts(b, "plain\t");
 	}
 }
 
 static void
-print_keysym(struct lk_ctx *ctx, FILE *fd, int code, char numeric)
+print_keysym(struct lk_ctx *ctx, struct dump_buf *b, int code, char numeric)
 {
 	int t, v;
 	const char *p;
 	int plus;
 
-	fprintf(fd, " ");
+	buf_putc(b, ' ');
 	t = KTYP(code);
 	v = KVAL(code);
 	if (t >= syms_size) {
-		if (!numeric && (p = codetoksym(ctx, code)) != NULL)
-			fprintf(fd, "%-16s", p);
-		else
-			fprintf(fd, "U+%04x          ", code ^ 0xf000);
+		if (!numeric && (p = codetoksym(ctx, code)) != NULL) {
+			buf_pad(b, p, 16);
+		} else {
+			buf_puts(b, "U+");
+			buf_hex(b, (unsigned int) (code ^ 0xf000), 4);
+			buf_puts(b, "          ");
+		}
 		return;
 	}
 	plus = 0;
 	if (t == KT_LETTER) {
 		t = KT_LATIN;
-		fprintf(fd, "+");
+		buf_putc(b, '+');
 		plus++;
 	}
 	if (!numeric && t == KT_LATIN &&
-	    (p = codetoksym(ctx, code)))
-		fprintf(fd, "%-*s", 16 - plus, p);
-	else if (!numeric && t < syms_size && v < get_sym_size(ctx, t) &&
-	         (p = get_sym(ctx, t, v))[0])
-		fprintf(fd, "%-*s", 16 - plus, p);
-	else if (!numeric && t == KT_META && v < 128 && v < get_sym_size(ctx, KT_LATIN) &&
-	         (p = get_sym(ctx, KT_LATIN, v))[0])
-		fprintf(fd, "Meta_%-11s", p);
-	else
-		fprintf(fd, "0x%04x         %s", code, plus ? "" : " ");
+	    (p = codetoksym(ctx, code))) {
+		buf_pad(b, p, (size_t) (16 - plus));
+	} else if (!numeric && t < syms_size && v < get_sym_size(ctx, t) &&
+	           (p = get_sym(ctx, t, v))[0]) {
+		buf_pad(b, p, (size_t) (16 - plus));
+	} else if (!numeric && t == KT_META && v < 128 && v < get_sym_size(ctx, KT_LATIN) &&
+	           (p = get_sym(ctx, KT_LATIN, v))[0]) {
+		buf_puts(b, "Meta_");
+		buf_pad(b, p, 11);
+	} else {
+		buf_puts(b, "0x");
+		buf_hex(b, (unsigned int) code, 4);
+		buf_puts(b, plus ? "         " : "          ");
+	}
+}
+
+static void
+print_keycode(struct dump_buf *b, int i)
+{
+	buf_puts(b, "keycode ");
+	buf_dec(b, (unsigned int) i, 3);
+	buf_puts(b, " =");
 }
 
 static void
-print_bind(struct lk_ctx *ctx, FILE *fd, int bufj, int i, int j, char numeric)
+print_bind(struct lk_ctx *ctx, struct dump_buf *b, int bufj, int i, int j, char numeric)
 {
 	if (j)
-		fprintf(fd, "\t");
-	print_mod(fd, j);
-	fprintf(fd, "keycode %3d =", i);
-	print_keysym(ctx, fd, bufj, numeric);
-	fprintf(fd, "\n");
+		buf_putc(b, '\t');
+	print_mod(b, j);
+	print_keycode(b, i);
+	print_keysym(ctx, b, bufj, numeric);
+	buf_putc(b, '\n');
 }
 
-void lk_dump_keys(struct lk_ctx *ctx, FILE *fd, lk_table_shape table, char numeric)
+/*
+ * Per-keycode classification used by the short-hand heuristics.
+ */
+enum {
+	KEY_ALL_HOLES = (1 << 0), /* no table binds this keycode */
+	KEY_AS_EXPECTED = (1 << 1) /* an ordinary letter, printed as a single entry */
+};
+
+struct lk_dump_plan {
+	struct lk_ctx *ctx;
+	int keymapnr;
+	int alt_is_meta;
+	unsigned char exists[MAX_NR_KEYMAPS];
+	unsigned char kind[NR_KEYS];
+	int *keys; /* NR_KEYS rows of keymapnr action codes */
+};
+
+static int
+letter_is_as_expected(const struct lk_dump_plan *plan, const int *row)
 {
-	int i, j;
-	int buf[MAX_NR_KEYMAPS];
-	int isletter, islatin, isasexpected;
-	int typ, val;
-	int alt_is_meta = 0;
-	int all_holes;
-	int zapped[MAX_NR_KEYMAPS];
-	ssize_t keymapnr = ctx->keymap->total;
+	int j, val, defs[16];
 
-	if (!keymapnr)
-		return;
+	val = KVAL(row[0]);
 
-	if (table == LK_SHAPE_FULL_TABLE || table == LK_SHAPE_SEPARATE_LINES)
-		goto no_shorthands;
+	defs[0] = K(KT_LETTER, val);
+	defs[1] = K(KT_LETTER, val ^ 32);
+	defs[2] = defs[0];
+	defs[3] = defs[1];
 
-	/* first pass: determine whether to set alt_is_meta */
-	for (j = 0; j < ctx->keymap->total; j++) {
-		int ja = (j | M_ALT);
+	for (j = 4; j < 8; j++)
+		defs[j] = K(KT_LATIN, val & ~96);
 
-		if (!(j != ja && lk_map_exists(ctx, j) && lk_map_exists(ctx, ja)))
-			continue;
+	for (j = 8; j < 16; j++)
+		defs[j] = K(KT_META, KVAL(defs[j - 8]));
 
-		for (i = 0; i < NR_KEYS; i++) {
-			int buf0, buf1, type;
+	for (j = 0; j < plan->keymapnr; j++) {
+		if (plan->exists[j]) {
+			if ((j >= 16 && row[j] != K_HOLE) || (j < 16 && row[j] != defs[j]))
+				return 0;
+		}
+	}
 
-			buf0 = lk_get_key(ctx, j, i);
+	return 1;
+}
 
-			if (buf0 == -1)
-				break;
+struct lk_dump_plan *
+lk_dump_plan_new(struct lk_ctx *ctx)
+{
+	struct lk_dump_plan *plan;
+	int i, j, n;
 
-			type = KTYP(buf0);
+	plan = calloc(1, sizeof(*plan));
+	if (!plan) {
+		ERR(ctx, _("out of memory"));
+		return NULL;
+	}
 
-			if ((type == KT_LATIN || type == KT_LETTER) && KVAL(buf0) < 128) {
-				buf1 = lk_map_exists(ctx, ja)
-				           ? lk_get_key(ctx, ja, i)
-				           : -1;
+	n = (int) ctx->keymap->total;
+	if (n > MAX_NR_KEYMAPS)
+		n = MAX_NR_KEYMAPS;
 
-				if (buf1 != K(KT_META, KVAL(buf0)))
-					goto not_alt_is_meta;
-			}
+	plan->ctx      = ctx;
+	plan->keymapnr = n;
+
+	plan->keys = malloc((size_t) NR_KEYS * (size_t) (n ? n : 1) * sizeof(int));
+	if (!plan->keys) {
+		ERR(ctx, _("out of memory"));
+		free(plan);
+		return NULL;
+	}
+
+	/* one sweep over each table, straight from the key arrays */
+	for (j = 0; j < n; j++) {
+		struct lk_array *map = lk_array_get_ptr(ctx->keymap, j);
+		const unsigned int *codes = map ? (const unsigned int *) map->array : NULL;
+		ssize_t total = map ? map->total : 0;
+
+		plan->exists[j] = (map != NULL);
+
+		for (i = 0; i < NR_KEYS; i++) {
+			plan->keys[i * n + j] = (i < total && codes[i])
+			                            ? (int) codes[i] - 1
+			                            : K_HOLE;
 		}
 	}
-	alt_is_meta = 1;
-	fprintf(fd, "alt_is_meta\n");
 
-not_alt_is_meta:
-no_shorthands:
+	plan->alt_is_meta = (n > 0);
 
 	for (i = 0; i < NR_KEYS; i++) {
-		all_holes = 1;
+		const int *row = plan->keys + i * n;
+		int typ, all_holes = 1;
 
-		for (j = 0; j < keymapnr; j++) {
-			buf[j] = K_HOLE;
+		for (j = 0; j < n; j++) {
+			int ja = (j | M_ALT);
 
-			if (lk_map_exists(ctx, j))
-				buf[j] = lk_get_key(ctx, j, i);
-
-			if (buf[j] != K_HOLE)
+			if (row[j] != K_HOLE)
 				all_holes = 0;
-		}
 
-		if (all_holes && table != LK_SHAPE_FULL_TABLE)
-			continue;
+			if (!plan->alt_is_meta || j == ja || !plan->exists[j] ||
+			    ja >= n || !plan->exists[ja])
+				continue;
 
-		if (table == LK_SHAPE_FULL_TABLE) {
-			fprintf(fd, "keycode %3d =", i);
+			typ = KTYP(row[j]);
 
-			for (j = 0; j < keymapnr; j++) {
-				if (lk_map_exists(ctx, j))
-					print_keysym(ctx, fd, buf[j], numeric);
-			}
+			if ((typ == KT_LATIN || typ == KT_LETTER) && KVAL(row[j]) < 128 &&
+			    row[ja] != K(KT_META, KVAL(row[j])))
+				plan->alt_is_meta = 0;
+		}
 
-			fprintf(fd, "\n");
+		if (all_holes) {
+			plan->kind[i] = KEY_ALL_HOLES;
 			continue;
 		}
 
-		if (table == LK_SHAPE_SEPARATE_LINES) {
-			for (j = 0; j < keymapnr; j++) {
-				//if (buf[j] != K_HOLE)
-				print_bind(ctx, fd, buf[j], i, j, numeric);
-			}
+		typ = KTYP(row[0]);
 
-			fprintf(fd, "\n");
-			continue;
+		if (typ == KT_LATIN || typ == KT_LETTER) {
+			int val = KVAL(row[0]);
+
+			if (((val >= 'A' && val <= 'Z') || (val >= 'a' && val <= 'z')) &&
+			    letter_is_as_expected(plan, row))
+				plan->kind[i] = KEY_AS_EXPECTED;
 		}
+	}
+
+	return plan;
+}
+
+void lk_dump_plan_free(struct lk_dump_plan *plan)
+{
+	if (!plan)
+		return;
+	free(plan->keys);
+	free(plan);
+}
+
+static void
+dump_keys(const struct lk_dump_plan *plan, struct dump_buf *b, lk_table_shape table, char numeric)
+{
+	struct lk_ctx *ctx = plan->ctx;
+	int i, j;
+	int buf[MAX_NR_KEYMAPS];
+	int alt_is_meta = 0;
+	int zapped[MAX_NR_KEYMAPS];
+	int keymapnr = plan->keymapnr;
 
-		typ      = KTYP(buf[0]);
-		val      = KVAL(buf[0]);
-		islatin  = (typ == KT_LATIN || typ == KT_LETTER);
-		isletter = (islatin && ((val >= 'A' && val <= 'Z') || (val >= 'a' && val <= 'z')));
+	if (!keymapnr)
+		return;
 
-		isasexpected = 0;
-		if (isletter) {
-			int defs[16];
+	if (table != LK_SHAPE_FULL_TABLE && table != LK_SHAPE_SEPARATE_LINES &&
+	    plan->alt_is_meta) {
+		alt_is_meta = 1;
+		buf_puts(b, "alt_is_meta\n");
+	}
 
-			defs[0] = K(KT_LETTER, val);
-			defs[1] = K(KT_LETTER, val ^ 32);
-			defs[2] = defs[0];
-			defs[3] = defs[1];
+	for (i = 0; i < NR_KEYS; i++) {
+		if ((plan->kind[i] & KEY_ALL_HOLES) && table != LK_SHAPE_FULL_TABLE)
+			continue;
 
-			for (j = 4; j < 8; j++)
-				defs[j] = K(KT_LATIN, val & ~96);
+		memcpy(buf, plan->keys + i * keymapnr, (size_t) keymapnr * sizeof(int));
 
-			for (j = 8; j < 16; j++)
-				defs[j] = K(KT_META, KVAL(defs[j - 8]));
+		if (table == LK_SHAPE_FULL_TABLE) {
+			print_keycode(b, i);
 
 			for (j = 0; j < keymapnr; j++) {
-				if (lk_map_exists(ctx, j)) {
-					if ((j >= 16 && buf[j] != K_HOLE) || (j < 16 && buf[j] != defs[j]))
-						goto unexpected;
-				}
+				if (plan->exists[j])
+					print_keysym(ctx, b, buf[j], numeric);
+			}
+
+			buf_putc(b, '\n');
+			continue;
+		}
+
+		if (table == LK_SHAPE_SEPARATE_LINES) {
+			for (j = 0; j < keymapnr; j++) {
+				//if (buf[j] != K_HOLE)
+				print_bind(ctx, b, buf[j], i, j, numeric);
 			}
 
-			isasexpected = 1;
+			buf_putc(b, '\n');
+			continue;
 		}
-	unexpected:
 
 		/* wipe out predictable meta bindings */
 		for (j            = 0; j < keymapnr; j++)
@@ -533,7 +781,7 @@ no_shorthands:
 				int ja, ktyp;
 				ja = (j | M_ALT);
 
-				if (j != ja && lk_map_exists(ctx, ja) && ((ktyp = KTYP(buf[j])) == KT_LATIN || ktyp == KT_LETTER) && KVAL(buf[j]) < 128) {
+				if (j != ja && ja < keymapnr && plan->exists[ja] && ((ktyp = KTYP(buf[j])) == KT_LATIN || ktyp == KT_LETTER) && KVAL(buf[j]) < 128) {
 					if (buf[ja] != K(KT_META, KVAL(buf[j])))
 						fprintf(stderr, _("impossible: not meta?\n"));
 					buf[ja]    = K_HOLE;
@@ -542,13 +790,13 @@ no_shorthands:
 			}
 		}
 
-		fprintf(fd, "keycode %3d =", i);
+		print_keycode(b, i);
 
-		if (isasexpected) {
+		if (plan->kind[i] & KEY_AS_EXPECTED) {
 			/* print only a single entry */
 			/* suppress the + for ordinary a-zA-Z */
-			print_keysym(ctx, fd, K(KT_LATIN, val), numeric);
-			fprintf(fd, "\n");
+			print_keysym(ctx, b, K(KT_LATIN, KVAL(buf[0])), numeric);
+			buf_putc(b, '\n');
 		} else {
 			/* choose between single entry line followed by exceptions,
 			   and long line followed by exceptions; avoid VoidSymbol */
@@ -568,30 +816,30 @@ no_shorthands:
 
 			if (bad <= count && bad < keymapnr - 1) {
 				if (buf[0] != K_HOLE) {
-					print_keysym(ctx, fd, buf[0], numeric);
+					print_keysym(ctx, b, buf[0], numeric);
 				}
-				fprintf(fd, "\n");
+				buf_putc(b, '\n');
 
 				for (j = 1; j < keymapnr; j++) {
-					if (lk_map_exists(ctx, j)) {
+					if (plan->exists[j]) {
 						if (buf[j] != buf[0] && !zapped[j]) {
-							print_bind(ctx, fd, buf[j], i, j, numeric);
+							print_bind(ctx, b, buf[j], i, j, numeric);
 						}
 					}
 				}
 			} else {
 				for (j = 0;
 				     j < keymapnr && buf[j] != K_HOLE &&
-				     (table != LK_SHAPE_UNTIL_HOLE || lk_map_exists(ctx, j));
+				     (table != LK_SHAPE_UNTIL_HOLE || plan->exists[j]);
 				     j++) {
-					//print_bind(ctx, fd, buf[j], i, j, numeric);
-					print_keysym(ctx, fd, buf[j], numeric);
+					//print_bind(ctx, b, buf[j], i, j, numeric);
+					print_keysym(ctx, b, buf[j], numeric);
 				}
-				fprintf(fd, "\n");
+				buf_putc(b, '\n');
 
 				for (; j < keymapnr; j++) {
 					if (buf[j] != K_HOLE) {
-						print_bind(ctx, fd, buf[j], i, j, numeric);
+						print_bind(ctx, b, buf[j], i, j, numeric);
 					}
 				}
 			}
@@ -599,9 +847,65 @@ no_shorthands:
 	}
 }
 
+void lk_dump_plan_keys(const struct lk_dump_plan *plan, FILE *fd,
+                       lk_table_shape table, char numeric)
+{
+	char data[DUMP_BUF_SIZE];
+	struct dump_buf b = { data, 0, sizeof(data), fd, 0 };
+
+	dump_keys(plan, &b, table, numeric);
+	buf_flush(&b);
+}
+
+void lk_dump_keys(struct lk_ctx *ctx, FILE *fd, lk_table_shape table, char numeric)
+{
+	struct lk_dump_plan *plan = lk_dump_plan_new(ctx);
+
+	if (!plan)
+		return;
+
+	lk_dump_plan_keys(plan, fd, table, numeric);
+	lk_dump_plan_free(plan);
+}
+
+ssize_t lk_dump_keys_to_buffer(struct lk_ctx *ctx, char **buf, size_t *size,
+                               lk_table_shape table, char numeric)
+{
+	struct dump_buf b = { *buf, 0, *buf ? *size : 0, NULL, 0 };
+	struct lk_dump_plan *plan;
+
+	if (!(plan = lk_dump_plan_new(ctx)))
+		return -1;
+
+	dump_keys(plan, &b, table, numeric);
+	buf_putc(&b, '\0');
+
+	lk_dump_plan_free(plan);
+
+	*buf  = b.data;
+	*size = b.size;
+
+	if (b.error) {
+		ERR(ctx, _("out of memory"));
+		return -1;
+	}
+
+	return (ssize_t) b.len - 1;
+}
+
 void lk_dump_keymap(struct lk_ctx *ctx, FILE *fd, lk_table_shape table, char numeric)
 {
-	lk_dump_keymaps(ctx, fd);
-	lk_dump_keys(ctx, fd, table, numeric);
-	lk_dump_funcs(ctx, fd);
+	char data[DUMP_BUF_SIZE];
+	struct dump_buf b = { data, 0, sizeof(data), fd, 0 };
+	struct lk_dump_plan *plan;
+
+	dump_keymaps(ctx, &b);
+
+	if ((plan = lk_dump_plan_new(ctx)) != NULL) {
+		dump_keys(plan, &b, table, numeric);
+		lk_dump_plan_free(plan);
+	}
+
+	dump_funcs(ctx, &b);
+	buf_flush(&b);
 }
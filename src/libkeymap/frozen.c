@@ -0,0 +1,126 @@
+/* frozen.c
+ *
+ * This file is part of kbd project.
+ *
+ * This file is covered by the GNU General Public License,
+ * which should be included with kbd as the file COPYING.
+ */
+#include "config.h"
+
+#include <stdlib.h>
+#include <string.h>
+
+#include "keymap.h"
+
+#include "libcommon.h"
+#include "contextP.h"
+#include "ksyms.h"
+
+struct lk_frozen_keymap {
+	unsigned int refcount;
+
+	unsigned short charset;
+
+	/* position of each table in keys[], or -1 if the table does not exist */
+	short table_index[MAX_NR_KEYMAPS];
+
+	/* nr_tables rows of NR_KEYS action codes */
+	int *keys;
+	int nr_tables;
+
+	struct lk_uni_sym *uni_syms;
+	size_t uni_syms_size;
+};
+
+struct lk_frozen_keymap *
+lk_keymap_freeze(struct lk_ctx *ctx)
+{
+	struct lk_frozen_keymap *km;
+	int i, t, n = 0;
+
+	if (lk_add_constants(ctx) < 0)
+		return NULL;
+
+	km = calloc(1, sizeof(*km));
+	if (!km)
+		goto nomem;
+
+	km->refcount = 1;
+	km->charset  = ctx->charset;
+
+	for (t = 0; t < MAX_NR_KEYMAPS; t++)
+		km->table_index[t] = (short) (lk_map_exists(ctx, t) ? n++ : -1);
+
+	km->nr_tables = n;
+	km->keys      = malloc((size_t) (n ? n : 1) * NR_KEYS * sizeof(int));
+	if (!km->keys)
+		goto nomem;
+
+	for (t = 0; t < MAX_NR_KEYMAPS; t++) {
+		struct lk_array *map;
+		const unsigned int *codes;
+		int *row;
+
+		if (km->table_index[t] < 0)
+			continue;
+
+		map   = lk_array_get_ptr(ctx->keymap, t);
+		codes = (const unsigned int *) map->array;
+		row   = km->keys + km->table_index[t] * NR_KEYS;
+
+		for (i = 0; i < NR_KEYS; i++)
+			row[i] = (i < map->total && codes[i]) ? (int) codes[i] - 1 : K_HOLE;
+	}
+
+	if (build_uni_syms(&km->uni_syms, &km->uni_syms_size) < 0)
+		goto nomem;
+
+	return km;
+
+nomem:
+	ERR(ctx, _("out of memory"));
+	lk_frozen_unref(km);
+	return NULL;
+}
+
+struct lk_frozen_keymap *
+lk_frozen_ref(struct lk_frozen_keymap *km)
+{
+	__atomic_add_fetch(&km->refcount, 1, __ATOMIC_RELAXED);
+	return km;
+}
+
+void lk_frozen_unref(struct lk_frozen_keymap *km)
+{
+	if (!km)
+		return;
+
+	if (__atomic_sub_fetch(&km->refcount, 1, __ATOMIC_ACQ_REL) > 0)
+		return;
+
+	free(km->uni_syms);
+	free(km->keys);
+	free(km);
+}
+
+int lk_frozen_map_exists(const struct lk_frozen_keymap *km, int k_table)
+{
+	return (k_table >= 0 && k_table < MAX_NR_KEYMAPS && km->table_index[k_table] >= 0);
+}
+
+int lk_frozen_get_key(const struct lk_frozen_keymap *km, int k_table, int k_index)
+{
+	if (!lk_frozen_map_exists(km, k_table))
+		return -1;
+
+	if (k_index < 0 || k_index >= NR_KEYS)
+		return K_HOLE;
+
+	return km->keys[km->table_index[k_table] * NR_KEYS + k_index];
+}
+
+const char *
+lk_frozen_code_to_ksym(const struct lk_frozen_keymap *km, int code)
+{
+	return lookup_ksym(NULL, km->charset, km->uni_syms, km->uni_syms_size, code);
+}
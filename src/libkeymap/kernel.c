@@ -10,42 +10,123 @@
 
 #include <string.h>
 #include <errno.h>
-#include <sys/ioctl.h>
 
 #include "keymap.h"
 
 #include "libcommon.h"
 #include "contextP.h"
 
-int lk_kernel_keys(struct lk_ctx *ctx, int fd)
+void lk_kernel_keys_filter_init(struct lk_kernel_keys_filter *filter)
+{
+	memset(filter->tables, 0xff, sizeof(filter->tables));
+	filter->first = 0;
+	filter->last  = NR_KEYS - 1;
+}
+
+int
+kernel_get_key(struct lk_ctx *ctx, int fd, int t, int i, unsigned short *value)
 {
-	unsigned short i, t;
 	struct kbentry ke;
 
+	if (t > UCHAR_MAX) {
+		ERR(ctx, _("table %d must be less than %d"), t, UCHAR_MAX);
+		return -1;
+	}
+
+	if (i > UCHAR_MAX) {
+		ERR(ctx, _("index %d must be less than %d"), i, UCHAR_MAX);
+		return -1;
+	}
+
+	ke.kb_table = (unsigned char) t;
+	ke.kb_index = (unsigned char) i;
+	ke.kb_value = 0;
+
+	if (console_ioctl(ctx, fd, KDGKBENT, (unsigned long)&ke)) {
+		ERR(ctx, _("KDGKBENT: %s: error at index %d in table %d"),
+		    strerror(errno), i, t);
+		return -1;
+	}
+
+	*value = ke.kb_value;
+	return 0;
+}
+
+/*
+ * Give a newly created table room for all keys that are going to be read,
+ * so that filling it does not reallocate on every key.
+ */
+static int
+presize_map(struct lk_ctx *ctx, int t, ssize_t size)
+{
+	struct lk_array *map;
+
+	if (lk_map_exists(ctx, t) || (ctx->keywords & LK_KEYWORD_KEYMAPS))
+		return 0;
+
+	if (lk_add_map(ctx, t) < 0)
+		return -1;
+
+	map = lk_array_get_ptr(ctx->keymap, t);
+
+	lk_array_free(map);
+
+	if (lk_array_init(map, sizeof(unsigned int), size) < 0) {
+		ERR(ctx, _("out of memory"));
+		return -1;
+	}
+
+	return 0;
+}
+
+int lk_kernel_keys_filtered(struct lk_ctx *ctx, int fd,
+                            const struct lk_kernel_keys_filter *filter)
+{
+	struct lk_kernel_keys_filter all;
+	unsigned short value;
+	int i, t;
+
+	if (!filter) {
+		lk_kernel_keys_filter_init(&all);
+		filter = &all;
+	}
+
+	if (filter->first > filter->last || filter->last >= NR_KEYS) {
+		ERR(ctx, _("invalid keycode range %d-%d"),
+		    filter->first, filter->last);
+		return -1;
+	}
+
 	for (t = 0; t < MAX_NR_KEYMAPS; t++) {
-		if (t > UCHAR_MAX) {
-			ERR(ctx, _("table %d must be less than %d"), t, UCHAR_MAX);
+		if (!LK_FILTER_HAS_TABLE(filter, t))
+			continue;
+
+		/*
+		 * Only index 0 tells an unallocated table (K_NOSUCHMAP)
+		 * apart from a hole, so it is always probed.
+		 */
+		if (kernel_get_key(ctx, fd, t, 0, &value) < 0)
 			return -1;
-		}
-		for (i = 0; i < NR_KEYS; i++) {
-			if (i > UCHAR_MAX) {
-				ERR(ctx, _("index %d must be less than %d"), t, UCHAR_MAX);
-				return -1;
-			}
-			ke.kb_table = (unsigned char) t;
-			ke.kb_index = (unsigned char) i;
-			ke.kb_value = 0;
-
-			if (ioctl(fd, KDGKBENT, (unsigned long)&ke)) {
-				ERR(ctx, _("KDGKBENT: %s: error at index %d in table %d"),
-				    strerror(errno), i, t);
+
+		if (value == K_NOSUCHMAP)
+			continue;
+
+		if (presize_map(ctx, t, filter->last + 1) < 0)
+			return -1;
+
+		i = filter->first;
+
+		if (i == 0) {
+			if (lk_add_key(ctx, t, 0, value) < 0)
 				return -1;
-			}
+			i++;
+		}
 
-			if (!i && ke.kb_value == K_NOSUCHMAP)
-				break;
+		for (; i <= filter->last; i++) {
+			if (kernel_get_key(ctx, fd, t, i, &value) < 0)
+				return -1;
 
-			if (lk_add_key(ctx, t, i, ke.kb_value) < 0)
+			if (lk_add_key(ctx, t, i, value) < 0)
 				return -1;
 		}
 	}
@@ -56,6 +137,11 @@ int lk_kernel_keys(struct lk_ctx *ctx, int fd)
 	return 0;
 }
 
+int lk_kernel_keys(struct lk_ctx *ctx, int fd)
+{
+	return lk_kernel_keys_filtered(ctx, fd, NULL);
+}
+
 int lk_kernel_funcs(struct lk_ctx *ctx, int fd)
 {
 	unsigned short i;
@@ -68,7 +154,7 @@ int lk_kernel_funcs(struct lk_ctx *ctx, int fd)
 		}
 		kbs.kb_func = (unsigned char) i;
 
-		if (ioctl(fd, KDGKBSENT, (unsigned long)&kbs)) {
+		if (console_ioctl(ctx, fd, KDGKBSENT, (unsigned long)&kbs)) {
 			ERR(ctx, _("KDGKBSENT: %s: Unable to get function key string"),
 			    strerror(errno));
 			return -1;
@@ -98,7 +184,7 @@ int lk_kernel_diacrs(struct lk_ctx *ctx, int fd)
 	int i;
 	struct lk_kbdiacr dcr;
 
-	if (ioctl(fd, request, (unsigned long)&kd)) {
+	if (console_ioctl(ctx, fd, request, (unsigned long)&kd)) {
 		ERR(ctx, _("KDGKBDIACR(UC): %s: Unable to get accent table"),
 		    strerror(errno));
 		return -1;
@@ -176,8 +176,131 @@ lk_get_sym(struct lk_ctx *ctx, int ktype, int index)
 	return (ksym ? strdup(ksym) : NULL);
 }
 
+static int
+uni_sym_compar(const void *a, const void *b)
+{
+	const struct lk_uni_sym *x = a;
+	const struct lk_uni_sym *y = b;
+
+	if (x->uni != y->uni)
+		return (x->uni < y->uni) ? -1 : 1;
+
+	/* keep the charset order, the first charset wins */
+	return (x->order < y->order) ? -1 : (x->order > y->order);
+}
+
+/*
+ * Build a sorted Unicode to name index of all charsets, so that looking up
+ * a Unicode keysym does not have to scan every charset table.
+ */
+int
+build_uni_syms(struct lk_uni_sym **res, size_t *size)
+{
+	struct lk_uni_sym *idx;
+	size_t n = 0;
+	unsigned int i;
+	int j;
+	const sym *p;
+
+	for (i = 0; i < charsets_size; i++) {
+		p = charsets[i].charnames;
+		if (!p)
+			continue;
+		for (j = charsets[i].start; j < 256; j++, p++) {
+			if (p->uni >= 0x80 && p->name[0])
+				n++;
+		}
+	}
+
+	idx = malloc((n ? n : 1) * sizeof(struct lk_uni_sym));
+	if (!idx)
+		return -1;
+
+	n = 0;
+	for (i = 0; i < charsets_size; i++) {
+		p = charsets[i].charnames;
+		if (!p)
+			continue;
+		for (j = charsets[i].start; j < 256; j++, p++) {
+			if (p->uni >= 0x80 && p->name[0]) {
+				idx[n].uni   = p->uni;
+				idx[n].order = (unsigned int) n;
+				idx[n].name  = p->name;
+				n++;
+			}
+		}
+	}
+
+	qsort(idx, n, sizeof(struct lk_uni_sym), uni_sym_compar);
+
+	*res  = idx;
+	*size = n;
+
+	return 0;
+}
+
+/*
+ * Fills table with the Unicode value of every 8-bit character of the
+ * charset. Characters without a known value map to themselves.
+ */
+void
+charset_to_unicode(unsigned short charset, unsigned int table[256])
+{
+	const sym *p = charsets[charset].charnames;
+	int i;
+
+	for (i = 0; i < 256; i++)
+		table[i] = (unsigned int) i;
+
+	if (!p)
+		return;
+
+	for (i = charsets[charset].start; i < 256; i++, p++) {
+		if (p->uni)
+			table[i] = p->uni;
+	}
+}
+
+static const char *
+find_uni_sym(const struct lk_uni_sym *idx, size_t n, int code)
+{
+	size_t lo = 0, hi = n;
+
+	while (lo < hi) {
+		size_t mid = lo + (hi - lo) / 2;
+
+		if (idx[mid].uni < code)
+			lo = mid + 1;
+		else
+			hi = mid;
+	}
+
+	if (lo < n && idx[lo].uni == code)
+		return idx[lo].name;
+
+	return NULL;
+}
+
+/* Same as get_sym(), but does not need a context when ctx is NULL. */
+static const char *
+sym_by_type(struct lk_ctx *ctx, int ktype, int index)
+{
+	if (ctx)
+		return get_sym(ctx, ktype, index);
+
+	if (ktype >= syms_size || index >= syms[ktype].size)
+		return NULL;
+
+	return syms[ktype].table[index];
+}
+
+/*
+ * Lookup the name of a keysym. The context is only used for error
+ * reporting and may be NULL. Without an index the charsets are scanned.
+ */
 const char *
-codetoksym(struct lk_ctx *ctx, int code)
+lookup_ksym(struct lk_ctx *ctx, unsigned short charset,
+            const struct lk_uni_sym *idx, size_t idx_size, int code)
 {
 	unsigned int i;
 	int j;
@@ -188,7 +311,7 @@ codetoksym(struct lk_ctx *ctx, int code)
 
 	if (code < 0x1000) { /* "traditional" keysym */
 		if (code < 0x80)
-			return get_sym(ctx, KT_LATIN, code);
+			return sym_by_type(ctx, KT_LATIN, code);
 
 		if (KTYP(code) == KT_META)
 			return NULL;
@@ -197,9 +320,9 @@ codetoksym(struct lk_ctx *ctx, int code)
 			code = K(KT_LATIN, KVAL(code));
 
 		if (KTYP(code) > KT_LATIN)
-			return get_sym(ctx, KTYP(code), KVAL(code));
+			return sym_by_type(ctx, KTYP(code), KVAL(code));
 
-		i = ctx->charset;
+		i = charset;
 		p = (sym *)charsets[i].charnames;
 		if (p && (KVAL(code) >= charsets[i].start)) {
 			p += KVAL(code) - charsets[i].start;
@@ -212,7 +335,10 @@ codetoksym(struct lk_ctx *ctx, int code)
 		code ^= 0xf000;
 
 		if (code < 0x80)
-			return get_sym(ctx, KT_LATIN, code);
+			return sym_by_type(ctx, KT_LATIN, code);
+
+		if (idx)
+			return find_uni_sym(idx, idx_size, code);
 
 		for (i = 0; i < charsets_size; i++) {
 			p = (sym *)charsets[i].charnames;
@@ -228,6 +354,15 @@ codetoksym(struct lk_ctx *ctx, int code)
 	return NULL;
 }
 
+const char *
+codetoksym(struct lk_ctx *ctx, int code)
+{
+	if (!ctx->uni_syms)
+		build_uni_syms(&ctx->uni_syms, &ctx->uni_syms_size);
+
+	return lookup_ksym(ctx, ctx->charset, ctx->uni_syms, ctx->uni_syms_size, code);
+}
+
 char *
 lk_code_to_ksym(struct lk_ctx *ctx, int code)
 {
@@ -3,6 +3,8 @@
 
 #include "keymap.h"
 
+struct lk_uni_sym;
+
 typedef struct {
 	const unsigned short uni;
 	const char *name;
@@ -26,6 +28,10 @@ const char *get_sym(struct lk_ctx *ctx, int ktype, int index);
 int get_sym_size(struct lk_ctx *ctx, int ktype);
 
 const char *codetoksym(struct lk_ctx *ctx, int code);
+const char *lookup_ksym(struct lk_ctx *ctx, unsigned short charset,
+                        const struct lk_uni_sym *idx, size_t idx_size, int code);
+int build_uni_syms(struct lk_uni_sym **res, size_t *size);
+void charset_to_unicode(unsigned short charset, unsigned int table[256]);
 int ksymtocode(struct lk_ctx *ctx, const char *s, int direction);
 int convert_code(struct lk_ctx *ctx, int code, int direction);
 int add_capslock(struct lk_ctx *ctx, int code);
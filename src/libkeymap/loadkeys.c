@@ -3,7 +3,6 @@
 #include <errno.h>
 #include <stdlib.h>
 #include <string.h>
-#include <sys/ioctl.h>
 #include <linux/kd.h>
 #include <linux/keyboard.h>
 #include <unistd.h>
@@ -23,7 +22,7 @@ defkeys(struct lk_ctx *ctx, int fd, int kbd_mode)
 
 	if (ctx->flags & LK_FLAG_UNICODE_MODE) {
 		/* temporarily switch to K_UNICODE while defining keys */
-		if (ioctl(fd, KDSKBMODE, K_UNICODE)) {
+		if (console_ioctl(ctx, fd, KDSKBMODE, K_UNICODE)) {
 			ERR(ctx, _("KDSKBMODE: %s: could not switch to Unicode mode"),
 			    strerror(errno));
 			goto fail;
@@ -49,7 +48,7 @@ defkeys(struct lk_ctx *ctx, int fd, int kbd_mode)
 				ke.kb_table = (unsigned char) i;
 				ke.kb_value = (unsigned short) value;
 
-				fail = ioctl(fd, KDSKBENT, (unsigned long)&ke);
+				fail = console_ioctl(ctx, fd, KDSKBENT, (unsigned long)&ke);
 
 				if (fail) {
 					if (errno == EPERM) {
@@ -86,7 +85,7 @@ defkeys(struct lk_ctx *ctx, int fd, int kbd_mode)
 
 			DBG(ctx, _("deallocate keymap %d"), i);
 
-			if (ioctl(fd, KDSKBENT, (unsigned long)&ke)) {
+			if (console_ioctl(ctx, fd, KDSKBENT, (unsigned long)&ke)) {
 				if (errno != EINVAL) {
 					ERR(ctx, _("KDSKBENT: %s: could not deallocate keymap %d"),
 					    strerror(errno), i);
@@ -99,7 +98,7 @@ defkeys(struct lk_ctx *ctx, int fd, int kbd_mode)
 					ke.kb_table = (unsigned char) i;
 					ke.kb_value = K_HOLE;
 
-					if (ioctl(fd, KDSKBENT, (unsigned long)&ke)) {
+					if (console_ioctl(ctx, fd, KDSKBENT, (unsigned long)&ke)) {
 						if (errno == EINVAL && i >= 16)
 							break; /* old kernel */
 
@@ -112,7 +111,7 @@ defkeys(struct lk_ctx *ctx, int fd, int kbd_mode)
 		}
 	}
 
-	if ((ctx->flags & LK_FLAG_UNICODE_MODE) && ioctl(fd, KDSKBMODE, kbd_mode)) {
+	if ((ctx->flags & LK_FLAG_UNICODE_MODE) && console_ioctl(ctx, fd, KDSKBMODE, (unsigned long)kbd_mode)) {
 		ERR(ctx, _("KDSKBMODE: %s: could not return to original keyboard mode"),
 		    strerror(errno));
 		goto fail;
@@ -172,7 +171,7 @@ deffuncs(struct lk_ctx *ctx, int fd)
 
 		if (ptr) {
 			strcpy((char *)kbs.kb_string, ptr);
-			if (ioctl(fd, KDSKBSENT, (unsigned long)&kbs)) {
+			if (console_ioctl(ctx, fd, KDSKBSENT, (unsigned long)&kbs)) {
 				s = ostr(ctx, (char *)kbs.kb_string);
 				if (s == NULL)
 					return -1;
@@ -185,7 +184,7 @@ deffuncs(struct lk_ctx *ctx, int fd)
 		} else if (ctx->flags & LK_FLAG_CLEAR_STRINGS) {
 			kbs.kb_string[0] = 0;
 
-			if (ioctl(fd, KDSKBSENT, (unsigned long)&kbs)) {
+			if (console_ioctl(ctx, fd, KDSKBSENT, (unsigned long)&kbs)) {
 				ERR(ctx, _("failed to clear string %s"),
 				    get_sym(ctx, KT_FN, kbs.kb_func));
 			} else {
@@ -225,7 +224,7 @@ defdiacs(struct lk_ctx *ctx, int fd)
 			j++;
 		}
 
-		if (ioctl(fd, KDSKBDIACRUC, (unsigned long)&kdu)) {
+		if (console_ioctl(ctx, fd, KDSKBDIACRUC, (unsigned long)&kdu)) {
 			ERR(ctx, "KDSKBDIACRUC: %s", strerror(errno));
 			return -1;
 		}
@@ -254,7 +253,7 @@ defdiacs(struct lk_ctx *ctx, int fd)
 			j++;
 		}
 
-		if (ioctl(fd, KDSKBDIACR, (unsigned long)&kd)) {
+		if (console_ioctl(ctx, fd, KDSKBDIACR, (unsigned long)&kd)) {
 			ERR(ctx, "KDSKBDIACR: %s", strerror(errno));
 			return -1;
 		}
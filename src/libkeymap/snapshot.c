@@ -0,0 +1,582 @@
+/* snapshot.c
+ *
+ * This file is part of kbd project.
+ *
+ * This file is covered by the GNU General Public License,
+ * which should be included with kbd as the file COPYING.
+ */
+#include "config.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include <errno.h>
+
+#include "keymap.h"
+
+#include "libcommon.h"
+#include "contextP.h"
+
+/*
+ * Snapshot layout (native byte order, it is not meant to be portable):
+ *
+ *   struct snapshot_header
+ *   nr_tables x { uint16_t table; uint16_t keys[NR_KEYS]; }
+ *   nr_funcs  x { uint16_t func; uint16_t len; char string[len]; }
+ *   nr_diacrs x { uint32_t diacr, base, result; }
+ */
+#define SNAPSHOT_MAGIC   "kbdsnap"
+#define SNAPSHOT_VERSION 1
+
+struct snapshot_header {
+	char magic[7];
+	uint8_t version;
+	uint32_t kbd_mode;
+	uint32_t meta_mode;
+	uint32_t nr_tables;
+	uint32_t nr_funcs;
+	uint32_t nr_diacrs;
+};
+
+struct snapshot_table {
+	uint16_t table;
+	uint16_t keys[NR_KEYS];
+};
+
+struct snapshot_func {
+	uint16_t func;
+	uint16_t len;
+};
+
+struct snapshot_diacr {
+	uint32_t diacr;
+	uint32_t base;
+	uint32_t result;
+};
+
+struct snapshot {
+	struct snapshot_header hdr;
+	struct snapshot_table *tables;
+	char *funcs[MAX_NR_FUNC];
+	struct snapshot_diacr *diacrs;
+};
+
+static void
+free_snapshot(struct snapshot *snap)
+{
+	unsigned int i;
+
+	for (i = 0; i < MAX_NR_FUNC; i++)
+		free(snap->funcs[i]);
+	free(snap->tables);
+	free(snap->diacrs);
+}
+
+static int
+set_key(struct lk_ctx *ctx, int fd, int t, int i, uint16_t value)
+{
+	struct kbentry ke;
+
+	ke.kb_table = (unsigned char) t;
+	ke.kb_index = (unsigned char) i;
+	ke.kb_value = value;
+
+	if (console_ioctl(ctx, fd, KDSKBENT, (unsigned long)&ke)) {
+		ERR(ctx, _("KDSKBENT: %s: error at index %d in table %d"),
+		    strerror(errno), i, t);
+		return -1;
+	}
+
+	return 0;
+}
+
+static int
+read_keys(struct lk_ctx *ctx, int fd, struct snapshot *snap)
+{
+	struct snapshot_table tbl;
+	int i, t;
+
+	snap->tables = malloc(MAX_NR_KEYMAPS * sizeof(struct snapshot_table));
+	if (!snap->tables) {
+		ERR(ctx, _("out of memory"));
+		return -1;
+	}
+
+	for (t = 0; t < MAX_NR_KEYMAPS; t++) {
+		if (kernel_get_key(ctx, fd, t, 0, &tbl.keys[0]) < 0)
+			return -1;
+
+		if (tbl.keys[0] == K_NOSUCHMAP)
+			continue;
+
+		for (i = 1; i < NR_KEYS; i++) {
+			if (kernel_get_key(ctx, fd, t, i, &tbl.keys[i]) < 0)
+				return -1;
+		}
+
+		tbl.table = (uint16_t) t;
+		snap->tables[snap->hdr.nr_tables++] = tbl;
+	}
+
+	return 0;
+}
+
+static int
+read_funcs(struct lk_ctx *ctx, int fd, struct snapshot *snap)
+{
+	struct kbsentry kbs;
+	unsigned int i;
+
+	for (i = 0; i < MAX_NR_FUNC; i++) {
+		kbs.kb_func = (unsigned char) i;
+
+		if (console_ioctl(ctx, fd, KDGKBSENT, (unsigned long)&kbs)) {
+			ERR(ctx, _("KDGKBSENT: %s: Unable to get function key string"),
+			    strerror(errno));
+			return -1;
+		}
+
+		kbs.kb_string[sizeof(kbs.kb_string) - 1] = 0;
+
+		if (!kbs.kb_string[0])
+			continue;
+
+		snap->funcs[i] = strdup((char *)kbs.kb_string);
+		if (!snap->funcs[i]) {
+			ERR(ctx, _("out of memory"));
+			return -1;
+		}
+
+		snap->hdr.nr_funcs++;
+	}
+
+	return 0;
+}
+
+static int
+read_diacrs(struct lk_ctx *ctx, int fd, struct snapshot *snap)
+{
+#ifdef KDGKBDIACRUC
+	unsigned long request = KDGKBDIACRUC;
+	struct kbdiacrsuc kd;
+	struct kbdiacruc *ar = kd.kbdiacruc;
+#else
+	unsigned long request = KDGKBDIACR;
+	struct kbdiacrs kd;
+	struct kbdiacr *ar = kd.kbdiacr;
+#endif
+	unsigned int i;
+
+	if (console_ioctl(ctx, fd, request, (unsigned long)&kd)) {
+		ERR(ctx, _("KDGKBDIACR(UC): %s: Unable to get accent table"),
+		    strerror(errno));
+		return -1;
+	}
+
+	snap->diacrs = calloc(kd.kb_cnt ? kd.kb_cnt : 1, sizeof(struct snapshot_diacr));
+	if (!snap->diacrs) {
+		ERR(ctx, _("out of memory"));
+		return -1;
+	}
+
+	for (i = 0; i < kd.kb_cnt; i++) {
+		snap->diacrs[i].diacr  = ar[i].diacr;
+		snap->diacrs[i].base   = ar[i].base;
+		snap->diacrs[i].result = ar[i].result;
+	}
+
+	snap->hdr.nr_diacrs = kd.kb_cnt;
+
+	return 0;
+}
+
+static int
+write_snapshot(struct snapshot *snap, FILE *fp)
+{
+	struct snapshot_func sf;
+	unsigned int i;
+
+	if (fwrite(&snap->hdr, sizeof(snap->hdr), 1, fp) != 1)
+		return -1;
+
+	if (snap->hdr.nr_tables &&
+	    fwrite(snap->tables, sizeof(struct snapshot_table), snap->hdr.nr_tables, fp) != snap->hdr.nr_tables)
+		return -1;
+
+	for (i = 0; i < MAX_NR_FUNC; i++) {
+		if (!snap->funcs[i])
+			continue;
+
+		sf.func = (uint16_t) i;
+		sf.len  = (uint16_t) strlen(snap->funcs[i]);
+
+		if (fwrite(&sf, sizeof(sf), 1, fp) != 1 ||
+		    fwrite(snap->funcs[i], 1, sf.len, fp) != sf.len)
+			return -1;
+	}
+
+	if (snap->hdr.nr_diacrs &&
+	    fwrite(snap->diacrs, sizeof(struct snapshot_diacr), snap->hdr.nr_diacrs, fp) != snap->hdr.nr_diacrs)
+		return -1;
+
+	return 0;
+}
+
+int lk_kernel_snapshot(struct lk_ctx *ctx, int fd, FILE *fp)
+{
+	struct snapshot snap;
+	int kbd_mode, meta_mode;
+	int rc = -1;
+
+	memset(&snap, 0, sizeof(snap));
+	memcpy(snap.hdr.magic, SNAPSHOT_MAGIC, sizeof(snap.hdr.magic));
+	snap.hdr.version = SNAPSHOT_VERSION;
+
+	if (console_ioctl(ctx, fd, KDGKBMODE, (unsigned long)&kbd_mode)) {
+		ERR(ctx, _("KDGKBMODE: %s: Unable to read keyboard mode"), strerror(errno));
+		return -1;
+	}
+
+	if (console_ioctl(ctx, fd, KDGKBMETA, (unsigned long)&meta_mode)) {
+		ERR(ctx, _("KDGKBMETA: %s: Unable to read meta key handling mode"), strerror(errno));
+		return -1;
+	}
+
+	snap.hdr.kbd_mode  = (uint32_t) kbd_mode;
+	snap.hdr.meta_mode = (uint32_t) meta_mode;
+
+	/*
+	 * Outside K_UNICODE mode the kernel reports Unicode keysyms as holes,
+	 * so read the keys in K_UNICODE mode to capture them as well.
+	 */
+	if (kbd_mode != K_UNICODE && console_ioctl(ctx, fd, KDSKBMODE, K_UNICODE)) {
+		ERR(ctx, _("KDSKBMODE: %s: could not switch to Unicode mode"),
+		    strerror(errno));
+		return -1;
+	}
+
+	rc = read_keys(ctx, fd, &snap);
+
+	if (kbd_mode != K_UNICODE && console_ioctl(ctx, fd, KDSKBMODE, (unsigned long)kbd_mode)) {
+		ERR(ctx, _("KDSKBMODE: %s: could not return to original keyboard mode"),
+		    strerror(errno));
+		rc = -1;
+	}
+
+	if (rc < 0 ||
+	    (rc = read_funcs(ctx, fd, &snap)) < 0 ||
+	    (rc = read_diacrs(ctx, fd, &snap)) < 0)
+		goto end;
+
+	if (write_snapshot(&snap, fp) < 0 || fflush(fp) || ferror(fp)) {
+		ERR(ctx, _("Error writing snapshot"));
+		rc = -1;
+	}
+
+end:
+	free_snapshot(&snap);
+	return rc;
+}
+
+static int
+valid_modes(const struct snapshot_header *hdr)
+{
+	switch (hdr->kbd_mode) {
+		case K_RAW:
+		case K_XLATE:
+		case K_MEDIUMRAW:
+		case K_UNICODE:
+		case K_OFF:
+			break;
+		default:
+			return 0;
+	}
+
+	return hdr->meta_mode == K_METABIT || hdr->meta_mode == K_ESCPREFIX;
+}
+
+static int
+read_snapshot(struct lk_ctx *ctx, FILE *fp, struct snapshot *snap)
+{
+	struct snapshot_func sf;
+	unsigned int i;
+
+	if (fread(&snap->hdr, sizeof(snap->hdr), 1, fp) != 1 ||
+	    memcmp(snap->hdr.magic, SNAPSHOT_MAGIC, sizeof(snap->hdr.magic))) {
+		ERR(ctx, _("Not a keyboard snapshot"));
+		return -1;
+	}
+
+	if (snap->hdr.version != SNAPSHOT_VERSION) {
+		ERR(ctx, _("Unsupported snapshot version %d"), snap->hdr.version);
+		return -1;
+	}
+
+	if (!valid_modes(&snap->hdr) ||
+	    snap->hdr.nr_tables > MAX_NR_KEYMAPS ||
+	    snap->hdr.nr_funcs > MAX_NR_FUNC ||
+	    snap->hdr.nr_diacrs > MAX_DIACR)
+		goto bad;
+
+	snap->tables = calloc(snap->hdr.nr_tables + 1, sizeof(struct snapshot_table));
+	snap->diacrs = calloc(snap->hdr.nr_diacrs + 1, sizeof(struct snapshot_diacr));
+
+	if (!snap->tables || !snap->diacrs) {
+		ERR(ctx, _("out of memory"));
+		return -1;
+	}
+
+	if (fread(snap->tables, sizeof(struct snapshot_table), snap->hdr.nr_tables, fp) != snap->hdr.nr_tables)
+		goto bad;
+
+	for (i = 0; i < snap->hdr.nr_tables; i++) {
+		if (snap->tables[i].table >= MAX_NR_KEYMAPS ||
+		    (i && snap->tables[i].table <= snap->tables[i - 1].table))
+			goto bad;
+	}
+
+	for (i = 0; i < snap->hdr.nr_funcs; i++) {
+		if (fread(&sf, sizeof(sf), 1, fp) != 1 ||
+		    sf.func >= MAX_NR_FUNC || snap->funcs[sf.func] ||
+		    sf.len >= sizeof(((struct kbsentry *)0)->kb_string))
+			goto bad;
+
+		snap->funcs[sf.func] = calloc(1, sf.len + 1U);
+		if (!snap->funcs[sf.func]) {
+			ERR(ctx, _("out of memory"));
+			return -1;
+		}
+
+		if (fread(snap->funcs[sf.func], 1, sf.len, fp) != sf.len)
+			goto bad;
+	}
+
+	if (fread(snap->diacrs, sizeof(struct snapshot_diacr), snap->hdr.nr_diacrs, fp) != snap->hdr.nr_diacrs)
+		goto bad;
+
+	return 0;
+
+bad:
+	ERR(ctx, _("Corrupted keyboard snapshot"));
+	return -1;
+}
+
+/*
+ * The kernel ignores writes to index 0 (they only validate the value) and
+ * fills a newly allocated table with holes. So a table that does not exist
+ * gets only its non-hole keys written, and an existing one only the keys
+ * that differ from the snapshot.
+ */
+static int
+restore_table(struct lk_ctx *ctx, int fd, int t, const uint16_t *keys)
+{
+	uint16_t cur;
+	int i, ct = 0, exists;
+
+	if (kernel_get_key(ctx, fd, t, 0, &cur) < 0)
+		return -1;
+
+	exists = (cur != K_NOSUCHMAP);
+
+	for (i = 1; i < NR_KEYS; i++) {
+		if (!exists)
+			cur = K_HOLE;
+		else if (kernel_get_key(ctx, fd, t, i, &cur) < 0)
+			return -1;
+
+		if (keys[i] == cur)
+			continue;
+
+		if (set_key(ctx, fd, t, i, keys[i]) < 0)
+			return -1;
+		ct++;
+	}
+
+	/* a table without keys still has to exist */
+	if (!exists && !ct) {
+		if (set_key(ctx, fd, t, 1, K_HOLE) < 0)
+			return -1;
+	}
+
+	return ct;
+}
+
+/*
+ * Tables that are not in the snapshot are removed. The kernel also detaches
+ * static tables this way, only the plain table (0) always stays.
+ */
+static int
+remove_table(struct lk_ctx *ctx, int fd, int t)
+{
+	uint16_t cur;
+
+	if (kernel_get_key(ctx, fd, t, 0, &cur) < 0)
+		return -1;
+
+	if (cur == K_NOSUCHMAP)
+		return 0;
+
+	return set_key(ctx, fd, t, 0, K_NOSUCHMAP);
+}
+
+static int
+restore_keys(struct lk_ctx *ctx, int fd, struct snapshot *snap)
+{
+	unsigned int n = 0;
+	int t, ret, ct = 0;
+
+	for (t = 0; t < MAX_NR_KEYMAPS; t++) {
+		if (n < snap->hdr.nr_tables && snap->tables[n].table == t) {
+			ret = restore_table(ctx, fd, t, snap->tables[n].keys);
+			if (ret < 0)
+				return -1;
+			ct += ret;
+			n++;
+		} else if (t && remove_table(ctx, fd, t) < 0) {
+			return -1;
+		}
+	}
+
+	return ct;
+}
+
+static int
+restore_funcs(struct lk_ctx *ctx, int fd, struct snapshot *snap)
+{
+	struct kbsentry kbs;
+	const char *str;
+	unsigned int i;
+	int ct = 0;
+
+	for (i = 0; i < MAX_NR_FUNC; i++) {
+		kbs.kb_func = (unsigned char) i;
+
+		if (console_ioctl(ctx, fd, KDGKBSENT, (unsigned long)&kbs)) {
+			ERR(ctx, _("KDGKBSENT: %s: Unable to get function key string"),
+			    strerror(errno));
+			return -1;
+		}
+
+		kbs.kb_string[sizeof(kbs.kb_string) - 1] = 0;
+
+		str = snap->funcs[i] ? snap->funcs[i] : "";
+
+		if (!strcmp((char *)kbs.kb_string, str))
+			continue;
+
+		strcpy((char *)kbs.kb_string, str);
+
+		if (console_ioctl(ctx, fd, KDSKBSENT, (unsigned long)&kbs)) {
+			ERR(ctx, _("KDSKBSENT: %s: Unable to set function key string"),
+			    strerror(errno));
+			return -1;
+		}
+		ct++;
+	}
+
+	return ct;
+}
+
+static int
+restore_diacrs(struct lk_ctx *ctx, int fd, struct snapshot *snap)
+{
+#ifdef KDSKBDIACRUC
+	unsigned long request = KDSKBDIACRUC;
+	struct kbdiacrsuc kd;
+	struct kbdiacruc *ar = kd.kbdiacruc;
+#else
+	unsigned long request = KDSKBDIACR;
+	struct kbdiacrs kd;
+	struct kbdiacr *ar = kd.kbdiacr;
+#endif
+	struct snapshot cur;
+	unsigned int i;
+	int same;
+
+	memset(&cur, 0, sizeof(cur));
+
+	if (read_diacrs(ctx, fd, &cur) < 0) {
+		free_snapshot(&cur);
+		return -1;
+	}
+
+	same = (cur.hdr.nr_diacrs == snap->hdr.nr_diacrs &&
+	        !memcmp(cur.diacrs, snap->diacrs, snap->hdr.nr_diacrs * sizeof(struct snapshot_diacr)));
+
+	free_snapshot(&cur);
+
+	if (same)
+		return 0;
+
+	kd.kb_cnt = snap->hdr.nr_diacrs;
+
+	for (i = 0; i < kd.kb_cnt; i++) {
+		ar[i].diacr  = snap->diacrs[i].diacr;
+		ar[i].base   = snap->diacrs[i].base;
+		ar[i].result = snap->diacrs[i].result;
+	}
+
+	if (console_ioctl(ctx, fd, request, (unsigned long)&kd)) {
+		ERR(ctx, _("KDSKBDIACR(UC): %s: Unable to set accent table"),
+		    strerror(errno));
+		return -1;
+	}
+
+	return (int) kd.kb_cnt;
+}
+
+int lk_kernel_restore(struct lk_ctx *ctx, int fd, FILE *fp)
+{
+	struct snapshot snap;
+	int keyct, funcct, diacct, meta_mode;
+	int rc = -1;
+
+	memset(&snap, 0, sizeof(snap));
+
+	if (read_snapshot(ctx, fp, &snap) < 0)
+		goto end;
+
+	/* Unicode keysyms can only be bound in K_UNICODE mode */
+	if (console_ioctl(ctx, fd, KDSKBMODE, K_UNICODE)) {
+		ERR(ctx, _("KDSKBMODE: %s: could not switch to Unicode mode"),
+		    strerror(errno));
+		goto end;
+	}
+
+	keyct = restore_keys(ctx, fd, &snap);
+
+	if (snap.hdr.kbd_mode != K_UNICODE && console_ioctl(ctx, fd, KDSKBMODE, snap.hdr.kbd_mode)) {
+		ERR(ctx, _("KDSKBMODE: %s: could not return to original keyboard mode"),
+		    strerror(errno));
+		goto end;
+	}
+
+	if (keyct < 0 ||
+	    (funcct = restore_funcs(ctx, fd, &snap)) < 0 ||
+	    (diacct = restore_diacrs(ctx, fd, &snap)) < 0)
+		goto end;
+
+	if (console_ioctl(ctx, fd, KDGKBMETA, (unsigned long)&meta_mode)) {
+		ERR(ctx, _("KDGKBMETA: %s: Unable to read meta key handling mode"), strerror(errno));
+		goto end;
+	}
+
+	if ((uint32_t) meta_mode != snap.hdr.meta_mode &&
+	    console_ioctl(ctx, fd, KDSKBMETA, snap.hdr.meta_mode)) {
+		ERR(ctx, _("KDSKBMETA: %s: Unable to set meta key handling mode"),
+		    strerror(errno));
+		goto end;
+	}
+
+	INFO(ctx, P_("Restored %d key", "Restored %d keys", (unsigned int) keyct), keyct);
+	INFO(ctx, P_("Restored %d string", "Restored %d strings", (unsigned int) funcct), funcct);
+	INFO(ctx, P_("Restored %d compose definition",
+	             "Restored %d compose definitions", (unsigned int) diacct),
+	     diacct);
+
+	rc = 0;
+end:
+	free_snapshot(&snap);
+	return rc;
+}
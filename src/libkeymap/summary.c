@@ -9,7 +9,6 @@
 #include "config.h"
 #include <string.h>
 #include <errno.h>
-#include <sys/ioctl.h>
 
 #include "keymap.h"
 
@@ -19,7 +18,7 @@
 #include "modifiers.h"
 
 static char
-valid_type(int fd, int t)
+valid_type(struct lk_ctx *ctx, int fd, int t)
 {
 	struct kbentry ke;
 
@@ -27,11 +26,11 @@ valid_type(int fd, int t)
 	ke.kb_table = 0;
 	ke.kb_value = (unsigned short) K(t, 0);
 
-	return (ioctl(fd, KDSKBENT, (unsigned long)&ke) == 0);
+	return (console_ioctl(ctx, fd, KDSKBENT, (unsigned long)&ke) == 0);
 }
 
 static unsigned char
-maximum_val(int fd, int t)
+maximum_val(struct lk_ctx *ctx, int fd, int t)
 {
 	struct kbentry ke, ke0;
 	int i;
@@ -41,15 +40,15 @@ maximum_val(int fd, int t)
 	ke.kb_value = K_HOLE;
 	ke0         = ke;
 
-	ioctl(fd, KDGKBENT, (unsigned long)&ke0);
+	console_ioctl(ctx, fd, KDGKBENT, (unsigned long)&ke0);
 
 	for (i = 0; i < 256; i++) {
 		ke.kb_value = (unsigned short) K(t, i);
-		if (ioctl(fd, KDSKBENT, (unsigned long)&ke))
+		if (console_ioctl(ctx, fd, KDSKBENT, (unsigned long)&ke))
 			break;
 	}
 	ke.kb_value = K_HOLE;
-	ioctl(fd, KDSKBENT, (unsigned long)&ke0);
+	console_ioctl(ctx, fd, KDSKBENT, (unsigned long)&ke0);
 
 	return (unsigned char) (i - 1);
 }
@@ -101,9 +100,9 @@ void lk_dump_summary(struct lk_ctx *ctx, FILE *fd, int console)
 
 	fprintf(fd, _("ranges of action codes supported by kernel:\n"));
 
-	for (i = 0; i < NR_TYPES && valid_type(console, i); i++)
+	for (i = 0; i < NR_TYPES && valid_type(ctx, console, i); i++)
 		fprintf(fd, "	0x%04x - 0x%04x\n",
-		        K(i, 0), K(i, maximum_val(console, i)));
+		        K(i, 0), K(i, maximum_val(ctx, console, i)));
 
 	fprintf(fd, _("number of function keys supported by kernel: %d\n"),
 	        MAX_NR_FUNC);
@@ -0,0 +1,673 @@
+/* translator.c
+ *
+ * This file is part of kbd project.
+ *
+ * This file is covered by the GNU General Public License,
+ * which should be included with kbd as the file COPYING.
+ *
+ * The key handling follows drivers/tty/vt/keyboard.c so that the output
+ * matches what the kernel would produce with the same keymap loaded.
+ */
+#include "config.h"
+
+#include <stdlib.h>
+#include <string.h>
+
+#include "keymap.h"
+
+#include "libcommon.h"
+#include "contextP.h"
+#include "ksyms.h"
+
+struct lk_translator {
+	lk_translate_flags flags;
+
+	/* the key tables */
+	struct lk_frozen_keymap *km;
+
+	/* offset of each function string in func_buf plus one, 0 if unset */
+	unsigned int func_off[MAX_NR_FUNC];
+	char *func_buf;
+
+	/* private context with the accent table in Unicode, indexed by (diacr, base) */
+	struct lk_ctx *compose;
+
+	/* Unicode value of every 8-bit character of the charset */
+	unsigned int to_uni[256];
+
+	/* keyboard state */
+	unsigned int shift_state;
+	unsigned int lockstate;
+	unsigned int slockstate;
+	unsigned int ledstate;
+	unsigned char shift_down[NR_SHIFT];
+	unsigned char key_down[NR_KEYS / 8];
+	unsigned int diacr;
+	int dead_key_next;
+	unsigned int npadch_value;
+	int npadch_active;
+};
+
+struct output {
+	char *buf;
+	size_t size;
+	size_t len;
+};
+
+/* Characters returned by the dead keys of KT_DEAD, in KVAL order. */
+static const unsigned char ret_diacr[] = {
+	'`', '\'', '^', '~', '"', ',', '_', 'U', '.', '*', '=', 'c', 'k', 'i',
+	'#', 'o', '!', '?', '+', '-', ')', '(', ':', 'n', ';', '$', '@'
+};
+
+static const char pad_chars[] = "0123456789+-*/\015,.?()#";
+static const char cur_chars[] = "BDCA";
+
+static int
+build_compose(struct lk_translator *tr, struct lk_ctx *ctx)
+{
+	int unicode = (ctx->flags & LK_FLAG_PREFER_UNICODE) != 0;
+	ssize_t i;
+
+	tr->compose = lk_init();
+	if (!tr->compose)
+		return -1;
+
+	lk_set_log_fn(tr->compose, NULL, NULL);
+
+	for (i = 0; i < ctx->accent_table->total; i++) {
+		struct lk_kbdiacr *ptr = lk_array_get_ptr(ctx->accent_table, i);
+		struct lk_kbdiacr dcr, prev;
+
+		if (!ptr)
+			continue;
+
+		dcr.diacr  = ptr->diacr;
+		dcr.base   = ptr->base;
+		dcr.result = ptr->result;
+
+		/* an 8-bit accent table is in the charset of the keymap */
+		if (!unicode) {
+			dcr.diacr  = tr->to_uni[dcr.diacr & 0xff];
+			dcr.base   = tr->to_uni[dcr.base & 0xff];
+			dcr.result = tr->to_uni[dcr.result & 0xff];
+		}
+
+		/*
+		 * The kernel uses the first matching entry, while appending
+		 * the same pair again would replace its result.
+		 */
+		prev = dcr;
+
+		if (lk_find_compose(tr->compose, &prev) >= 0)
+			continue;
+
+		if (lk_append_diacr(tr->compose, &dcr) < 0)
+			return -1;
+	}
+
+	return 0;
+}
+
+static int
+build_funcs(struct lk_translator *tr, struct lk_ctx *ctx)
+{
+	size_t len = 0;
+	int i;
+
+	for (i = 0; i < MAX_NR_FUNC; i++) {
+		char *s = lk_array_get_ptr(ctx->func_table, i);
+		if (s)
+			len += strlen(s) + 1;
+	}
+
+	tr->func_buf = malloc(len ? len : 1);
+	if (!tr->func_buf)
+		return -1;
+
+	len = 0;
+	for (i = 0; i < MAX_NR_FUNC; i++) {
+		char *s = lk_array_get_ptr(ctx->func_table, i);
+		size_t n;
+
+		if (!s)
+			continue;
+
+		n = strlen(s) + 1;
+		memcpy(tr->func_buf + len, s, n);
+		tr->func_off[i] = (unsigned int) len + 1;
+		len += n;
+	}
+
+	return 0;
+}
+
+struct lk_translator *
+lk_translator_new(struct lk_ctx *ctx, lk_translate_flags flags)
+{
+	struct lk_translator *tr;
+
+	tr = calloc(1, sizeof(*tr));
+	if (!tr)
+		goto nomem;
+
+	tr->flags = flags;
+
+	/* this adds the constant keys to the context */
+	tr->km = lk_keymap_freeze(ctx);
+	if (!tr->km) {
+		lk_translator_free(tr);
+		return NULL;
+	}
+
+	charset_to_unicode(ctx->charset, tr->to_uni);
+
+	if (build_funcs(tr, ctx) < 0 || build_compose(tr, ctx) < 0)
+		goto nomem;
+
+	return tr;
+
+nomem:
+	ERR(ctx, _("out of memory"));
+	lk_translator_free(tr);
+	return NULL;
+}
+
+void lk_translator_free(struct lk_translator *tr)
+{
+	if (!tr)
+		return;
+
+	lk_free(tr->compose);
+	lk_frozen_unref(tr->km);
+	free(tr->func_buf);
+	free(tr);
+}
+
+void lk_translator_reset(struct lk_translator *tr)
+{
+	tr->shift_state   = 0;
+	tr->lockstate     = 0;
+	tr->slockstate    = 0;
+	tr->ledstate      = 0;
+	tr->diacr         = 0;
+	tr->dead_key_next = 0;
+	tr->npadch_value  = 0;
+	tr->npadch_active = 0;
+
+	memset(tr->shift_down, 0, sizeof(tr->shift_down));
+	memset(tr->key_down, 0, sizeof(tr->key_down));
+}
+
+unsigned int lk_translator_get_leds(const struct lk_translator *tr)
+{
+	return tr->ledstate;
+}
+
+void lk_translator_set_leds(struct lk_translator *tr, unsigned int leds)
+{
+	tr->ledstate = leds & (LED_SCR | LED_NUM | LED_CAP);
+}
+
+int lk_translator_get_table(const struct lk_translator *tr)
+{
+	return (int) ((tr->shift_state | tr->slockstate) ^ tr->lockstate);
+}
+
+static inline void
+put_char(struct output *out, unsigned char c)
+{
+	if (out->len < out->size)
+		out->buf[out->len] = (char) c;
+	out->len++;
+}
+
+static void
+put_string(struct output *out, const char *s)
+{
+	while (*s)
+		put_char(out, (unsigned char) *s++);
+}
+
+static void
+put_utf8(struct output *out, unsigned int c)
+{
+	if (c < 0x80) {
+		put_char(out, (unsigned char) c);
+	} else if (c < 0x800) {
+		put_char(out, (unsigned char) (0xc0 | (c >> 6)));
+		put_char(out, (unsigned char) (0x80 | (c & 0x3f)));
+	} else if (c < 0x10000) {
+		if (c >= 0xd800 && c < 0xe000)
+			return;
+		if (c == 0xffff)
+			return;
+		put_char(out, (unsigned char) (0xe0 | (c >> 12)));
+		put_char(out, (unsigned char) (0x80 | ((c >> 6) & 0x3f)));
+		put_char(out, (unsigned char) (0x80 | (c & 0x3f)));
+	} else if (c < 0x110000) {
+		put_char(out, (unsigned char) (0xf0 | (c >> 18)));
+		put_char(out, (unsigned char) (0x80 | ((c >> 12) & 0x3f)));
+		put_char(out, (unsigned char) (0x80 | ((c >> 6) & 0x3f)));
+		put_char(out, (unsigned char) (0x80 | (c & 0x3f)));
+	}
+}
+
+static int
+uni_to_8bit(const struct lk_translator *tr, unsigned int c)
+{
+	int i;
+
+	if (c < 0x80)
+		return (int) c;
+
+	for (i = 0x80; i < 256; i++) {
+		if (tr->to_uni[i] == c)
+			return i;
+	}
+
+	return -1;
+}
+
+/* Outputs a Unicode character in the configured encoding. */
+static void
+put_unicode(struct lk_translator *tr, struct output *out, unsigned int c)
+{
+	int ch;
+
+	if (tr->flags & LK_TRANSLATE_UNICODE) {
+		put_utf8(out, c);
+		return;
+	}
+
+	ch = uni_to_8bit(tr, c);
+	if (ch != -1)
+		put_char(out, (unsigned char) ch);
+}
+
+static unsigned int
+find_compose(struct lk_translator *tr, unsigned int diacr, unsigned int base, int *found)
+{
+	struct lk_kbdiacr dcr = { diacr, base, 0 };
+
+	*found = (lk_find_compose(tr->compose, &dcr) >= 0);
+	return dcr.result;
+}
+
+/*
+ * We have a combining character DIACR here, followed by the character CH.
+ * If the combination occurs in the table, return the corresponding value.
+ * Otherwise, if CH is a space or equals DIACR, return DIACR.
+ * Otherwise, conclude that DIACR was not combining after all,
+ * queue it and return CH.
+ */
+static unsigned int
+handle_diacr(struct lk_translator *tr, struct output *out, unsigned int ch)
+{
+	unsigned int d = tr->diacr;
+	unsigned int result;
+	int found;
+
+	tr->diacr = 0;
+
+	result = find_compose(tr, d, ch, &found);
+	if (found)
+		return result;
+
+	if (ch == ' ' || ch == d)
+		return d;
+
+	put_unicode(tr, out, d);
+	return ch;
+}
+
+static void
+k_unicode(struct lk_translator *tr, struct output *out, unsigned int value)
+{
+	if (tr->diacr)
+		value = handle_diacr(tr, out, value);
+
+	if (tr->dead_key_next) {
+		tr->dead_key_next = 0;
+		tr->diacr         = value;
+		return;
+	}
+
+	put_unicode(tr, out, value);
+}
+
+static void
+k_deadunicode(struct lk_translator *tr, struct output *out, unsigned int value)
+{
+	tr->diacr = (tr->diacr ? handle_diacr(tr, out, value) : value);
+}
+
+static void
+k_fn(struct lk_translator *tr, struct output *out, unsigned char value)
+{
+	if (tr->func_off[value])
+		put_string(out, tr->func_buf + tr->func_off[value] - 1);
+}
+
+static void
+applkey(struct output *out, char key)
+{
+	put_char(out, '\033');
+	put_char(out, '[');
+	put_char(out, (unsigned char) key);
+}
+
+static void
+k_spec(struct lk_translator *tr, struct output *out, unsigned char value, int rep)
+{
+	switch (value) {
+		case KVAL(K_ENTER):
+			if (tr->diacr) {
+				put_unicode(tr, out, tr->diacr);
+				tr->diacr = 0;
+			}
+			put_char(out, '\r');
+			if (tr->flags & LK_TRANSLATE_CRLF)
+				put_char(out, '\n');
+			break;
+		case KVAL(K_CAPS):
+			if (!rep)
+				tr->ledstate ^= LED_CAP;
+			break;
+		case KVAL(K_CAPSON):
+			if (!rep)
+				tr->ledstate |= LED_CAP;
+			break;
+		case KVAL(K_NUM):
+		case KVAL(K_BARENUMLOCK):
+			if (!rep)
+				tr->ledstate ^= LED_NUM;
+			break;
+		case KVAL(K_HOLD):
+			if (!rep)
+				tr->ledstate ^= LED_SCR;
+			break;
+		case KVAL(K_COMPOSE):
+			tr->dead_key_next = 1;
+			break;
+		default:
+			/* console actions do not produce any output */
+			break;
+	}
+}
+
+static void
+k_pad(struct lk_translator *tr, struct output *out, unsigned char value)
+{
+	if (value >= sizeof(pad_chars) - 1)
+		return;
+
+	if (!(tr->ledstate & LED_NUM)) {
+		switch (value) {
+			case KVAL(K_PCOMMA):
+			case KVAL(K_PDOT):
+				k_fn(tr, out, KVAL(K_REMOVE));
+				return;
+			case KVAL(K_P0):
+				k_fn(tr, out, KVAL(K_INSERT));
+				return;
+			case KVAL(K_P1):
+				k_fn(tr, out, KVAL(K_SELECT));
+				return;
+			case KVAL(K_P2):
+				applkey(out, cur_chars[KVAL(K_DOWN)]);
+				return;
+			case KVAL(K_P3):
+				k_fn(tr, out, KVAL(K_PGDN));
+				return;
+			case KVAL(K_P4):
+				applkey(out, cur_chars[KVAL(K_LEFT)]);
+				return;
+			case KVAL(K_P5):
+				applkey(out, 'G');
+				return;
+			case KVAL(K_P6):
+				applkey(out, cur_chars[KVAL(K_RIGHT)]);
+				return;
+			case KVAL(K_P7):
+				k_fn(tr, out, KVAL(K_FIND));
+				return;
+			case KVAL(K_P8):
+				applkey(out, cur_chars[KVAL(K_UP)]);
+				return;
+			case KVAL(K_P9):
+				k_fn(tr, out, KVAL(K_PGUP));
+				return;
+		}
+	}
+
+	put_char(out, (unsigned char) pad_chars[value]);
+	if (value == KVAL(K_PENTER) && (tr->flags & LK_TRANSLATE_CRLF))
+		put_char(out, '\n');
+}
+
+static void
+k_shift(struct lk_translator *tr, struct output *out, unsigned char value, int up, int rep)
+{
+	unsigned int old_state = tr->shift_state;
+
+	if (rep || value >= NR_SHIFT)
+		return;
+
+	if (value == KG_CAPSSHIFT) {
+		value = KG_SHIFT;
+		if (!up)
+			tr->ledstate &= ~(unsigned int) LED_CAP;
+	}
+
+	if (up) {
+		if (tr->shift_down[value])
+			tr->shift_down[value]--;
+	} else if (tr->shift_down[value] < 0xff) {
+		tr->shift_down[value]++;
+	}
+
+	if (tr->shift_down[value])
+		tr->shift_state |= (1U << value);
+	else
+		tr->shift_state &= ~(1U << value);
+
+	/* releasing the modifier ends a character typed as Alt+digits */
+	if (up && tr->shift_state != old_state && tr->npadch_active) {
+		if (tr->flags & LK_TRANSLATE_UNICODE)
+			put_utf8(out, tr->npadch_value);
+		else
+			put_char(out, (unsigned char) (tr->npadch_value & 0xff));
+		tr->npadch_active = 0;
+	}
+}
+
+static void
+k_meta(struct lk_translator *tr, struct output *out, unsigned char value)
+{
+	if (tr->flags & LK_TRANSLATE_META_ESC) {
+		put_char(out, '\033');
+		put_char(out, value);
+	} else {
+		put_char(out, value | 0x80);
+	}
+}
+
+static void
+k_ascii(struct lk_translator *tr, unsigned char value)
+{
+	unsigned int base = 10;
+
+	if (value >= 10) {
+		value -= 10;
+		base = 16;
+	}
+
+	if (!tr->npadch_active) {
+		tr->npadch_value  = 0;
+		tr->npadch_active = 1;
+	}
+
+	tr->npadch_value = tr->npadch_value * base + value;
+}
+
+static void
+k_slock(struct lk_translator *tr, struct output *out, unsigned char value, int up, int rep)
+{
+	k_shift(tr, out, value, up, rep);
+
+	if (up || rep || value >= NR_SHIFT)
+		return;
+
+	tr->slockstate ^= (1U << value);
+
+	/* try to make Alt, oops, AltGr and such work */
+	if (!lk_frozen_map_exists(tr->km, (int) (tr->lockstate ^ tr->slockstate))) {
+		tr->slockstate = (1U << value);
+	}
+}
+
+/*
+ * Recomputes the modifiers from the keys that are held down. Used when the
+ * current combination of modifiers has no table, so some releases may have
+ * been looked up in the wrong place.
+ */
+static void
+compute_shiftstate(struct lk_translator *tr)
+{
+	int k, keysym;
+
+	tr->shift_state = 0;
+	memset(tr->shift_down, 0, sizeof(tr->shift_down));
+
+	if (!lk_frozen_map_exists(tr->km, 0))
+		return;
+
+	for (k = 0; k < NR_KEYS; k++) {
+		unsigned int val;
+
+		if (!(tr->key_down[k / 8] & (1U << (k % 8))))
+			continue;
+
+		keysym = lk_frozen_get_key(tr->km, 0, k);
+
+		if (keysym >= 0x1000 || (KTYP(keysym) != KT_SHIFT && KTYP(keysym) != KT_SLOCK))
+			continue;
+
+		val = KVAL(keysym);
+		if (val >= NR_SHIFT)
+			continue;
+		if (val == KG_CAPSSHIFT)
+			val = KG_SHIFT;
+
+		tr->shift_down[val]++;
+		tr->shift_state |= (1U << val);
+	}
+}
+
+int lk_translate(struct lk_translator *tr, int keycode, int down, char *buf, size_t size)
+{
+	struct output out;
+	unsigned int table;
+	int keysym, type, up, rep;
+	unsigned char value;
+
+	if (keycode < 0 || keycode >= NR_KEYS)
+		return -1;
+
+	out.buf  = buf;
+	out.size = buf ? size : 0;
+	out.len  = 0;
+
+	if (down)
+		tr->key_down[keycode / 8] |= (unsigned char) (1U << (keycode % 8));
+	else
+		tr->key_down[keycode / 8] &= (unsigned char) ~(1U << (keycode % 8));
+
+	up  = !down;
+	rep = (down == 2);
+
+	table  = (tr->shift_state | tr->slockstate) ^ tr->lockstate;
+	keysym = lk_frozen_get_key(tr->km, (int) table, keycode);
+
+	if (keysym < 0) {
+		compute_shiftstate(tr);
+		tr->slockstate = 0;
+		return 0;
+	}
+
+	if (keysym >= 0x1000) {
+		if (!up)
+			k_unicode(tr, &out, (unsigned int) keysym ^ 0xf000);
+		return (int) out.len;
+	}
+
+	type  = KTYP(keysym);
+	value = (unsigned char) KVAL(keysym);
+
+	if (type == KT_LETTER) {
+		type = KT_LATIN;
+		if (tr->ledstate & LED_CAP) {
+			int shifted = lk_frozen_get_key(tr->km, (int) (table ^ (1U << KG_SHIFT)), keycode);
+			if (shifted >= 0)
+				value = (unsigned char) KVAL(shifted);
+		}
+	}
+
+	switch (type) {
+		case KT_LATIN:
+			if (!up)
+				k_unicode(tr, &out, tr->to_uni[value]);
+			break;
+		case KT_FN:
+			if (!up)
+				k_fn(tr, &out, value);
+			break;
+		case KT_SPEC:
+			if (!up)
+				k_spec(tr, &out, value, rep);
+			break;
+		case KT_PAD:
+			if (!up)
+				k_pad(tr, &out, value);
+			break;
+		case KT_DEAD:
+			if (!up && value < sizeof(ret_diacr))
+				k_deadunicode(tr, &out, ret_diacr[value]);
+			break;
+		case KT_DEAD2:
+			if (!up)
+				k_deadunicode(tr, &out, tr->to_uni[value]);
+			break;
+		case KT_CUR:
+			if (!up && value < sizeof(cur_chars) - 1)
+				applkey(&out, cur_chars[value]);
+			break;
+		case KT_SHIFT:
+			k_shift(tr, &out, value, up, rep);
+			break;
+		case KT_META:
+			if (!up)
+				k_meta(tr, &out, value);
+			break;
+		case KT_ASCII:
+			if (!up && value < 26)
+				k_ascii(tr, value);
+			break;
+		case KT_LOCK:
+			if (!up && !rep && value < NR_SHIFT)
+				tr->lockstate ^= (1U << value);
+			break;
+		case KT_SLOCK:
+			k_slock(tr, &out, value, up, rep);
+			break;
+		default:
+			/* console switching and braille do not produce output */
+			break;
+	}
+
+	if (type != KT_SLOCK)
+		tr->slockstate = 0;
+
+	return (int) out.len;
+}
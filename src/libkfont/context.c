@@ -8,6 +8,7 @@
 #include <stdlib.h>
 #include <stdio.h>
 #include <syslog.h>
+#include <sys/ioctl.h>
 
 #include "kfontP.h"
 
@@ -47,6 +48,7 @@ static const char *const unisuffixes[] = {
 	"",
 	".uni",
 	".sfm",
+	".unib",
 	NULL
 };
 
@@ -84,6 +86,24 @@ kfont_inc_verbosity(struct kfont_context *ctx)
 	ctx->verbose++;
 }
 
+static int
+default_ioctl(void *data KBD_ATTR_UNUSED, int fd, unsigned long request, unsigned long arg)
+{
+	return ioctl(fd, request, arg);
+}
+
+static const struct kfont_console_ops default_console_ops = {
+	.ioctl = default_ioctl,
+};
+
+void
+kfont_set_console_ops(struct kfont_context *ctx,
+		const struct kfont_console_ops *ops, void *data)
+{
+	ctx->console_ops  = ops ? ops : &default_console_ops;
+	ctx->console_data = ops ? data : NULL;
+}
+
 void
 kfont_set_logger(struct kfont_context *ctx, kfont_logger_t fn)
 {
@@ -157,6 +177,7 @@ kfont_init(const char *prefix, struct kfont_context **ctx)
 	p->verbose = 0;
 	p->options = 0;
 	p->log_fn = log_stderr;
+	p->console_ops = &default_console_ops;
 	p->mapdirpath = mapdirpath;
 	p->mapsuffixes = mapsuffixes;
 	p->fontdirpath = fontdirpath;
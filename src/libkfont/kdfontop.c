@@ -11,7 +11,6 @@
 #include <stdlib.h> /* free() */
 #include <string.h>
 #include <limits.h>
-#include <sys/ioctl.h>
 #include <linux/kd.h>
 
 #include "libcommon.h"
@@ -26,7 +25,7 @@ is_kd_text(struct kfont_context *ctx, int fd)
 {
 	unsigned int kd_mode;
 
-	if (ioctl(fd, KDGETMODE, &kd_mode)) {
+	if (console_ioctl(ctx, fd, KDGETMODE, (unsigned long)&kd_mode)) {
 		KFONT_ERR(ctx, "ioctl(KDGETMODE): %m");
 		return 0;
 	}
@@ -48,7 +47,7 @@ kfont_restore_font(struct kfont_context *ctx, int fd)
 
 	cfo.op = KD_FONT_OP_SET_DEFAULT;
 
-	if (ioctl(fd, KDFONTOP, &cfo)) {
+	if (console_ioctl(ctx, fd, KDFONTOP, (unsigned long)&cfo)) {
 		KFONT_ERR(ctx, "ioctl(KD_FONT_OP_SET_DEFAULT): %m");
 		return -1;
 	}
@@ -102,7 +101,7 @@ get_font_kdfontop(struct kfont_context *ctx, int consolefd,
 	 */
 	while (1) {
 		errno = 0;
-		if (ioctl(consolefd, KDFONTOP, &cfo)) {
+		if (console_ioctl(ctx, consolefd, KDFONTOP, (unsigned long)&cfo)) {
 #ifdef KD_FONT_OP_GET_TALL
 			if (errno == ENOSPC && cfo.op != KD_FONT_OP_GET_TALL) {
 				/*
@@ -128,7 +127,7 @@ get_font_kdfontop(struct kfont_context *ctx, int consolefd,
 		cfo.charcount = *count;
 
 		errno = 0;
-		if (ioctl(consolefd, KDFONTOP, &cfo)) {
+		if (console_ioctl(ctx, consolefd, KDFONTOP, (unsigned long)&cfo)) {
 			if (errno != ENOSYS && errno != EINVAL) {
 				KFONT_ERR(ctx, "ioctl(KDFONTOP): %m");
 			}
@@ -206,7 +205,7 @@ put_font_kdfontop(struct kfont_context *ctx, int consolefd, unsigned char *buf,
 
 	errno = 0;
 
-	if (!ioctl(consolefd, KDFONTOP, &cfo))
+	if (!console_ioctl(ctx, consolefd, KDFONTOP, (unsigned long)&cfo))
 		return 0;
 
 	if (errno == ENOSYS) {
@@ -233,7 +232,7 @@ put_font_kdfontop(struct kfont_context *ctx, int consolefd, unsigned char *buf,
 
 		errno = 0;
 
-		ret = ioctl(consolefd, KDFONTOP, &cfo);
+		ret = console_ioctl(ctx, consolefd, KDFONTOP, (unsigned long)&cfo);
 		free(mybuf);
 	}
 
@@ -14,6 +14,9 @@ struct kfont_context {
 
 	unsigned int options;
 
+	const struct kfont_console_ops *console_ops;
+	void *console_data;
+
 	const char *const *mapdirpath;
 	const char *const *mapsuffixes;
 
@@ -39,6 +42,12 @@ void logger(struct kfont_context *ctx, int priority, const char *file,
 #define KFONT_WARN(ctx, arg...) logger(ctx, LOG_WARNING, __FILE__, __LINE__, __func__, ##arg)
 #define KFONT_ERR(ctx,  arg...) logger(ctx, LOG_ERR,     __FILE__, __LINE__, __func__, ##arg)
 
+static inline int
+console_ioctl(struct kfont_context *ctx, int fd, unsigned long request, unsigned long arg)
+{
+	return ctx->console_ops->ioctl(ctx->console_data, fd, request, arg);
+}
+
 void log_stderr(struct kfont_context *ctx, int priority, const char *file,
 		const int line, const char *fn, const char *format, va_list args)
 	KBD_ATTR_PRINTF(6, 0)
@@ -62,8 +71,6 @@ int addpair(struct unicode_list *up, unicode uc);
 int addseq(struct unicode_list *up, unicode uc);
 void clear_uni_entry(struct unicode_list *up);
 
-/* loadunimap.c */
-
 int appendunicodemap(struct kfont_context *ctx, int fd, FILE *fp,
 		unsigned int ct, int utf8)
 	KBD_ATTR_NONNULL(1);
@@ -13,8 +13,10 @@
 #include <sysexits.h>
 #include <string.h>
 #include <ctype.h>
+#include <limits.h>
 #include <unistd.h>
 #include <fcntl.h>
+#include <endian.h>
 #include <sys/ioctl.h>
 #include <linux/kd.h>
 
@@ -24,38 +26,84 @@
 #include "kfontP.h"
 #include "utf8.h"
 
-static int
-str_to_ushort(struct kfont_context *ctx,
-		const char *p, char **e, int base,
-		unsigned short *res)
+/*
+ * The whole unimap is read into one contiguous buffer and tokenized in
+ * place. Numbers are scanned by hand: unimaps are mostly long lists of
+ * U+XXXX tokens and going through strtol() for each of them dominates
+ * the load time of large (CJK oriented) tables.
+ */
+
+static inline int
+hexdigit(unsigned char c)
 {
-	long int v;
+	if (c >= '0' && c <= '9')
+		return c - '0';
+	c |= 0x20;
+	if (c >= 'a' && c <= 'f')
+		return c - 'a' + 10;
+	return -1;
+}
 
-	errno = 0;
-	v = strtol(p, e, base);
+static inline const char *
+skipblanks(const char *p)
+{
+	while (*p == ' ' || *p == '\t')
+		p++;
+	return p;
+}
 
-	if (e && p == *e) {
+/*
+ * Read a font position in C notation (decimal, 0octal or 0xhex).
+ * Return first non-read position in *e.
+ */
+static int
+getfontpos(struct kfont_context *ctx, const char *p, const char **e,
+		unsigned short *res)
+{
+	const char *s = p;
+	unsigned int v = 0;
+	int d, neg = 0;
+
+	/* Same leading syntax as strtol(): white space and an optional sign. */
+	while (*s == ' ' || (*s >= '\t' && *s <= '\r'))
+		s++;
+	if (*s == '+' || *s == '-')
+		neg = (*s++ == '-');
+
+	if (*s == '0' && (s[1] | 0x20) == 'x' && hexdigit((unsigned char) s[2]) >= 0) {
+		for (s += 2; (d = hexdigit((unsigned char) *s)) >= 0; s++) {
+			v = (v << 4) | (unsigned int) d;
+			if (v > USHRT_MAX)
+				goto toobig;
+		}
+	} else if (*s == '0') {
+		for (s++; *s >= '0' && *s <= '7'; s++) {
+			v = (v << 3) | (unsigned int) (*s - '0');
+			if (v > USHRT_MAX)
+				goto toobig;
+		}
+	} else if (*s >= '1' && *s <= '9') {
+		for (; *s >= '0' && *s <= '9'; s++) {
+			v = v * 10 + (unsigned int) (*s - '0');
+			if (v > USHRT_MAX)
+				goto toobig;
+		}
+	} else {
 		KFONT_ERR(ctx, "Unable to parse number: %s", p);
 		return -EX_DATAERR;
 	}
 
-	if (errno == ERANGE) {
-		KFONT_ERR(ctx, "Numerical result out of range: %s", p);
-		return -EX_DATAERR;
-	}
-
-	if (v < 0) {
-		KFONT_ERR(ctx, "Number must not be negative: %ld", v);
-		return -EX_DATAERR;
-	}
-
-	if (v > USHRT_MAX) {
-		KFONT_ERR(ctx, "Number too big: %ld", v);
+	if (neg && v) {
+		KFONT_ERR(ctx, "Number must not be negative: %s", p);
 		return -EX_DATAERR;
 	}
 
+	*e   = s;
 	*res = (unsigned short) v;
 	return 0;
+toobig:
+	KFONT_ERR(ctx, "Number too big: %s", p);
+	return -EX_DATAERR;
 }
 
 /*
@@ -63,60 +111,75 @@ str_to_ushort(struct kfont_context *ctx,
  * Return first non-read position in *p0 (unchanged on error).
  */
 static int
-getunicode(struct kfont_context *ctx, char **p0, unsigned short *res)
+getunicode(const char **p0, unsigned short *res)
 {
-	char *p = *p0;
+	const unsigned char *p = (const unsigned char *) skipblanks(*p0);
+	int d0, d1, d2, d3;
 
-	while (*p == ' ' || *p == '\t')
-		p++;
-#if 0
-	/* The code below also allows one to accept 'utf8' */
-	if (*p == '\'') {
-		int err;
-		unsigned long u;
-		char *p1 = p+1;
-
-		/*
-		 * Read a single complete utf-8 character, and
-		 * expect it to be closed by a single quote.
-		 */
-		u = from_utf8(&p1, 0, &err);
-		if (err || *p1 != '\'')
-			return -1;
-		*p0 = p1+1;
-		return u;
-	}
-#endif
-	if (*p != 'U' || p[1] != '+' || !isxdigit(p[2]) || !isxdigit(p[3]) ||
-	    !isxdigit(p[4]) || !isxdigit(p[5]) || isxdigit(p[6]))
+	if (p[0] != 'U' || p[1] != '+' ||
+	    (d0 = hexdigit(p[2])) < 0 || (d1 = hexdigit(p[3])) < 0 ||
+	    (d2 = hexdigit(p[4])) < 0 || (d3 = hexdigit(p[5])) < 0 ||
+	    hexdigit(p[6]) >= 0)
 		return -1;
-	*p0 = p + 6;
 
-	return str_to_ushort(ctx, p + 2, NULL, 16, res);
+	*p0  = (const char *) p + 6;
+	*res = (unsigned short) ((d0 << 12) | (d1 << 8) | (d2 << 4) | d3);
+
+	return 0;
 }
 
+struct unipair_list {
+	struct unipair *entries;
+	unsigned int count;
+	unsigned int size;
+};
+
+/*
+ * Make room for N more entries. The list grows geometrically, so that
+ * ranges and long lines cost one check instead of one per entry.
+ */
 static int
-add_unipair(struct kfont_context *ctx,
-		unsigned short fp, unsigned short un,
-		struct unipair **list, unsigned int *listsz,
-		unsigned short *listct)
+reserve_unipairs(struct kfont_context *ctx, struct unipair_list *list,
+		unsigned int n)
 {
-	if (*listct == *listsz) {
-		*listsz += 4096;
-		*list = realloc(*list, *listsz);
-		if (!*list) {
-			KFONT_ERR(ctx, "realloc: %m");
-			return -EX_OSERR;
-		}
+	struct unipair *p;
+	unsigned int size;
+
+	if (list->count + n <= list->size)
+		return 0;
+
+	if (list->count + n > USHRT_MAX) {
+		KFONT_ERR(ctx, _("Too many entries in unicode map (limit is %d)"),
+		          USHRT_MAX);
+		return -EX_DATAERR;
 	}
 
-	(*list)[*listct].fontpos = fp;
-	(*list)[*listct].unicode = un;
-	(*listct)++;
+	size = list->size ? list->size : 256;
+	while (size < list->count + n)
+		size *= 2;
+	if (size > USHRT_MAX)
+		size = USHRT_MAX;
+
+	p = realloc(list->entries, size * sizeof(*p));
+	if (!p) {
+		KFONT_ERR(ctx, "realloc: %m");
+		return -EX_OSERR;
+	}
+
+	list->entries = p;
+	list->size    = size;
 
 	return 0;
 }
 
+static inline void
+put_unipair(struct unipair_list *list, unsigned short fp, unsigned short un)
+{
+	list->entries[list->count].fontpos = fp;
+	list->entries[list->count].unicode = un;
+	list->count++;
+}
+
 /*
  * Syntax accepted:
  *	<fontpos>	<unicode> <unicode> ...
@@ -130,36 +193,26 @@ add_unipair(struct kfont_context *ctx,
  */
 
 static int
-parseline(struct kfont_context *ctx, char *buffer, const char *tblname,
-		struct unipair **list, unsigned int *listsz,
-		unsigned short *listct)
+parseline(struct kfont_context *ctx, const char *p, const char *tblname,
+		struct unipair_list *list)
 {
 	int fontlen = 512;
 	int ret;
 	unsigned short i, fp0, fp1, un0, un1;
-	char *p, *p1;
-
-	p = buffer;
 
-	while (*p == ' ' || *p == '\t')
-		p++;
+	p = skipblanks(p);
 	if (!*p || *p == '#')
 		return 0; /* skip comment or blank line */
 
-	ret = str_to_ushort(ctx, p, &p1, 0, &fp0);
-	if (ret < 0)
+	if ((ret = getfontpos(ctx, p, &p, &fp0)) < 0)
 		return ret;
-	p = p1;
 
-	while (*p == ' ' || *p == '\t')
-		p++;
+	p = skipblanks(p);
 	if (*p == '-') {
-		p++;
+		p = skipblanks(p + 1);
 
-		ret = str_to_ushort(ctx, p, &p1, 0, &fp1);
-		if (ret < 0)
+		if ((ret = getfontpos(ctx, p, &p, &fp1)) < 0)
 			return ret;
-		p = p1;
 	} else
 		fp1 = 0;
 
@@ -178,34 +231,36 @@ parseline(struct kfont_context *ctx, char *buffer, const char *tblname,
 	if (fp1) {
 		/* we have a range; expect the word "idem" or a Unicode range
 		   of the same length or a single Unicode value */
-		while (*p == ' ' || *p == '\t')
-			p++;
+		p = skipblanks(p);
+
+		if ((ret = reserve_unipairs(ctx, list, (unsigned int) (fp1 - fp0 + 1))) < 0)
+			return ret;
+
 		if (!strncmp(p, "idem", 4)) {
 			p += 4;
-			for (i = fp0; i <= fp1; i++) {
-				if ((ret = add_unipair(ctx, i, i, list, listsz, listct)) < 0)
-					return ret;
-			}
+			for (i = fp0; i <= fp1; i++)
+				put_unipair(list, i, i);
 			goto lookattail;
 		}
 
-		if ((ret = getunicode(ctx, &p, &un0)) < 0)
-			return ret;
+		if (getunicode(&p, &un0) < 0) {
+			KFONT_ERR(ctx, _("%s: Bad unicode value (%s)"), tblname, p);
+			return -EX_DATAERR;
+		}
 
-		while (*p == ' ' || *p == '\t')
-			p++;
+		p = skipblanks(p);
 		if (*p != '-') {
-			for (i = fp0; i <= fp1; i++) {
-				if ((ret = add_unipair(ctx, i, un0, list, listsz, listct)) < 0)
-					return ret;
-			}
+			for (i = fp0; i <= fp1; i++)
+				put_unipair(list, i, un0);
 			goto lookattail;
 		}
 
 		p++;
 
-		if ((ret = getunicode(ctx, &p, &un1)) < 0)
-			return ret;
+		if (getunicode(&p, &un1) < 0) {
+			KFONT_ERR(ctx, _("%s: Bad unicode value (%s)"), tblname, p);
+			return -EX_DATAERR;
+		}
 
 		if (un1 - un0 != fp1 - fp0) {
 			KFONT_ERR(ctx,
@@ -215,40 +270,145 @@ parseline(struct kfont_context *ctx, char *buffer, const char *tblname,
 			return -EX_DATAERR;
 		}
 
-		for (i = fp0; i <= fp1; i++) {
-			unsigned short un = un0 - fp0;
-			if ((ret = add_unipair(ctx, i, un + i, list, listsz, listct)) < 0)
-				return ret;
-		}
+		for (i = fp0; i <= fp1; i++)
+			put_unipair(list, i, (unsigned short) (un0 - fp0 + i));
 
 	} else {
 		/* no range; expect a list of unicode values
 		   for a single font position */
 
-		while (!getunicode(ctx, &p, &un0)) {
-			if ((ret = add_unipair(ctx, fp0, un0, list, listsz, listct)) < 0)
+		while (!getunicode(&p, &un0)) {
+			if ((ret = reserve_unipairs(ctx, list, 1)) < 0)
 				return ret;
+			put_unipair(list, fp0, un0);
 		}
 	}
 lookattail:
-	while (*p == ' ' || *p == '\t')
-		p++;
+	p = skipblanks(p);
 	if (*p && *p != '#')
 		KFONT_ERR(ctx, _("%s: trailing junk (%s) ignored"), tblname, p);
 
 	return 0;
 }
 
+/*
+ * Read the whole file into a NUL-terminated buffer.
+ */
+static int
+read_unimapfile(struct kfont_context *ctx, FILE *f, char **bufp, size_t *lenp)
+{
+	char *buf = NULL, *p;
+	size_t size = 0, n = 0;
+
+	do {
+		if (size - n < 2) {
+			size = size ? size * 2 : 65536;
+
+			p = realloc(buf, size);
+			if (!p) {
+				KFONT_ERR(ctx, "realloc: %m");
+				free(buf);
+				return -EX_OSERR;
+			}
+			buf = p;
+		}
+
+		n += fread(buf + n, 1, size - n - 1, f);
+
+		if (ferror(f)) {
+			KFONT_ERR(ctx, _("Error reading unicode map: %m"));
+			free(buf);
+			return -EX_IOERR;
+		}
+	} while (!feof(f));
+
+	buf[n] = '\0';
+
+	*bufp = buf;
+	*lenp = n;
+
+	return 0;
+}
+
+static int
+parse_unimap(struct kfont_context *ctx, char *buf, size_t len,
+		const char *tblname, struct unipair_list *list)
+{
+	char *p = buf, *end = buf + len, *eol;
+	int ret;
+
+	while (p < end) {
+		eol = memchr(p, '\n', (size_t) (end - p));
+		if (!eol)
+			eol = end;
+		*eol = '\0';
+
+		if ((ret = parseline(ctx, p, tblname, list)) < 0)
+			return ret;
+
+		p = eol + 1;
+	}
+
+	return 0;
+}
+
+/*
+ * Use the entries of a binary unimap in place.
+ */
+static int
+get_binary_unimap(struct kfont_context *ctx, char *buf, size_t len,
+		const char *tblname, struct unimapdesc *descr)
+{
+	struct unib_header hdr;
+	struct unipair *up;
+	unsigned int i, version, headersize, length;
+
+	memcpy(&hdr, buf, sizeof(hdr));
+
+	version    = le32toh(hdr.version);
+	headersize = le32toh(hdr.headersize);
+	length     = le32toh(hdr.length);
+
+	if (version > UNIB_MAXVERSION) {
+		KFONT_ERR(ctx, _("%s: Unsupported binary unimap version (%d)"),
+		          tblname, version);
+		return -EX_DATAERR;
+	}
+
+	if (headersize < sizeof(hdr) || headersize % 2 || headersize > len ||
+	    length > USHRT_MAX ||
+	    (len - headersize) / sizeof(struct unipair) < length) {
+		KFONT_ERR(ctx, _("%s: Bad binary unimap header"), tblname);
+		return -EX_DATAERR;
+	}
+
+	up = (struct unipair *) (buf + headersize);
+
+#if __BYTE_ORDER == __BIG_ENDIAN
+	for (i = 0; i < length; i++) {
+		up[i].unicode = le16toh(up[i].unicode);
+		up[i].fontpos = le16toh(up[i].fontpos);
+	}
+#else
+	(void) i;
+#endif
+
+	descr->entry_ct = (unsigned short) length;
+	descr->entries  = up;
+
+	return 0;
+}
+
 int
-kfont_load_unicodemap(struct kfont_context *ctx, int fd, const char *tblname)
+kfont_load_unicodemap_multi(struct kfont_context *ctx, const int *fds, unsigned int nfds,
+		const char *tblname)
 {
-	char buffer[65536];
-	char *p;
 	struct kbdfile *fp;
 	struct unimapdesc descr;
-	struct unipair *list = NULL;
-	unsigned int listsz  = 0;
-	unsigned short listct  = 0;
+	struct unipair_list list = { 0 };
+	char *buf = NULL;
+	size_t len = 0;
+	unsigned int n;
 
 	int ret = 0;
 
@@ -265,34 +425,44 @@ kfont_load_unicodemap(struct kfont_context *ctx, int fd, const char *tblname)
 
 	KFONT_INFO(ctx, _("Loading unicode map from file %s"), kbdfile_get_pathname(fp));
 
-	while (fgets(buffer, sizeof(buffer), kbdfile_get_file(fp)) != NULL) {
-		if ((p = strchr(buffer, '\n')) != NULL)
-			*p = '\0';
-		else
-			KFONT_WARN(ctx, _("%s: Warning: line too long"), tblname);
+	if ((ret = read_unimapfile(ctx, kbdfile_get_file(fp), &buf, &len)) < 0)
+		goto err;
 
-		if ((ret = parseline(ctx, buffer, tblname, &list, &listsz, &listct)) < 0)
+	if (len >= sizeof(struct unib_header) && UNIB_MAGIC_OK((unsigned char *) buf)) {
+		if ((ret = get_binary_unimap(ctx, buf, len, tblname, &descr)) < 0)
 			goto err;
+	} else {
+		if ((ret = parse_unimap(ctx, buf, len, tblname, &list)) < 0)
+			goto err;
+
+		descr.entry_ct = (unsigned short) list.count;
+		descr.entries  = list.entries;
 	}
 
-	if (listct == 0 && !(ctx->options & (1 << kfont_force))) {
+	if (descr.entry_ct == 0 && !(ctx->options & (1 << kfont_force))) {
 		KFONT_ERR(ctx,
 		        _("not loading empty unimap\n"
 		          "(if you insist: use option -f to override)"));
 	} else {
-		descr.entry_ct = listct;
-		descr.entries  = list;
-		if ((ret = kfont_put_unicodemap(ctx, fd, NULL, &descr)) < 0)
-			goto err;
-		listct = 0;
+		for (n = 0; n < nfds; n++) {
+			if ((ret = kfont_put_unicodemap(ctx, fds[n], NULL, &descr)) < 0)
+				goto err;
+		}
 	}
 err:
 	kbdfile_free(fp);
-	free(list);
+	free(buf);
+	free(list.entries);
 
 	return ret;
 }
 
+int
+kfont_load_unicodemap(struct kfont_context *ctx, int fd, const char *tblname)
+{
+	return kfont_load_unicodemap_multi(ctx, &fd, 1, tblname);
+}
+
 static int
 getunicodemap(struct kfont_context *ctx, int fd, struct unimapdesc *unimap_descr)
 {
@@ -304,6 +474,69 @@ getunicodemap(struct kfont_context *ctx, int fd, struct unimapdesc *unimap_descr
 	return 0;
 }
 
+static int
+unipair_compar(const void *p1, const void *p2)
+{
+	const struct unipair *u1 = p1;
+	const struct unipair *u2 = p2;
+
+	if (u1->fontpos != u2->fontpos)
+		return (int) u1->fontpos - (int) u2->fontpos;
+	return (int) u1->unicode - (int) u2->unicode;
+}
+
+int
+kfont_write_binary_unicodemap(struct kfont_context *ctx, FILE *fp,
+		struct unimapdesc *ud)
+{
+	struct unib_header hdr;
+	struct unipair *up;
+	unsigned int i;
+
+	qsort(ud->entries, ud->entry_ct, sizeof(struct unipair), unipair_compar);
+
+	hdr.magic[0]   = UNIB_MAGIC0;
+	hdr.magic[1]   = UNIB_MAGIC1;
+	hdr.magic[2]   = UNIB_MAGIC2;
+	hdr.magic[3]   = UNIB_MAGIC3;
+	hdr.version    = htole32(0);
+	hdr.headersize = htole32(sizeof(hdr));
+	hdr.length     = htole32(ud->entry_ct);
+
+	if (fwrite(&hdr, sizeof(hdr), 1, fp) != 1)
+		goto fail;
+
+	up = ud->entries;
+
+#if __BYTE_ORDER == __BIG_ENDIAN
+	for (i = 0; i < ud->entry_ct; i++) {
+		struct unipair le;
+
+		le.unicode = htole16(up[i].unicode);
+		le.fontpos = htole16(up[i].fontpos);
+
+		if (fwrite(&le, sizeof(le), 1, fp) != 1)
+			goto fail;
+	}
+#else
+	(void) i;
+	if (ud->entry_ct && fwrite(up, sizeof(*up), ud->entry_ct, fp) != ud->entry_ct)
+		goto fail;
+#endif
+	return 0;
+fail:
+	KFONT_ERR(ctx, _("Cannot write unicode map: %m"));
+	return -EX_IOERR;
+}
+
+static int
+has_suffix(const char *s, const char *suffix)
+{
+	size_t len = strlen(s), slen = strlen(suffix);
+
+	return (len >= slen && !strcmp(s + len - slen, suffix));
+}
+
 int
 kfont_save_unicodemap(struct kfont_context *ctx, int consolefd,
 		const char *filename)
@@ -323,11 +556,17 @@ kfont_save_unicodemap(struct kfont_context *ctx, int consolefd,
 
 	unilist = unimap_descr.entries;
 
-	for (i = 0; i < unimap_descr.entry_ct; i++)
-		fprintf(fpo, "0x%02x\tU+%04x\n", unilist[i].fontpos, unilist[i].unicode);
+	if (has_suffix(filename, ".unib")) {
+		if ((ret = kfont_write_binary_unicodemap(ctx, fpo, &unimap_descr)) < 0)
+			goto end;
+	} else {
+		for (i = 0; i < unimap_descr.entry_ct; i++)
+			fprintf(fpo, "0x%02x\tU+%04x\n", unilist[i].fontpos, unilist[i].unicode);
+	}
 
 	KFONT_INFO(ctx, _("Saved unicode map on `%s'"), filename);
 end:
+	free(unimap_descr.entries);
 	fclose(fpo);
 	return ret;
 }
@@ -147,12 +147,14 @@ end:
 }
 
 int
-kfont_load_consolemap(struct kfont_context *ctx, int fd, const char *mfil)
+kfont_load_consolemap_multi(struct kfont_context *ctx, const int *fds, unsigned int nfds,
+		const char *mfil)
 {
 	unsigned short ubuf[E_TABSZ];
 	unsigned char buf[E_TABSZ];
 	unsigned char i = 0;
-	int u = 0;
+	unsigned int n;
+	int u = 0, ret = 0;
 
 	/* default: trivial straight-to-font */
 	do {
@@ -164,17 +166,27 @@ kfont_load_consolemap(struct kfont_context *ctx, int fd, const char *mfil)
 	if (mfil)
 		u = readnewmapfromfile(ctx, mfil, buf, ubuf);
 
-	switch (u) {
-		case 1: /* yes */
+	if (u < 0)
+		return u;
+
+	for (n = 0; n < nfds; n++) {
+		if (u)
 			/* do we need to use loaduniscrnmap() ? */
-			u = kfont_put_uniscrnmap(ctx, fd, ubuf);
-			break;
-		case 0: /* no */
-			u = loadscrnmap(ctx, fd, buf);
+			ret = kfont_put_uniscrnmap(ctx, fds[n], ubuf);
+		else
+			ret = loadscrnmap(ctx, fds[n], buf);
+
+		if (ret < 0)
 			break;
 	}
 
-	return u;
+	return ret;
+}
+
+int
+kfont_load_consolemap(struct kfont_context *ctx, int fd, const char *mfil)
+{
+	return kfont_load_consolemap_multi(ctx, &fd, 1, mfil);
 }
 
 /*
@@ -18,6 +18,7 @@
 #include <linux/kd.h>
 #include <endian.h>
 #include <sysexits.h>
+#include <stdint.h>
 
 #include <kbdfile.h>
 
@@ -44,13 +45,14 @@ findpartialfont(struct kfont_context *ctx, const char *fnam, struct kbdfile *fp)
 static int erase_mode = 1;
 
 static int
-try_loadfont(struct kfont_context *ctx, int fd, const unsigned char *inbuf,
+try_loadfont(struct kfont_context *ctx, const int *fds, unsigned int nfds,
+		const unsigned char *inbuf,
 		unsigned int width, unsigned int height, unsigned int vpitch,
 		unsigned int hwunit,
 		unsigned int fontsize, const char *filename)
 {
 	unsigned char *buf = NULL;
-	unsigned int i, buflen, kcharsize;
+	unsigned int i, n, buflen, kcharsize;
 	int bad_video_erase_char = 0;
 	int ret;
 
@@ -172,9 +174,11 @@ try_loadfont(struct kfont_context *ctx, int fd, const unsigned char *inbuf,
 		KFONT_INFO(ctx, _("Loading %d-char %dx%d (%d) font"),
 		       fontsize, width, height, hwunit);
 
-	if (kfont_put_font(ctx, fd, buf, fontsize, width, hwunit, vpitch) < 0) {
-		ret = -EX_OSERR;
-		goto err;
+	for (n = 0; n < nfds; n++) {
+		if (kfont_put_font(ctx, fds[n], buf, fontsize, width, hwunit, vpitch) < 0) {
+			ret = -EX_OSERR;
+			goto err;
+		}
 	}
 
 	ret = 0;
@@ -184,24 +188,25 @@ err:
 }
 
 static int
-do_loadfont(struct kfont_context *ctx, int fd, const unsigned char *inbuf,
+do_loadfont(struct kfont_context *ctx, const int *fds, unsigned int nfds,
+		const unsigned char *inbuf,
 		unsigned int width, unsigned int height, unsigned int hwunit,
 		unsigned int fontsize, const char *filename)
 {
 	if (height <= 32 && width <= 32)
 		/* This can work with pre-6.2 kernels and its size and vpitch limitations */
-		return try_loadfont(ctx, fd, inbuf, width, height, 32, hwunit, fontsize, filename);
+		return try_loadfont(ctx, fds, nfds, inbuf, width, height, 32, hwunit, fontsize, filename);
 	else
-		return try_loadfont(ctx, fd, inbuf, width, height, height, hwunit, fontsize, filename);
+		return try_loadfont(ctx, fds, nfds, inbuf, width, height, height, hwunit, fontsize, filename);
 }
 
 static int
-do_loadtable(struct kfont_context *ctx, int fd, struct unicode_list *uclistheads,
-		unsigned int fontsize)
+do_loadtable(struct kfont_context *ctx, const int *fds, unsigned int nfds,
+		struct unicode_list *uclistheads, unsigned int fontsize)
 {
 	struct unimapdesc ud;
 	struct unipair *up = NULL;
-	unsigned int i, ct = 0, maxct;
+	unsigned int i, n, ct = 0, maxct;
 	struct unicode_list *ul;
 	struct unicode_seq *us;
 	int ret;
@@ -262,9 +267,11 @@ do_loadtable(struct kfont_context *ctx, int fd, struct unicode_list *uclistheads
 	ud.entry_ct = (unsigned short) ct;
 	ud.entries  = up;
 
-	if (kfont_put_unicodemap(ctx, fd, NULL, &ud) < 0) {
-		ret = -EX_OSERR;
-		goto err;
+	for (n = 0; n < nfds; n++) {
+		if (kfont_put_unicodemap(ctx, fds[n], NULL, &ud) < 0) {
+			ret = -EX_OSERR;
+			goto err;
+		}
 	}
 
 	ret = 0;
@@ -273,15 +280,139 @@ err:
 	return ret;
 }
 
-int
-kfont_load_fonts(struct kfont_context *ctx,
-		int fd, const char *const *ifiles, int ifilct,
+/*
+ * Move the Unicode list of font position SRC to DST (which is empty).
+ * The first entry of a list points back to its head, so this can't be
+ * done with a plain structure copy.
+ */
+static void
+move_uni_entry(struct unicode_list *dst, struct unicode_list *src)
+{
+	if (!src->next) {
+		clear_uni_entry(dst);
+		return;
+	}
+
+	dst->seq  = src->seq;
+	dst->next = src->next;
+	dst->prev = src->prev;
+
+	dst->next->prev = dst;
+
+	clear_uni_entry(src);
+}
+
+/*
+ * Append the Unicode list of font position SRC to the one of DST.
+ */
+static void
+splice_uni_entry(struct unicode_list *dst, struct unicode_list *src)
+{
+	if (!src->next)
+		return;
+
+	dst->prev->next = src->next;
+	src->next->prev = dst->prev;
+	dst->prev       = src->prev;
+
+	clear_uni_entry(src);
+}
+
+static uint64_t
+glyph_hash(const unsigned char *glyph, unsigned int charsize)
+{
+	uint64_t h = 0xcbf29ce484222325ULL; /* FNV-1a */
+	unsigned int i;
+
+	for (i = 0; i < charsize; i++) {
+		h ^= glyph[i];
+		h *= 0x100000001b3ULL;
+	}
+	return h;
+}
+
+/*
+ * Merge planner for several fonts: a glyph that is identical to one
+ * seen before is dropped, and its Unicode values are moved to the
+ * glyph that is kept. The first FIXED positions (the glyphs of the first
+ * font) are never moved, so position 32 stays where the kernel expects
+ * it. The font and the Unicode table are compacted in place.
+ *
+ * Returns the new number of glyphs.
+ */
+static int
+merge_glyphs(struct kfont_context *ctx, unsigned char *fontbuf,
+		unsigned int charsize, unsigned int fontsize, unsigned int fixed,
+		struct unicode_list *uclistheads, unsigned int *newsize)
+{
+	unsigned int *slots;
+	unsigned int i, j, mask, out, nslots;
+	unsigned char *glyph;
+
+	for (nslots = 64; nslots < 2 * fontsize; nslots *= 2);
+	mask = nslots - 1;
+
+	slots = calloc(nslots, sizeof(*slots));
+	if (!slots) {
+		KFONT_ERR(ctx, "calloc: %m");
+		return -EX_OSERR;
+	}
+
+	for (i = 0, out = 0; i < fontsize; i++) {
+		glyph = fontbuf + i * charsize;
+		j = (unsigned int) glyph_hash(glyph, charsize) & mask;
+
+		/* slots hold new position + 1 of the glyphs kept so far */
+		for (; slots[j]; j = (j + 1) & mask) {
+			if (!memcmp(fontbuf + (slots[j] - 1) * charsize, glyph, charsize))
+				break;
+		}
+
+		if (slots[j] && i >= fixed) {
+			splice_uni_entry(&uclistheads[slots[j] - 1], &uclistheads[i]);
+			continue;
+		}
+
+		if (out != i) {
+			memcpy(fontbuf + out * charsize, glyph, charsize);
+			move_uni_entry(&uclistheads[out], &uclistheads[i]);
+		}
+
+		if (!slots[j])
+			slots[j] = out + 1;
+
+		out++;
+	}
+
+	if (out < fontsize)
+		KFONT_INFO(ctx, _("Merged %u duplicate glyphs: %u of %u font positions used"),
+		           fontsize - out, out, fontsize);
+
+	free(slots);
+
+	*newsize = out;
+	return 0;
+}
+
+static int
+load_font(struct kfont_context *ctx, const int *fds, unsigned int nfds,
+		const char *ifil,
+		unsigned int iunit, unsigned int hwunit, int no_m, int no_u);
+
+/*
+ * The fonts are read and laid out once and then loaded into each of the
+ * NFDS consoles. Loading stops at the first console that fails.
+ */
+static int
+load_fonts(struct kfont_context *ctx, const int *fds, unsigned int nfds,
+		const char *const *ifiles, int ifilct,
 		unsigned int iunit, unsigned int hwunit, int no_m, int no_u)
 {
 	const char *ifil;
 	unsigned char *inbuf, *fontbuf, *bigfontbuf;
 	unsigned int inputlth, fontbuflth, fontsize, height, width;
 	unsigned int bigfontbuflth, bigfontsize, bigheight, bigwidth;
+	unsigned int firstfontsize = 0;
 	unsigned char *ptr;
 	struct unicode_list *uclistheads;
 	struct kbdfile *fp = NULL;
@@ -289,10 +420,11 @@ kfont_load_fonts(struct kfont_context *ctx,
 	int ret = 0;
 
 	if (ifilct == 1)
-		return kfont_load_font(ctx, fd, ifiles[0], iunit, hwunit, no_m, no_u);
+		return load_font(ctx, fds, nfds, ifiles[0], iunit, hwunit, no_m, no_u);
 
 	/* several fonts that must be merged */
 	/* We just concatenate the bitmaps - only allow psf fonts */
+	inbuf         = NULL;
 	bigfontbuf    = NULL;
 	bigfontbuflth = 0;
 	bigfontsize   = 0;
@@ -357,6 +489,9 @@ kfont_load_fonts(struct kfont_context *ctx,
 			goto end;
 		}
 
+		if (!firstfontsize)
+			firstfontsize = fontsize;
+
 		bigfontsize += fontsize;
 		bigfontbuflth += fontbuflth;
 
@@ -370,15 +505,29 @@ kfont_load_fonts(struct kfont_context *ctx,
 		ptr = NULL;
 
 		memcpy(bigfontbuf + bigfontbuflth - fontbuflth, fontbuf, fontbuflth);
+		free(inbuf);
+		inbuf = NULL;
+	}
+
+	/*
+	 * With a Unicode table the position of a glyph doesn't matter, so
+	 * identical glyphs from different fonts can share one position.
+	 */
+	if (uclistheads && !no_u) {
+		ret = merge_glyphs(ctx, bigfontbuf, bigfontbuflth / bigfontsize,
+				bigfontsize, firstfontsize, uclistheads, &bigfontsize);
+		if (ret < 0)
+			goto end;
 	}
 
-	ret = do_loadfont(ctx, fd, bigfontbuf, bigwidth, bigheight, hwunit,
+	ret = do_loadfont(ctx, fds, nfds, bigfontbuf, bigwidth, bigheight, hwunit,
 		bigfontsize, NULL);
 
 	if (!ret && uclistheads && !no_u)
-		ret = do_loadtable(ctx, fd, uclistheads, bigfontsize);
+		ret = do_loadtable(ctx, fds, nfds, uclistheads, bigfontsize);
 
 end:
+	free(inbuf);
 	free(bigfontbuf);
 	free(ptr);
 
@@ -387,8 +536,9 @@ end:
 	return ret;
 }
 
-int
-kfont_load_font(struct kfont_context *ctx, int fd, const char *ifil,
+static int
+load_font(struct kfont_context *ctx, const int *fds, unsigned int nfds,
+		const char *ifil,
 		unsigned int iunit, unsigned int hwunit, int no_m, int no_u)
 {
 	struct kbdfile *fp;
@@ -459,19 +609,19 @@ kfont_load_font(struct kfont_context *ctx, int fd, const char *ifil,
 			height    = fontbuflth / (bytewidth * fontsize);
 		}
 
-		ret = do_loadfont(ctx, fd, fontbuf, width, height, hwunit,
+		ret = do_loadfont(ctx, fds, nfds, fontbuf, width, height, hwunit,
 			fontsize, kbdfile_get_pathname(fp));
 		if (ret < 0)
 			goto end;
 
 		if (uclistheads && !no_u) {
-			ret = do_loadtable(ctx, fd, uclistheads, fontsize);
+			ret = do_loadtable(ctx, fds, nfds, uclistheads, fontsize);
 			if (ret < 0)
 				goto end;
 		}
 
 		if (!uclistheads && !no_u && def) {
-			if ((ret = kfont_load_unicodemap(ctx, fd, "def.uni")) < 0)
+			if ((ret = kfont_load_unicodemap_multi(ctx, fds, nfds, "def.uni")) < 0)
 				KFONT_ERR(ctx, "Unable to load unicode map");
 		}
 
@@ -509,7 +659,7 @@ kfont_load_font(struct kfont_context *ctx, int fd, const char *ifil,
 			}
 
 			/* recursive call */
-			ret = kfont_load_fonts(ctx, fd, ifiles, ifilct, iunit,
+			ret = load_fonts(ctx, fds, nfds, ifiles, ifilct, iunit,
 				hwunit, no_m, no_u);
 
 			goto end;
@@ -558,13 +708,40 @@ kfont_load_font(struct kfont_context *ctx, int fd, const char *ifil,
 		height   = inputlth / 256;
 	}
 
-	ret = do_loadfont(ctx, fd, inbuf + offset, width, height, hwunit,
+	ret = do_loadfont(ctx, fds, nfds, inbuf + offset, width, height, hwunit,
 		fontsize, kbdfile_get_pathname(fp));
 end:
 	kbdfile_free(fp);
 	return ret;
 }
 
+int
+kfont_load_font(struct kfont_context *ctx, int fd, const char *ifil,
+		unsigned int iunit, unsigned int hwunit, int no_m, int no_u)
+{
+	return load_font(ctx, &fd, 1, ifil, iunit, hwunit, no_m, no_u);
+}
+
+int
+kfont_load_fonts(struct kfont_context *ctx,
+		int fd, const char *const *ifiles, int ifilct,
+		unsigned int iunit, unsigned int hwunit, int no_m, int no_u)
+{
+	return load_fonts(ctx, &fd, 1, ifiles, ifilct, iunit, hwunit, no_m, no_u);
+}
+
+int
+kfont_load_font_multi(struct kfont_context *ctx,
+		const int *fds, unsigned int nfds,
+		const char *const *ifiles, int ifilct,
+		unsigned int iunit, unsigned int hwunit, int no_m, int no_u)
+{
+	if (!nfds)
+		return 0;
+
+	return load_fonts(ctx, fds, nfds, ifiles, ifilct, iunit, hwunit, no_m, no_u);
+}
+
 static unsigned int
 position_codepage(unsigned int iunit)
 {
@@ -0,0 +1,394 @@
+// SPDX-License-Identifier: LGPL-2.0-or-later
+/*
+ * Snapshot of the display state of a console: the font, the Unicode map,
+ * the Unicode screen map and the palette, kept in one binary blob.
+ */
+#include "config.h"
+
+#include <stdio.h>
+#include <errno.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <sysexits.h>
+#include <linux/kd.h>
+
+#include "libcommon.h"
+#include "kfontP.h"
+
+#ifdef COMPAT_HEADERS
+#include "compat/linux-kd.h"
+#endif
+
+/*
+ * The blob is native-endian and only meant to be restored on the machine
+ * that took it:
+ *
+ *   struct snapshot_header
+ *   struct snapshot_font, uint8_t glyphs[size]
+ *   uint32_t entry_ct, struct unipair entries[entry_ct]
+ *   uint16_t uniscrnmap[E_TABSZ]
+ *   uint8_t cmap[3 * 16]
+ *
+ * The glyphs are stored with a pitch of vpitch rows, as the kernel
+ * returns them.
+ */
+#define SNAPSHOT_MAGIC   "kfsnap"
+#define SNAPSHOT_VERSION 1
+
+#define PALETTE_SIZE (3 * 16)
+
+/* The kernel has no fonts with more glyphs. */
+#define SNAPSHOT_FONT_COUNT 512
+#define SNAPSHOT_FONT_SIZE  (SNAPSHOT_FONT_COUNT * 32 * 32 / 8)
+
+/* GIO_UNIMAP counts the entries in an unsigned short. */
+#define SNAPSHOT_UNIMAP_MAX 0xffff
+
+struct snapshot_header {
+	char magic[7];
+	uint8_t version;
+};
+
+struct snapshot_font {
+	uint32_t count;
+	uint32_t width;
+	uint32_t height;
+	uint32_t vpitch;
+	uint32_t size;
+};
+
+struct snapshot_buffer {
+	unsigned char *data;
+	size_t len;
+	size_t size;
+};
+
+struct font_state {
+	struct snapshot_font hdr;
+	unsigned char *glyphs;
+};
+
+static int
+append(struct kfont_context *ctx, struct snapshot_buffer *b, const void *data, size_t len)
+{
+	unsigned char *p;
+	size_t size;
+
+	if (b->len + len > b->size) {
+		size = b->size ? b->size : 4096;
+		while (size < b->len + len)
+			size *= 2;
+
+		if (!(p = realloc(b->data, size))) {
+			KFONT_ERR(ctx, "realloc: %m");
+			return -EX_OSERR;
+		}
+		b->data = p;
+		b->size = size;
+	}
+
+	memcpy(b->data + b->len, data, len);
+	b->len += len;
+
+	return 0;
+}
+
+/*
+ * Reads the font with a single KD_FONT_OP_GET into a buffer big enough for
+ * any font of at most 32x32 pixels. Only a taller font, reported with
+ * ENOSPC, is read again with KD_FONT_OP_GET_TALL.
+ */
+static int
+get_font(struct kfont_context *ctx, int fd, struct font_state *font)
+{
+	struct console_font_op cfo;
+
+	if (!(font->glyphs = malloc(SNAPSHOT_FONT_SIZE))) {
+		KFONT_ERR(ctx, "malloc: %m");
+		return -EX_OSERR;
+	}
+
+	cfo.op        = KD_FONT_OP_GET;
+	cfo.flags     = 0;
+	cfo.width     = 32;
+	cfo.height    = 32;
+	cfo.charcount = SNAPSHOT_FONT_COUNT;
+	cfo.data      = font->glyphs;
+
+	font->hdr.vpitch = 32;
+
+	errno = 0;
+	if (console_ioctl(ctx, fd, KDFONTOP, (unsigned long)&cfo)) {
+#ifdef KD_FONT_OP_GET_TALL
+		if (errno == ENOSPC) {
+			free(font->glyphs);
+			if (!(font->glyphs = malloc(MAXFONTSIZE))) {
+				KFONT_ERR(ctx, "malloc: %m");
+				return -EX_OSERR;
+			}
+
+			cfo.op        = KD_FONT_OP_GET_TALL;
+			cfo.width     = 64;
+			cfo.height    = 128;
+			cfo.charcount = SNAPSHOT_FONT_COUNT;
+			cfo.data      = font->glyphs;
+
+			errno = 0;
+			if (console_ioctl(ctx, fd, KDFONTOP, (unsigned long)&cfo)) {
+				KFONT_ERR(ctx, "ioctl(KD_FONT_OP_GET_TALL): %m");
+				return -EX_OSERR;
+			}
+
+			font->hdr.vpitch = cfo.height;
+		} else
+#endif
+		{
+			KFONT_ERR(ctx, "ioctl(KD_FONT_OP_GET): %m");
+			return -EX_OSERR;
+		}
+	}
+
+	font->hdr.count  = cfo.charcount;
+	font->hdr.width  = cfo.width;
+	font->hdr.height = cfo.height;
+	font->hdr.size   = cfo.charcount * font->hdr.vpitch * ((cfo.width + 7) / 8);
+
+	return 0;
+}
+
+/*
+ * Reads the Unicode map with a single GIO_UNIMAP into a buffer of the
+ * largest size the request can describe.
+ */
+static int
+get_unimap(struct kfont_context *ctx, int fd, struct unimapdesc *ud)
+{
+	ud->entry_ct = SNAPSHOT_UNIMAP_MAX;
+
+	if (!(ud->entries = malloc(SNAPSHOT_UNIMAP_MAX * sizeof(struct unipair)))) {
+		KFONT_ERR(ctx, "malloc: %m");
+		return -EX_OSERR;
+	}
+
+	if (console_ioctl(ctx, fd, GIO_UNIMAP, (unsigned long)ud)) {
+		KFONT_ERR(ctx, "ioctl(GIO_UNIMAP): %m");
+		free(ud->entries);
+		ud->entries = NULL;
+		return -EX_OSERR;
+	}
+
+	return 0;
+}
+
+static int
+get_palette(struct kfont_context *ctx, int fd, unsigned char *cmap)
+{
+	if (console_ioctl(ctx, fd, GIO_CMAP, (unsigned long)cmap)) {
+		KFONT_ERR(ctx, "ioctl(GIO_CMAP): %m");
+		return -EX_OSERR;
+	}
+	return 0;
+}
+
+int
+kfont_snapshot(struct kfont_context *ctx, int consolefd,
+		unsigned char **blob, size_t *size)
+{
+	struct snapshot_buffer b = { NULL, 0, 0 };
+	struct snapshot_header hdr;
+	struct font_state font = { { 0 }, NULL };
+	struct unimapdesc ud = { 0, NULL };
+	unsigned short scrnmap[E_TABSZ];
+	unsigned char cmap[PALETTE_SIZE];
+	uint32_t entry_ct;
+	int ret;
+
+	memset(&hdr, 0, sizeof(hdr));
+	memcpy(hdr.magic, SNAPSHOT_MAGIC, sizeof(hdr.magic));
+	hdr.version = SNAPSHOT_VERSION;
+
+	if ((ret = get_font(ctx, consolefd, &font)) < 0 ||
+	    (ret = get_unimap(ctx, consolefd, &ud)) < 0)
+		goto end;
+
+	if (kfont_get_uniscrnmap(ctx, consolefd, scrnmap) < 0) {
+		ret = -EX_OSERR;
+		goto end;
+	}
+
+	if ((ret = get_palette(ctx, consolefd, cmap)) < 0)
+		goto end;
+
+	entry_ct = ud.entry_ct;
+
+	if ((ret = append(ctx, &b, &hdr, sizeof(hdr))) < 0 ||
+	    (ret = append(ctx, &b, &font.hdr, sizeof(font.hdr))) < 0 ||
+	    (ret = append(ctx, &b, font.glyphs, font.hdr.size)) < 0 ||
+	    (ret = append(ctx, &b, &entry_ct, sizeof(entry_ct))) < 0 ||
+	    (ret = append(ctx, &b, ud.entries, entry_ct * sizeof(struct unipair))) < 0 ||
+	    (ret = append(ctx, &b, scrnmap, sizeof(scrnmap))) < 0 ||
+	    (ret = append(ctx, &b, cmap, sizeof(cmap))) < 0)
+		goto end;
+
+	KFONT_INFO(ctx, _("Saved %u-char %ux%u font, %u unicode map entries and the palette"),
+	           font.hdr.count, font.hdr.width, font.hdr.height, entry_ct);
+
+	*blob   = b.data;
+	*size   = b.len;
+	b.data  = NULL;
+end:
+	free(b.data);
+	free(font.glyphs);
+	free(ud.entries);
+	return ret;
+}
+
+struct cursor {
+	const unsigned char *data;
+	size_t left;
+};
+
+static const void *
+take(struct cursor *c, size_t len)
+{
+	const void *p = c->data;
+
+	if (c->left < len)
+		return NULL;
+
+	c->data += len;
+	c->left -= len;
+
+	return p;
+}
+
+/*
+ * Every component is compared with the state of the console first and
+ * only the ones that differ are loaded, so that restoring an unchanged
+ * console costs only the four reads: KDFONTOP, GIO_UNIMAP, GIO_UNISCRNMAP
+ * and GIO_CMAP.
+ */
+int
+kfont_restore(struct kfont_context *ctx, int consolefd,
+		const unsigned char *blob, size_t size)
+{
+	struct cursor c = { blob, size };
+	struct snapshot_header hdr;
+	struct snapshot_font sfont;
+	struct font_state font = { { 0 }, NULL };
+	struct unimapdesc ud = { 0, NULL }, cur = { 0, NULL };
+	unsigned short scrnmap[E_TABSZ], cur_scrnmap[E_TABSZ];
+	unsigned char cmap[PALETTE_SIZE], cur_cmap[PALETTE_SIZE];
+	const unsigned char *glyphs;
+	const void *p;
+	uint32_t entry_ct;
+	int ret;
+
+	if (!(p = take(&c, sizeof(hdr))))
+		goto bad;
+	memcpy(&hdr, p, sizeof(hdr));
+
+	if (memcmp(hdr.magic, SNAPSHOT_MAGIC, sizeof(hdr.magic)) ||
+	    hdr.version != SNAPSHOT_VERSION)
+		goto bad;
+
+	if (!(p = take(&c, sizeof(sfont))))
+		goto bad;
+	memcpy(&sfont, p, sizeof(sfont));
+
+	if (!sfont.width || sfont.width > 64 || !sfont.height || sfont.height > sfont.vpitch ||
+	    sfont.vpitch > 128 || !sfont.count || sfont.count > SNAPSHOT_FONT_COUNT ||
+	    sfont.size != sfont.count * sfont.vpitch * ((sfont.width + 7) / 8) ||
+	    !(glyphs = take(&c, sfont.size)))
+		goto bad;
+
+	if (!(p = take(&c, sizeof(entry_ct))))
+		goto bad;
+	memcpy(&entry_ct, p, sizeof(entry_ct));
+
+	if (entry_ct > SNAPSHOT_UNIMAP_MAX ||
+	    !(p = take(&c, entry_ct * sizeof(struct unipair))))
+		goto bad;
+
+	ud.entry_ct = (unsigned short) entry_ct;
+	if (entry_ct && !(ud.entries = malloc(entry_ct * sizeof(struct unipair)))) {
+		KFONT_ERR(ctx, "malloc: %m");
+		return -EX_OSERR;
+	}
+	if (entry_ct)
+		memcpy(ud.entries, p, entry_ct * sizeof(struct unipair));
+
+	if (!(p = take(&c, sizeof(scrnmap))))
+		goto bad;
+	memcpy(scrnmap, p, sizeof(scrnmap));
+
+	if (!(p = take(&c, sizeof(cmap))) || c.left)
+		goto bad;
+	memcpy(cmap, p, sizeof(cmap));
+
+	/* font */
+	if ((ret = get_font(ctx, consolefd, &font)) < 0)
+		goto end;
+
+	if (memcmp(&font.hdr, &sfont, sizeof(sfont)) ||
+	    memcmp(font.glyphs, glyphs, sfont.size)) {
+		if (kfont_put_font(ctx, consolefd, (unsigned char *) glyphs, sfont.count,
+		                   sfont.width, sfont.height, sfont.vpitch) < 0) {
+			ret = -EX_OSERR;
+			goto end;
+		}
+		KFONT_INFO(ctx, _("Restored the font"));
+	}
+
+	/* unicode map */
+	if ((ret = get_unimap(ctx, consolefd, &cur)) < 0)
+		goto end;
+
+	if (cur.entry_ct != ud.entry_ct ||
+	    (entry_ct && memcmp(cur.entries, ud.entries, entry_ct * sizeof(struct unipair)))) {
+		if (kfont_put_unicodemap(ctx, consolefd, NULL, &ud) < 0) {
+			ret = -EX_OSERR;
+			goto end;
+		}
+		KFONT_INFO(ctx, _("Restored the unicode map"));
+	}
+
+	/* unicode screen map */
+	if (kfont_get_uniscrnmap(ctx, consolefd, cur_scrnmap) < 0) {
+		ret = -EX_OSERR;
+		goto end;
+	}
+
+	if (memcmp(cur_scrnmap, scrnmap, sizeof(scrnmap))) {
+		if (kfont_put_uniscrnmap(ctx, consolefd, scrnmap) < 0) {
+			ret = -EX_OSERR;
+			goto end;
+		}
+		KFONT_INFO(ctx, _("Restored the screen map"));
+	}
+
+	/* palette */
+	if ((ret = get_palette(ctx, consolefd, cur_cmap)) < 0)
+		goto end;
+
+	if (memcmp(cur_cmap, cmap, sizeof(cmap))) {
+		if (console_ioctl(ctx, consolefd, PIO_CMAP, (unsigned long)cmap)) {
+			KFONT_ERR(ctx, "ioctl(PIO_CMAP): %m");
+			ret = -EX_OSERR;
+			goto end;
+		}
+		KFONT_INFO(ctx, _("Restored the palette"));
+	}
+
+	ret = 0;
+end:
+	free(font.glyphs);
+	free(cur.entries);
+	free(ud.entries);
+	return ret;
+bad:
+	KFONT_ERR(ctx, _("Bad console snapshot"));
+	free(ud.entries);
+	return -EX_DATAERR;
+}
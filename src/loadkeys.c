@@ -24,18 +24,6 @@
 
 #include "libcommon.h"
 
-static const char *const dirpath1[] = {
-	DATADIR "/" KEYMAPDIR "/**",
-	KERNDIR "/",
-	NULL
-};
-static const char *const suffixes[] = {
-	"",
-	".kmap",
-	".map",
-	NULL
-};
-
 static void KBD_ATTR_NORETURN
 usage(int rc, const struct kbd_help *options)
 {
@@ -56,7 +44,6 @@ int main(int argc, char *argv[])
 	int options = 0;
 
 	const char *const *dirpath;
-	const char *dirpath2[] = { NULL, NULL };
 
 	struct lk_ctx *ctx;
 	lk_flags flags = 0;
@@ -66,7 +53,6 @@ int main(int argc, char *argv[])
 	int kbd_mode;
 	int kd_mode;
 	char *console = NULL;
-	char *ev;
 	struct kbdfile_ctx *fctx;
 	struct kbdfile *fp = NULL;
 
@@ -84,6 +70,7 @@ int main(int argc, char *argv[])
 		{ "mktable", no_argument, NULL, 'm' },
 		{ "parse", no_argument, NULL, 'p' },
 		{ "clearstrings", no_argument, NULL, 's' },
+		{ "restore", no_argument, NULL, 'R' },
 		{ "unicode", no_argument, NULL, 'u' },
 		{ "quiet", no_argument, NULL, 'q' },
 		{ "verbose", no_argument, NULL, 'v' },
@@ -99,6 +86,7 @@ int main(int argc, char *argv[])
 		{ "-m, --mktable",      _("output a 'defkeymap.c' to stdout.") },
 		{ "-p, --parse",        _("search and parse keymap without action.") },
 		{ "-s, --clearstrings", _("clear kernel string table.") },
+		{ "    --restore",      _("restore a snapshot made by dumpkeys --snapshot.") },
 		{ "-u, --unicode",      _("force conversion to Unicode.") },
 		{ "-q, --quiet",        _("suppress all normal output.") },
 		{ "-v, --verbose",      _("be more verbose.") },
@@ -113,7 +101,8 @@ int main(int argc, char *argv[])
 		OPT_D = (1 << 3),
 		OPT_M = (1 << 4),
 		OPT_U = (1 << 5),
-		OPT_P = (1 << 6)
+		OPT_P = (1 << 6),
+		OPT_R = (1 << 7)
 	};
 
 	ctx = lk_init();
@@ -150,6 +139,9 @@ int main(int argc, char *argv[])
 			case 's':
 				flags |= LK_FLAG_CLEAR_STRINGS;
 				break;
+			case 'R':
+				options |= OPT_R;
+				break;
 			case 'u':
 				options |= OPT_U;
 				flags |= LK_FLAG_UNICODE_MODE;
@@ -207,20 +199,33 @@ int main(int argc, char *argv[])
 		}
 	}
 
-	lk_set_parser_flags(ctx, flags);
+	if (options & OPT_R) {
+		FILE *f = stdin;
+
+		if (options & (OPT_B | OPT_M | OPT_P | OPT_D) || argc - optind > 1)
+			usage(EX_USAGE, opthelp);
+
+		if (optind < argc && strcmp(argv[optind], "-") &&
+		    !(f = fopen(argv[optind], "r")))
+			kbd_error(EXIT_FAILURE, errno, _("Unable to open file: %s"), argv[optind]);
 
-	dirpath = dirpath1;
-	if ((ev = getenv("LOADKEYS_KEYMAP_PATH")) != NULL) {
-		dirpath2[0] = ev;
-		dirpath     = dirpath2;
+		rc = lk_kernel_restore(ctx, fd, f);
+
+		if (f != stdin)
+			fclose(f);
+		goto fail;
 	}
 
+	lk_set_parser_flags(ctx, flags);
+
+	dirpath = kbd_keymap_dirpath();
+
 	if (options & OPT_D) {
 		if (!(fp = kbdfile_new(fctx)))
 			kbd_error(EXIT_FAILURE, 0, _("Unable to create kbdfile instance: %m"));
 
 		/* first read default map - search starts in . */
-		if (kbdfile_find(DEFMAP, dirpath, suffixes, fp))
+		if (kbdfile_find(DEFMAP, dirpath, kbd_keymap_suffixes, fp))
 			kbd_error(EXIT_FAILURE, 0, _("Unable to find file: %s"), DEFMAP);
 
 		rc = lk_parse_keymap(ctx, fp);
@@ -252,7 +257,7 @@ int main(int argc, char *argv[])
 			kbdfile_set_file(fp, stdin);
 			kbdfile_set_pathname(fp, "<stdin>");
 
-		} else if (kbdfile_find(argv[i], dirpath, suffixes, fp)) {
+		} else if (kbdfile_find(argv[i], dirpath, kbd_keymap_suffixes, fp)) {
 			kbd_warning(0, _("Unable to open file: %s: %m"), argv[i]);
 			goto fail;
 		}
@@ -16,6 +16,7 @@
 #include <sysexits.h>
 #include <sys/ioctl.h>
 #include <sys/stat.h>
+#include <sys/sysmacros.h>
 #include <sys/vt.h>
 #include <sys/wait.h>
 #include <sys/file.h>
@@ -82,21 +83,146 @@ usage(int rc, const struct kbd_help *options)
  * instead of pre-authenticating the user with "login -f".
  */
 
-static char *
-authenticate_user(int curvt)
+struct console_id {
+	dev_t rdev;
+	dev_t dev;
+	ino_t ino;
+	uid_t uid;
+};
+
+/* Does the process have its standard input on the console? */
+static int
+stdin_on_console(const char *pid, const struct console_id *con)
+{
+	char filename[NAME_MAX + 12];
+	struct stat buf;
+
+	snprintf(filename, sizeof(filename), "/proc/%s/fd/0", pid);
+
+	if (stat(filename, &buf))
+		return 0;
+
+	return buf.st_dev == con->dev && buf.st_ino == con->ino && buf.st_uid == con->uid;
+}
+
+/*
+ * Is the console the controlling terminal of the process? This reads the
+ * tty_nr field of /proc/<pid>/stat, which is much cheaper than resolving
+ * the fd/0 link of every process.
+ */
+static int
+controlled_by_console(const char *pid, const struct console_id *con)
+{
+	char filename[NAME_MAX + 12], buf[512], *p;
+	unsigned int tty_nr;
+	ssize_t n;
+	int fd;
+
+	snprintf(filename, sizeof(filename), "/proc/%s/stat", pid);
+
+	if ((fd = open(filename, O_RDONLY)) < 0)
+		return 0;
+
+	n = read(fd, buf, sizeof(buf) - 1);
+	close(fd);
+
+	if (n <= 0)
+		return 0;
+	buf[n] = '\0';
+
+	/* the command name may contain anything, skip past its closing paren */
+	if (!(p = strrchr(buf, ')')))
+		return 0;
+
+	/* state ppid pgrp session tty_nr */
+	if (sscanf(p + 1, " %*c %*d %*d %*d %u", &tty_nr) != 1)
+		return 0;
+
+	return major(con->rdev) == ((tty_nr >> 8) & 0xfff) &&
+	       minor(con->rdev) == ((tty_nr & 0xff) | ((tty_nr >> 12) & 0xfff00));
+}
+
+/*
+ * The kernel tells the session of a terminal only to the processes it
+ * controls, so this works when openvt itself runs on the console.
+ */
+static int
+session_on_console(const char *ttyname, const struct console_id *con)
+{
+	char pid[32];
+	pid_t sid;
+	int fd, rc;
+
+	if ((fd = open(ttyname, O_RDONLY | O_NOCTTY)) < 0)
+		return 0;
+
+	rc = ioctl(fd, TIOCGSID, &sid);
+	close(fd);
+
+	if (rc < 0 || sid <= 0)
+		return 0;
+
+	snprintf(pid, sizeof(pid), "%d", sid);
+
+	return stdin_on_console(pid, con);
+}
+
+/*
+ * Looks for a process with its standard input on the console. The
+ * processes the console controls are looked at while walking /proc, the
+ * others are remembered and looked at only if none of those matches.
+ */
+static int
+scan_processes(const struct console_id *con)
 {
 	DIR *dp;
 	struct dirent *dentp;
-	struct stat buf;
-	dev_t console_dev;
-	ino_t console_ino;
-	uid_t console_uid;
-	char filename[NAME_MAX + 12];
-	struct passwd *pwnam;
+	char pid[32];
+	pid_t *others = NULL;
+	size_t i, nr_others = 0, size = 0;
+	int found = 0;
 
 	if (!(dp = opendir("/proc")))
 		kbd_error(EXIT_FAILURE, errno, "opendir(/proc)");
 
+	while (!found && (dentp = readdir(dp))) {
+		if (dentp->d_name[0] < '0' || dentp->d_name[0] > '9')
+			continue;
+
+		if (controlled_by_console(dentp->d_name, con)) {
+			found = stdin_on_console(dentp->d_name, con);
+			continue;
+		}
+
+		if (nr_others == size) {
+			size   = size ? size * 2 : 256;
+			others = realloc(others, size * sizeof(others[0]));
+			if (!others)
+				kbd_error(EXIT_FAILURE, errno, "realloc");
+		}
+		others[nr_others++] = (pid_t) atoi(dentp->d_name);
+	}
+
+	closedir(dp);
+
+	for (i = 0; !found && i < nr_others; i++) {
+		snprintf(pid, sizeof(pid), "%d", others[i]);
+		found = stdin_on_console(pid, con);
+	}
+
+	free(others);
+
+	return found;
+}
+
+static char *
+authenticate_user(int curvt)
+{
+	struct stat buf;
+	struct console_id con;
+	char filename[NAME_MAX + 12];
+	struct passwd *pwnam;
+
 	/* get the current tty */
 	/* try /dev/ttyN, then /dev/vc/N */
 	sprintf(filename, VTNAME, curvt);
@@ -109,32 +235,28 @@ authenticate_user(int curvt)
 			kbd_error(EXIT_FAILURE, errsv, "%s", filename);
 		}
 	}
-	console_dev = buf.st_dev;
-	console_ino = buf.st_ino;
-	console_uid = buf.st_uid;
+	con.rdev = buf.st_rdev;
+	con.dev  = buf.st_dev;
+	con.ino  = buf.st_ino;
+	con.uid  = buf.st_uid;
 
 	/* get the owner of current tty */
-	if (!(pwnam = getpwuid(console_uid)))
+	if (!(pwnam = getpwuid(con.uid)))
 		kbd_error(EXIT_FAILURE, errno, "getpwuid");
 
-	/* check to make sure that user has a process on that tty */
-	/* this will fail for example when X is running on the tty */
-	while ((dentp = readdir(dp))) {
-		sprintf(filename, "/proc/%s/fd/0", dentp->d_name);
-
-		if (stat(filename, &buf))
-			continue;
-
-		if (buf.st_dev == console_dev && buf.st_ino == console_ino && buf.st_uid == console_uid)
-			goto got_a_process;
-	}
+	/*
+	 * check to make sure that user has a process on that tty
+	 * this will fail for example when X is running on the tty
+	 *
+	 * Try the session of the tty first, then the processes it controls,
+	 * then every other one, as the tty may have been opened with
+	 * O_NOCTTY.
+	 */
+	if (session_on_console(filename, &con) ||
+	    scan_processes(&con))
+		return pwnam->pw_name;
 
 	kbd_error(EXIT_FAILURE, 0, _("Couldn't find owner of current tty!"));
-
-got_a_process:
-	closedir(dp);
-
-	return pwnam->pw_name;
 }
 
 static int
@@ -220,13 +342,350 @@ fail:
 	return rc;
 }
 
+/*
+ * Prepares the child that runs the command: a new session, the VT as its
+ * controlling terminal and standard streams, and the real user if it runs
+ * as root. Without SEARCH, *VTNO must be opened; with it, the next VTs free
+ * in STATE are tried as well and *VTNO is set to the one that was opened.
+ */
+static void
+setup_child(int *vtno, unsigned short state, int search, int force, int new_session,
+            int drop_root, char show, char verbose, int consfd)
+{
+	char vtname[PATH_MAX + 1];
+	int fd, i;
+
+	/* leave current vt */
+	if (new_session) {
+#ifdef ESIX_5_3_2_D
+#ifdef HAVE_SETPGRP
+		if (setpgrp() < 0)
+#else
+		if (1)
+#endif /* HAVE_SETPGRP */
+#else
+		if (setsid() < 0)
+#endif /* ESIX_5_3_2_D */
+			kbd_error(5, errno, _("Unable to set new session"));
+	}
+
+	snprintf(vtname, PATH_MAX, VTNAME, *vtno);
+
+	/* Can we open the vt we want? */
+	if ((fd = open_vt(vtname, force)) == -1) {
+		int errsv = errno;
+		if (search) {
+			/* We found vtno ourselves - it is free according
+			   to the kernel, but we cannot open it. Maybe X
+			   used it and did a chown.  Try a few vt's more
+			   before giving up. Note: the 16 is a kernel limitation. */
+			for (i = *vtno + 1; i < 16; i++) {
+				if ((state & (1 << i)) == 0) {
+					snprintf(vtname, PATH_MAX, VTNAME, i);
+					if ((fd = open_vt(vtname, force)) >= 0) {
+						*vtno = i;
+						goto got_vtno;
+					}
+				}
+			}
+			snprintf(vtname, PATH_MAX, VTNAME, *vtno);
+		}
+		errno = errsv;
+		kbd_error(5, 0, _("Unable to open file: %s: %m"), vtname);
+	}
+got_vtno:
+	if (verbose)
+		kbd_warning(0, _("Using VT %s"), vtname);
+
+	/* Maybe we are suid root, and the -c option was given.
+	   Check that the real user can access this VT.
+	   We assume getty has made any in use VT non accessable */
+	if (access(vtname, R_OK | W_OK) < 0)
+		kbd_error(5, errno, _("Cannot open %s read/write"), vtname);
+
+	if (drop_root && !geteuid()) {
+		uid_t uid = getuid();
+		if (chown(vtname, uid, getgid()) == -1)
+			kbd_error(5, errno, "chown");
+		if (setuid(uid) < 0)
+			kbd_error(5, errno, "setuid");
+	}
+
+	if (show && change_vt(fd, *vtno) < 0)
+		exit(1);
+
+	close(0);
+	close(1);
+	close(2);
+	close(consfd);
+
+	if ((dup2(fd, 0) == -1) || (dup2(fd, 1) == -1) || (dup2(fd, 2) == -1))
+		kbd_error(1, errno, "dup");
+}
+
+/*
+ * Batch mode: every line of the file is "VT command [argument...]", where
+ * VT is a number or "-" for the next free VT. All the VTs are allocated
+ * up front from a single VT_GETSTATE and the commands are started from
+ * this one process.
+ */
+struct batch_entry {
+	int vtno;
+	char *cmd;
+	char **argv;
+	pid_t pid;
+	int status;
+};
+
+struct batch {
+	struct batch_entry *entries;
+	size_t count;
+	size_t size;
+};
+
+#define BATCH_SEPARATORS " \t\n"
+
+static void
+batch_add_arg(struct batch_entry *e, size_t *nargs, const char *arg)
+{
+	e->argv = realloc(e->argv, (*nargs + 2) * sizeof(char *));
+	if (!e->argv)
+		kbd_error(EX_OSERR, errno, "realloc");
+
+	if (!(e->argv[(*nargs)++] = strdup(arg)))
+		kbd_error(EX_OSERR, errno, "strdup");
+
+	e->argv[*nargs] = NULL;
+}
+
+static void
+read_batch(struct batch *batch, const char *filename, char login)
+{
+	FILE *fp;
+	struct batch_entry *e;
+	char *line = NULL, *word, *end;
+	size_t linesz = 0, nargs;
+	unsigned int lineno = 0;
+	long vtno;
+
+	if (!strcmp(filename, "-"))
+		fp = stdin;
+	else if (!(fp = fopen(filename, "r")))
+		kbd_error(EXIT_FAILURE, errno, _("Unable to open file: %s"), filename);
+
+	while (getline(&line, &linesz, fp) != -1) {
+		lineno++;
+
+		word = strtok(line, BATCH_SEPARATORS);
+		if (!word || word[0] == '#')
+			continue;
+
+		if (batch->count == batch->size) {
+			batch->size    = batch->size ? batch->size * 2 : 16;
+			batch->entries = realloc(batch->entries, batch->size * sizeof(struct batch_entry));
+			if (!batch->entries)
+				kbd_error(EX_OSERR, errno, "realloc");
+		}
+
+		e = &batch->entries[batch->count++];
+		memset(e, 0, sizeof(*e));
+		e->vtno = -1;
+
+		if (strcmp(word, "-")) {
+			errno = 0;
+			vtno  = strtol(word, &end, 10);
+
+			if (errno || *end || vtno <= 0 || vtno > 63)
+				kbd_error(5, 0, _("%s:%u: %s: Illegal vt number"), filename, lineno, word);
+
+			e->vtno = (int) vtno;
+		}
+
+		nargs = 0;
+
+		while ((word = strtok(NULL, BATCH_SEPARATORS)))
+			batch_add_arg(e, &nargs, word);
+
+		if (!nargs) {
+			if (!(word = getenv("SHELL")))
+				kbd_error(7, 0, _("Unable to find command."));
+			batch_add_arg(e, &nargs, word);
+		}
+
+		if (!(e->cmd = strdup(e->argv[0])))
+			kbd_error(EX_OSERR, errno, "strdup");
+
+		if (login) {
+			free(e->argv[0]);
+			if (!(e->argv[0] = malloc(strlen(e->cmd) + 2)))
+				kbd_error(EX_OSERR, errno, "malloc");
+			strcpy(e->argv[0], "-");
+			strcat(e->argv[0], e->cmd);
+		}
+	}
+
+	if (ferror(fp))
+		kbd_error(EXIT_FAILURE, errno, "%s", filename);
+
+	free(line);
+
+	if (fp != stdin)
+		fclose(fp);
+}
+
+static void
+free_batch(struct batch *batch)
+{
+	size_t i, j;
+
+	for (i = 0; i < batch->count; i++) {
+		for (j = 0; batch->entries[i].argv[j]; j++)
+			free(batch->entries[i].argv[j]);
+		free(batch->entries[i].argv);
+		free(batch->entries[i].cmd);
+	}
+	free(batch->entries);
+}
+
+/*
+ * Checks the requested VTs and gives the free ones to the "-" entries.
+ * Nothing is started unless the whole batch can be placed.
+ */
+static void
+allocate_batch(struct batch *batch, unsigned short state, int force)
+{
+	unsigned int used = state;
+	size_t i;
+	int vtno;
+
+	for (i = 0; i < batch->count; i++) {
+		vtno = batch->entries[i].vtno;
+
+		if (vtno < 0)
+			continue;
+
+		if (!force) {
+			if (vtno >= 16)
+				kbd_error(7, 0, _("Cannot check whether vt %d is free; use `%s -f' to force."),
+				          vtno, get_progname());
+
+			if (used & (1U << vtno))
+				kbd_error(7, 0, _("vt %d is in use; command aborted; use `%s -f' to force."),
+				          vtno, get_progname());
+		}
+
+		/* a forced VT must not be given to a "-" entry as well */
+		if (vtno < 16)
+			used |= 1U << vtno;
+	}
+
+	for (i = 0; i < batch->count; i++) {
+		if (batch->entries[i].vtno >= 0)
+			continue;
+
+		/* the 16 is a kernel limitation of VT_GETSTATE */
+		for (vtno = 1; vtno < 16 && (used & (1U << vtno)); vtno++)
+			;
+
+		if (vtno == 16)
+			kbd_error(3, 0, _("Cannot find a free vt"));
+
+		batch->entries[i].vtno = vtno;
+		used |= 1U << vtno;
+	}
+}
+
+static void KBD_ATTR_NORETURN
+exec_batch_entry(const struct batch_entry *e, int consfd, int force)
+{
+	int vtno = e->vtno;
+
+	/* the VT was picked by allocate_batch(), it is not searched again */
+	setup_child(&vtno, 0, FALSE, force, TRUE, TRUE, FALSE, FALSE, consfd);
+
+	execvp(e->cmd, e->argv);
+
+	kbd_error(127, errno, "exec");
+}
+
+static int
+run_batch(struct batch *batch, int consfd, const struct vt_stat *vtstat,
+          int force, char show, char do_wait, char verbose)
+{
+	char vtname[PATH_MAX + 1];
+	size_t i, remaining;
+	int status, retval = 0;
+	pid_t pid;
+
+	allocate_batch(batch, vtstat->v_state, force);
+
+	for (i = 0; i < batch->count; i++) {
+		if ((pid = fork()) == 0)
+			exec_batch_entry(&batch->entries[i], consfd, force);
+
+		if (pid < 0)
+			kbd_error(6, errno, "fork");
+
+		batch->entries[i].pid = pid;
+
+		if (verbose) {
+			snprintf(vtname, PATH_MAX, VTNAME, batch->entries[i].vtno);
+			kbd_warning(0, _("Using VT %s"), vtname);
+		}
+	}
+
+	if (show && batch->count && change_vt(consfd, batch->entries[0].vtno) < 0)
+		exit(1);
+
+	if (!do_wait)
+		return EXIT_SUCCESS;
+
+	/* reap the commands in whatever order they finish */
+	for (remaining = batch->count; remaining > 0;) {
+		if ((pid = wait(&status)) < 0) {
+			if (errno == EINTR)
+				continue;
+			kbd_error(EXIT_FAILURE, errno, "wait");
+		}
+
+		for (i = 0; i < batch->count; i++) {
+			if (batch->entries[i].pid != pid)
+				continue;
+
+			batch->entries[i].status = status;
+			remaining--;
+			break;
+		}
+	}
+
+	if (show) { /* Switch back... */
+		if (change_vt(consfd, vtstat->v_active) < 0)
+			exit(8);
+
+		for (i = 0; i < batch->count; i++)
+			if (ioctl(consfd, VT_DISALLOCATE, batch->entries[i].vtno))
+				kbd_warning(0, _("Couldn't deallocate console %d"), batch->entries[i].vtno);
+	}
+
+	/* the status of the first command in the file that failed */
+	for (i = 0; i < batch->count && !retval; i++) {
+		status = batch->entries[i].status;
+
+		if (WIFEXITED(status))
+			retval = WEXITSTATUS(status);
+		else if (WIFSIGNALED(status))
+			retval = 128 + WTERMSIG(status);
+	}
+
+	return retval;
+}
+
 int main(int argc, char *argv[])
 {
 	int opt, i;
 	struct vt_stat vtstat;
 	int pid          = 0;
 	int vtno         = -1;
-	int fd           = -1;
 	int consfd       = -1;
 	int force        = 0;
 	char optc        = FALSE;
@@ -236,8 +695,8 @@ int main(int argc, char *argv[])
 	char direct_exec = FALSE;
 	char do_wait     = FALSE;
 	char as_user     = FALSE;
-	char vtname[PATH_MAX+1];
 	char *cmd = NULL, *def_cmd = NULL, *username = NULL;
+	const char *batch_file = NULL;
 
 	set_progname(argv[0]);
 	setuplocale();
@@ -253,11 +712,13 @@ int main(int argc, char *argv[])
 		{ "switch", no_argument, NULL, 's' },
 		{ "wait", no_argument, NULL, 'w' },
 		{ "console", required_argument, NULL, 'c' },
+		{ "batch", required_argument, NULL, 'b' },
 		{ NULL, 0, NULL, 0 }
 	};
 
 	const struct kbd_help opthelp[] = {
 		{ "-c, --console=DEV", _("the console device to be used.") },
+		{ "-b, --batch=FILE",  _("start the \"VT command...\" lines of FILE (- for stdin).") },
 		{ "-e, --exec",        _("execute the command, without forking.") },
 		{ "-f, --force",       _("force opening a VT without checking.") },
 		{ "-l, --login",       _("make the command a login shell.") },
@@ -270,7 +731,7 @@ int main(int argc, char *argv[])
 		{ NULL, NULL }
 	};
 
-	while ((opt = getopt_long(argc, argv, "c:lsfuewhvV", long_options, NULL)) != -1) {
+	while ((opt = getopt_long(argc, argv, "b:c:lsfuewhvV", long_options, NULL)) != -1) {
 		switch (opt) {
 			case 'c':
 				optc = 1; /* vtno was specified by the user */
@@ -283,6 +744,9 @@ int main(int argc, char *argv[])
 				if (setuid(getuid()) < 0)
 					kbd_error(5, errno, "%s: setuid", optarg);
 				break;
+			case 'b':
+				batch_file = optarg;
+				break;
 			case 'l':
 				login = TRUE;
 				break;
@@ -318,6 +782,14 @@ int main(int argc, char *argv[])
 		}
 	}
 
+	if (batch_file) {
+		if (optc || direct_exec || as_user)
+			kbd_error(EX_USAGE, 0, _("Options %s and %s are mutually exclusive."),
+			          "--batch", optc ? "--console" : direct_exec ? "--exec" : "--user");
+		if (argc > optind)
+			usage(EX_USAGE, opthelp);
+	}
+
 	for (i = 0; i < 3; i++) {
 		struct stat st;
 
@@ -331,6 +803,17 @@ int main(int argc, char *argv[])
 	if (ioctl(consfd, VT_GETSTATE, &vtstat) < 0)
 		kbd_error(4, errno, "ioctl(VT_GETSTATE)");
 
+	if (batch_file) {
+		struct batch batch = { 0 };
+
+		read_batch(&batch, batch_file, login);
+
+		i = run_batch(&batch, consfd, &vtstat, force, show, do_wait, verbose);
+
+		free_batch(&batch);
+		return i;
+	}
+
 	if (vtno == -1) {
 		if (ioctl(consfd, VT_OPENQRY, &vtno) < 0 || vtno == -1)
 			kbd_error(3, errno, _("Cannot find a free vt"));
@@ -375,72 +858,8 @@ int main(int argc, char *argv[])
 	}
 
 	if (direct_exec || ((pid = fork()) == 0)) {
-		/* leave current vt */
-		if (!direct_exec) {
-#ifdef ESIX_5_3_2_D
-#ifdef HAVE_SETPGRP
-			if (setpgrp() < 0)
-#else
-			if (1)
-#endif /* HAVE_SETPGRP */
-#else
-			if (setsid() < 0)
-#endif /* ESIX_5_3_2_D */
-				kbd_error(5, errno, _("Unable to set new session"));
-		}
-
-		snprintf(vtname, PATH_MAX, VTNAME, vtno);
-
-		/* Can we open the vt we want? */
-		if ((fd = open_vt(vtname, force)) == -1) {
-			int errsv = errno;
-			if (!optc) {
-				/* We found vtno ourselves - it is free according
-				   to the kernel, but we cannot open it. Maybe X
-				   used it and did a chown.  Try a few vt's more
-				   before giving up. Note: the 16 is a kernel limitation. */
-				for (i = vtno + 1; i < 16; i++) {
-					if ((vtstat.v_state & (1 << i)) == 0) {
-						snprintf(vtname, PATH_MAX, VTNAME, i);
-						if ((fd = open_vt(vtname, force)) >= 0) {
-							vtno = i;
-							goto got_vtno;
-						}
-					}
-				}
-				snprintf(vtname, PATH_MAX, VTNAME, vtno);
-			}
-			errno = errsv;
-			kbd_error(5, 0, _("Unable to open file: %s: %m"), vtname);
-		}
-	got_vtno:
-		if (verbose)
-			kbd_warning(0, _("Using VT %s"), vtname);
-
-		/* Maybe we are suid root, and the -c option was given.
-		   Check that the real user can access this VT.
-		   We assume getty has made any in use VT non accessable */
-		if (access(vtname, R_OK | W_OK) < 0)
-			kbd_error(5, errno, _("Cannot open %s read/write"), vtname);
-
-		if (!as_user && !geteuid()) {
-			uid_t uid = getuid();
-			if (chown(vtname, uid, getgid()) == -1)
-				kbd_error(5, errno, "chown");
-			if (setuid(uid) < 0)
-				kbd_error(5, errno, "setuid");
-		}
-
-		if (show && change_vt(fd, vtno) < 0)
-			exit(1);
-
-		close(0);
-		close(1);
-		close(2);
-		close(consfd);
-
-		if ((dup2(fd, 0) == -1) || (dup2(fd, 1) == -1) || (dup2(fd, 2) == -1))
-			kbd_error(1, errno, "dup");
+		setup_child(&vtno, vtstat.v_state, !optc, force, !direct_exec,
+		            !as_user, show, verbose, consfd);
 
 		/* slight problem: after "openvt -su" has finished, the
 		   utmp entry is not removed */
@@ -20,69 +20,90 @@
 
 #include <stdio.h>
 #include <stdlib.h>
+#include <stdint.h>
 #include <string.h>
+#include <getopt.h>
 #include <unistd.h>
 #include <fcntl.h>
 #include <errno.h>
+#include <poll.h>
+#include <sysexits.h>
+#include <time.h>
 #include <sys/ioctl.h>
+#include <sys/uio.h>
+#include <linux/vt.h>
 
 #include "libcommon.h"
 
-int main(int argc, char **argv)
-{
-	int cons = 0;
-	char infile[20];
-	unsigned char header[4];
-	unsigned int rows, cols;
-	int fd;
-	unsigned int i, j;
-	char *inbuf, *outbuf, *p, *q;
+/* rows and columns are single bytes in the vcsa header */
+#define VCSA_MAX_SIZE (4 + 2 * 255 * 255)
 
-	set_progname(argv[0]);
-	setuplocale();
+static void KBD_ATTR_NORETURN
+usage(int rc, const struct kbd_help *options)
+{
+	fprintf(stderr, _("Usage: %s [option...] [N...]\n"), get_progname());
+	fprintf(stderr, "\n");
+	fprintf(stderr, _("Dumps the screen of /dev/ttyN, or of the current console.\n"));
 
-	if (argc == 2 && !strcmp(argv[1], "-V"))
-		print_version_and_exit();
+	print_options(options);
+	print_report_bugs();
 
-	if (argc > 2) {
-		fprintf(stderr, _("usage: screendump [n]\n"));
-		exit(EXIT_FAILURE);
-	}
+	exit(rc);
+}
 
-	cons = (argc == 2) ? atoi(argv[1]) : 0;
+/* Opens the vcs device of the given KIND ("a" or "u") of a console. */
+static int
+open_vcs(const char *kind, int cons, char *infile)
+{
+	int fd;
 
-	sprintf(infile, "/dev/vcsa%d", cons);
+	sprintf(infile, "/dev/vcs%s%d", kind, cons);
 	fd = open(infile, O_RDONLY);
 	if (fd < 0 && cons == 0 && errno == ENOENT) {
-		sprintf(infile, "/dev/vcsa");
+		sprintf(infile, "/dev/vcs%s", kind);
 		fd = open(infile, O_RDONLY);
 	}
 	if (fd < 0 && errno == ENOENT) {
-		sprintf(infile, "/dev/vcs/a%d", cons);
+		sprintf(infile, "/dev/vcs/%s%d", kind, cons);
 		fd = open(infile, O_RDONLY);
 	}
 	if (fd < 0 && cons == 0 && errno == ENOENT) {
-		sprintf(infile, "/dev/vcs/a");
+		sprintf(infile, "/dev/vcs/%s", kind);
 		fd = open(infile, O_RDONLY);
 	}
-	if (fd < 0 || read(fd, header, 4) != 4)
-		goto try_ioctl;
-	rows = header[0];
-	cols = header[1];
-	if (rows * cols == 0)
-		goto try_ioctl;
+	return fd;
+}
 
-	if (!(inbuf = malloc(rows * cols * 2)))
-		kbd_error(EXIT_FAILURE, errno, _("out of memory"));
+/* Buffer that is kept from one screen to the next. */
+struct buffer {
+	unsigned char *data;
+	size_t size;
+};
 
-	if (!(outbuf = malloc(rows * (cols + 1))))
-		kbd_error(EXIT_FAILURE, errno, _("out of memory"));
+static unsigned char *
+reserve(struct buffer *b, size_t size)
+{
+	if (size > b->size) {
+		free(b->data);
 
-	if (read(fd, inbuf, rows * cols * 2) != (ssize_t)(rows * cols * 2)) {
-		kbd_error(EXIT_FAILURE, errno, _("Error reading %s"), infile);
+		if (!(b->data = malloc(size)))
+			kbd_error(EXIT_FAILURE, errno, _("out of memory"));
+
+		b->size = size;
 	}
-	p = inbuf;
-	q = outbuf;
+	return b->data;
+}
+
+/*
+ * Converts the vcsa screen in BUF to text in place, one line per row
+ * without the trailing spaces. Returns the length of the text.
+ */
+static size_t
+vcsa_to_text(unsigned char *buf, unsigned int rows, unsigned int cols)
+{
+	unsigned char *p = buf + 4, *q = buf;
+	unsigned int i, j;
+
 	for (i = 0; i < rows; i++) {
 		for (j = 0; j < cols; j++) {
 			*q++ = *p;
@@ -92,6 +113,462 @@ int main(int argc, char **argv)
 			q--;
 		*q++ = '\n';
 	}
+	return (size_t) (q - buf);
+}
+
+/*
+ * Same for the UTF-32 cells of vcsu, written as UTF-8 to OUT, which has
+ * room for 4 bytes per cell and a newline per row.
+ */
+static size_t
+vcsu_to_utf8(const uint32_t *in, unsigned int rows, unsigned int cols,
+             unsigned char *out)
+{
+	unsigned char *q = out, *end;
+	unsigned int i, j, k;
+	uint32_t c;
+
+	for (i = 0; i < rows; i++, in += cols) {
+		end = q;
+
+		for (j = 0; j < cols;) {
+			/* ASCII fast path, four cells at a time */
+			if (j + 4 <= cols && !((in[j] | in[j + 1] | in[j + 2] | in[j + 3]) & ~0x7fU)) {
+				q[0] = (unsigned char) in[j];
+				q[1] = (unsigned char) in[j + 1];
+				q[2] = (unsigned char) in[j + 2];
+				q[3] = (unsigned char) in[j + 3];
+
+				for (k = 4; k > 0; k--) {
+					if (in[j + k - 1] != ' ') {
+						end = q + k;
+						break;
+					}
+				}
+
+				q += 4;
+				j += 4;
+				continue;
+			}
+
+			c = in[j++];
+
+			if (c < 0x80) {
+				*q++ = (unsigned char) c;
+				if (c != ' ')
+					end = q;
+				continue;
+			}
+
+			if (c > 0x10ffff || (c >= 0xd800 && c <= 0xdfff))
+				c = 0xfffd;
+
+			if (c < 0x800) {
+				*q++ = (unsigned char) (0xc0 | (c >> 6));
+			} else {
+				if (c < 0x10000) {
+					*q++ = (unsigned char) (0xe0 | (c >> 12));
+				} else {
+					*q++ = (unsigned char) (0xf0 | (c >> 18));
+					*q++ = (unsigned char) (0x80 | ((c >> 12) & 0x3f));
+				}
+				*q++ = (unsigned char) (0x80 | ((c >> 6) & 0x3f));
+			}
+			*q++ = (unsigned char) (0x80 | (c & 0x3f));
+			end  = q;
+		}
+
+		q    = end;
+		*q++ = '\n';
+	}
+	return (size_t) (q - out);
+}
+
+/*
+ * Reads the screen of console CONS with a single pread() and converts it
+ * to text. Returns the length of the text stored at *TEXT, or -1 if the
+ * vcsa device can not be used.
+ */
+static ssize_t
+read_screen(int cons, int unicode, struct buffer *b, char *infile,
+            unsigned char **text, unsigned int *prows, unsigned int *pcols)
+{
+	unsigned char header[4];
+	unsigned int rows, cols;
+	size_t cells;
+	ssize_t len;
+	int fd;
+
+	if ((fd = open_vcs("a", cons, infile)) < 0)
+		return -1;
+
+	if (!unicode) {
+		len = pread(fd, reserve(b, VCSA_MAX_SIZE), VCSA_MAX_SIZE, 0);
+		close(fd);
+
+		if (len < 4)
+			return -1;
+
+		rows  = b->data[0];
+		cols  = b->data[1];
+		cells = (size_t) rows * cols;
+
+		if (!cells)
+			return -1;
+
+		if ((size_t) len < 4 + 2 * cells)
+			kbd_error(EXIT_FAILURE, errno, _("Error reading %s"), infile);
+
+		*prows = rows;
+		*pcols = cols;
+		*text  = b->data;
+		return (ssize_t) vcsa_to_text(b->data, rows, cols);
+	}
+
+	/* vcsu has no header, the geometry comes from vcsa */
+	len = pread(fd, header, sizeof(header), 0);
+	close(fd);
+
+	if (len != sizeof(header))
+		return -1;
+
+	rows  = header[0];
+	cols  = header[1];
+	cells = (size_t) rows * cols;
+
+	if (!cells)
+		return -1;
+
+	if ((fd = open_vcs("u", cons, infile)) < 0)
+		kbd_error(EXIT_FAILURE, errno, _("Couldn't read %s"), infile);
+
+	reserve(b, 4 * cells + rows * (4 * (size_t) cols + 1));
+
+	len = pread(fd, b->data, 4 * cells, 0);
+	close(fd);
+
+	if (len != (ssize_t) (4 * cells))
+		kbd_error(EXIT_FAILURE, errno, _("Error reading %s"), infile);
+
+	*prows = rows;
+	*pcols = cols;
+	*text  = b->data + 4 * cells;
+	return (ssize_t) vcsu_to_utf8((const uint32_t *) b->data, rows, cols, *text);
+}
+
+struct watch {
+	int cons;
+	char infile[20];
+	unsigned char *screen;
+	unsigned char *prev;
+	unsigned int rows, cols;
+};
+
+/*
+ * Reads the whole screen with one pread() and prints the rows that differ
+ * from the previous read. The read also tells the kernel that the update
+ * was seen, so the next poll() waits for a new one.
+ */
+static int
+follow_update(struct watch *w, int fd, FILE *out)
+{
+	struct timespec ts;
+	unsigned char *tmp, *p, *old;
+	unsigned int i, j, n, rows, cols;
+	ssize_t len;
+	int resized;
+
+	if ((len = pread(fd, w->screen, VCSA_MAX_SIZE, 0)) < 4)
+		return -1;
+
+	rows = w->screen[0];
+	cols = w->screen[1];
+
+	if ((size_t) len < 4 + 2 * (size_t) rows * cols)
+		return -1;
+
+	resized = (rows != w->rows || cols != w->cols);
+
+	clock_gettime(CLOCK_REALTIME, &ts);
+
+	for (i = 0; i < rows; i++) {
+		p   = w->screen + 4 + 2 * i * cols;
+		old = w->prev + 4 + 2 * i * cols;
+
+		if (!resized) {
+			for (j = 0; j < cols && p[2 * j] == old[2 * j]; j++)
+				;
+			if (j == cols)
+				continue;
+		}
+
+		for (n = cols; n > 0 && p[2 * (n - 1)] == ' '; n--)
+			;
+
+		fprintf(out, "%lld.%06ld %d %u: ", (long long) ts.tv_sec, ts.tv_nsec / 1000,
+		        w->cons, i);
+		for (j = 0; j < n; j++)
+			putc(p[2 * j], out);
+		putc('\n', out);
+	}
+
+	fflush(out);
+
+	w->rows = rows;
+	w->cols = cols;
+
+	tmp       = w->prev;
+	w->prev   = w->screen;
+	w->screen = tmp;
+
+	return 0;
+}
+
+/*
+ * Keeps the vcsa devices of all the consoles open and waits for changes,
+ * which the kernel signals with POLLPRI.
+ */
+static void KBD_ATTR_NORETURN
+follow(char **consoles, int nconsoles)
+{
+	struct pollfd *pfds;
+	struct watch *w;
+	int i, nactive;
+
+	pfds = calloc((size_t) nconsoles, sizeof(struct pollfd));
+	w    = calloc((size_t) nconsoles, sizeof(struct watch));
+
+	if (!pfds || !w)
+		kbd_error(EXIT_FAILURE, errno, _("out of memory"));
+
+	for (i = 0; i < nconsoles; i++) {
+		w[i].cons = consoles ? atoi(consoles[i]) : 0;
+
+		if ((pfds[i].fd = open_vcs("a", w[i].cons, w[i].infile)) < 0)
+			kbd_error(EXIT_FAILURE, errno, _("Couldn't read %s"), w[i].infile);
+
+		pfds[i].events = POLLPRI;
+
+		w[i].screen = malloc(VCSA_MAX_SIZE);
+		w[i].prev   = malloc(VCSA_MAX_SIZE);
+
+		if (!w[i].screen || !w[i].prev)
+			kbd_error(EXIT_FAILURE, errno, _("out of memory"));
+	}
+
+	/*
+	 * The kernel starts to watch a vcs device at its first poll(), so poll
+	 * once before the first read: a change made after that read can not be
+	 * missed.
+	 */
+	while (poll(pfds, (nfds_t) nconsoles, 0) < 0) {
+		if (errno != EINTR)
+			kbd_error(EXIT_FAILURE, errno, "poll");
+	}
+
+	for (i = 0; i < nconsoles; i++) {
+		if (follow_update(&w[i], pfds[i].fd, stdout) < 0)
+			kbd_error(EXIT_FAILURE, errno, _("Error reading %s"), w[i].infile);
+	}
+
+	nactive = nconsoles;
+
+	while (nactive > 0) {
+		if (poll(pfds, (nfds_t) nconsoles, -1) < 0) {
+			if (errno == EINTR)
+				continue;
+			kbd_error(EXIT_FAILURE, errno, "poll");
+		}
+
+		for (i = 0; i < nconsoles; i++) {
+			if (pfds[i].fd < 0 || !pfds[i].revents)
+				continue;
+
+			/* the console was deallocated */
+			if ((pfds[i].revents & (POLLERR | POLLHUP | POLLNVAL)) ||
+			    follow_update(&w[i], pfds[i].fd, stdout) < 0) {
+				kbd_warning(0, _("Couldn't read %s"), w[i].infile);
+				close(pfds[i].fd);
+				pfds[i].fd = -1;
+				nactive--;
+			}
+		}
+	}
+
+	exit(EXIT_FAILURE);
+}
+
+static void
+write_iov(struct iovec *iov, int cnt)
+{
+	ssize_t n;
+
+	while (cnt > 0) {
+		if ((n = writev(STDOUT_FILENO, iov, cnt)) < 0) {
+			if (errno == EINTR)
+				continue;
+			kbd_error(EXIT_FAILURE, errno, _("Error writing screendump"));
+		}
+
+		while (cnt > 0 && (size_t) n >= iov->iov_len) {
+			n -= (ssize_t) iov->iov_len;
+			iov++;
+			cnt--;
+		}
+
+		if (cnt > 0) {
+			iov->iov_base = (char *) iov->iov_base + n;
+			iov->iov_len -= (size_t) n;
+		}
+	}
+}
+
+/*
+ * Dumps all the allocated consoles into one stream. Each screen is framed
+ * by a header line:
+ *
+ *   screendump tty<N> <rows> <cols> <vcsa|vcsu> <length>\n
+ *
+ * followed by <length> bytes of text. All the screens are read first and
+ * then written with a single writev().
+ */
+static void KBD_ATTR_NORETURN
+dump_all(int unicode)
+{
+	struct buffer bufs[MAX_NR_CONSOLES];
+	struct iovec iov[2 * MAX_NR_CONSOLES];
+	char headers[MAX_NR_CONSOLES][64];
+	char infile[20];
+	struct vt_stat vtstat;
+	unsigned char *text;
+	unsigned int rows, cols;
+	ssize_t len;
+	int i, n = 0, fd;
+
+	if ((fd = getfd(NULL)) < 0)
+		kbd_error(EXIT_FAILURE, 0, _("Couldn't get a file descriptor referring to the console."));
+
+	if (ioctl(fd, VT_GETSTATE, &vtstat))
+		kbd_error(EXIT_FAILURE, errno, "ioctl VT_GETSTATE");
+
+	close(fd);
+
+	memset(bufs, 0, sizeof(bufs));
+
+	/*
+	 * VT_GETSTATE only knows about the first 16 consoles, the devices of
+	 * the other ones can not be opened if they are not allocated.
+	 */
+	for (i = 1; i <= MAX_NR_CONSOLES; i++) {
+		if (i < 16 && !(vtstat.v_state & (1 << i)))
+			continue;
+
+		len = read_screen(i, unicode, &bufs[n], infile, &text, &rows, &cols);
+		if (len < 0) {
+			if (i < 16)
+				kbd_warning(errno, _("Couldn't read %s"), infile);
+			continue;
+		}
+
+		iov[2 * n].iov_base = headers[n];
+		iov[2 * n].iov_len  = (size_t) snprintf(headers[n], sizeof(headers[n]),
+		                                        "screendump tty%d %u %u %s %zd\n",
+		                                        i, rows, cols, unicode ? "vcsu" : "vcsa", len);
+		iov[2 * n + 1].iov_base = text;
+		iov[2 * n + 1].iov_len  = (size_t) len;
+		n++;
+	}
+
+	write_iov(iov, 2 * n);
+
+	for (i = 0; i < n; i++)
+		free(bufs[i].data);
+
+	exit(EXIT_SUCCESS);
+}
+
+int main(int argc, char **argv)
+{
+	int cons = 0;
+	char infile[20];
+	struct buffer buf = { NULL, 0 };
+	unsigned char *text;
+	unsigned int rows, cols;
+	int c, fd, follow_mode = 0, unicode = 0, all = 0;
+	unsigned int i, j;
+	char *outbuf, *p, *q;
+	ssize_t len;
+
+	set_progname(argv[0]);
+	setuplocale();
+
+	const char *short_opts = "afuhV";
+	const struct option long_opts[] = {
+		{ "all",     no_argument, NULL, 'a' },
+		{ "follow",  no_argument, NULL, 'f' },
+		{ "unicode", no_argument, NULL, 'u' },
+		{ "help",    no_argument, NULL, 'h' },
+		{ "version", no_argument, NULL, 'V' },
+		{ NULL,      0,           NULL,  0  }
+	};
+	const struct kbd_help opthelp[] = {
+		{ "-a, --all",     _("dump all the allocated consoles into one stream.") },
+		{ "-f, --follow",  _("keep watching the consoles and print the changed rows.") },
+		{ "-u, --unicode", _("dump the screen as UTF-8 text using /dev/vcsu.") },
+		{ "-V, --version", _("print version number.")     },
+		{ "-h, --help",    _("print this usage message.") },
+		{ NULL, NULL }
+	};
+
+	while ((c = getopt_long(argc, argv, short_opts, long_opts, NULL)) != -1) {
+		switch (c) {
+			case 'a':
+				all = 1;
+				break;
+			case 'f':
+				follow_mode = 1;
+				break;
+			case 'u':
+				unicode = 1;
+				break;
+			case 'V':
+				print_version_and_exit();
+				break;
+			case 'h':
+				usage(EXIT_SUCCESS, opthelp);
+				break;
+			case '?':
+				usage(EX_USAGE, opthelp);
+				break;
+		}
+	}
+
+	if (follow_mode && unicode)
+		kbd_error(EX_USAGE, 0, _("Options %s and %s are mutually exclusive."),
+		          "--follow", "--unicode");
+
+	if (all) {
+		if (follow_mode || optind != argc)
+			usage(EX_USAGE, opthelp);
+		dump_all(unicode);
+	}
+
+	if (follow_mode) {
+		if (optind == argc)
+			follow(NULL, 1);
+		follow(argv + optind, argc - optind);
+	}
+
+	if (argc - optind > 1)
+		usage(EX_USAGE, opthelp);
+
+	cons = (optind < argc) ? atoi(argv[optind]) : 0;
+
+	if ((len = read_screen(cons, unicode, &buf, infile, &text, &rows, &cols)) < 0)
+		goto try_ioctl;
+
+	outbuf = (char *) text;
+	q      = outbuf + len;
 	goto done;
 
 try_ioctl : {
@@ -7,8 +7,11 @@
 #include <memory.h>
 #include <stdlib.h>
 #include <unistd.h>
+#include <fcntl.h>
+#include <errno.h>
 #include <sys/ioctl.h>
 #include <sysexits.h>
+#include <linux/vt.h>
 
 #include <kfont.h>
 
@@ -46,6 +49,54 @@ usage(int retcode, const struct kbd_help *options)
 	exit(retcode);
 }
 
+/*
+ * Opens every allocated console that is not in graphics mode. The kernel
+ * reports the state of the first 16 consoles only.
+ */
+static unsigned int
+open_all_consoles(struct kfont_context *kfont, int fd, int *fds, unsigned int size)
+{
+	struct vt_stat vtstat;
+	unsigned int i, n = 0;
+	int vtfd;
+
+	if (ioctl(fd, VT_GETSTATE, &vtstat))
+		kbd_error(EX_OSERR, errno, "ioctl VT_GETSTATE");
+
+	for (i = 1; i < 16 && n < size; i++) {
+		if (!(vtstat.v_state & (1 << i)))
+			continue;
+
+		if ((vtfd = kbd_open_text_vt(i, kfont_get_verbosity(kfont))) < 0)
+			continue;
+
+		fds[n++] = vtfd;
+	}
+
+	return n;
+}
+
+static int
+save_snapshot(struct kfont_context *kfont, int fd, const char *filename)
+{
+	unsigned char *blob;
+	size_t size;
+	FILE *fp;
+	int ret;
+
+	if ((ret = kfont_snapshot(kfont, fd, &blob, &size)) < 0)
+		return ret;
+
+	if (!(fp = fopen(filename, "w")))
+		kbd_error(EX_CANTCREAT, errno, _("Unable to open file: %s"), filename);
+
+	if (fwrite(blob, size, 1, fp) != 1 || fclose(fp))
+		kbd_error(EX_IOERR, errno, "%s", filename);
+
+	free(blob);
+	return 0;
+}
+
 enum kbd_getopt_arg {
 	kbd_no_argument,
 	kbd_required_argument
@@ -163,9 +214,14 @@ int main(int argc, char *argv[])
 {
 	const char *ifiles[MAXIFILES];
 	char *mfil, *ufil, *Ofil, *ofil, *omfil, *oufil, *console;
+	char *Sfil = NULL, *Lfil = NULL;
+	unsigned char *snapshot;
+	size_t snapshot_size;
 	int ifilct = 0, fd, no_m, no_u;
 	unsigned int iunit, hwunit;
-	int restore = 0;
+	int restore = 0, all_consoles = 0;
+	int fds[16];
+	unsigned int i, nfds;
 	int ret, c;
 
 	struct kfont_context *kfont;
@@ -177,9 +233,12 @@ int main(int argc, char *argv[])
 		{ "-om, --output-consolemap <FILE>", _("write current consolemap to <FILE>.") },
 		{ "-ou, --output-unicodemap <FILE>", _("write current unicodemap to <FILE>.") },
 		{ "-O, --output-fullfont <FILE>",    _("write current font and unicode map to <FILE>.") },
+		{ "-S, --snapshot <FILE>",           _("write current font, maps and palette to the snapshot <FILE>.") },
+		{ "-L, --load-snapshot <FILE>",      _("restore the font, maps and palette saved in the snapshot <FILE>.") },
 		{ "-m, --consolemap <FILE>",         _("load console screen map ('none' means don't load it).") },
 		{ "-u, --unicodemap <FILE>",         _("load font unicode map ('none' means don't load it).") },
 		{ "-C, --console <DEV>",             _("the console device to be used.") },
+		{ "-A, --all-consoles",              _("load the font into all allocated consoles.") },
 		{ "-d, --double",                    _("double size of font horizontally and vertically.") },
 		{ "-f, --force",                     _("force load unicode map.") },
 		{ "-R, --reset",                     _("reset the screen font, size, and unicode map to the bootup defaults.") },
@@ -201,9 +260,12 @@ int main(int argc, char *argv[])
 		{ "=ou", "output-unicodemap", kbd_required_argument, 'U' },
 		{ "=o",  "output-font",       kbd_required_argument, 'o' },
 		{ "=O",  "output-fullfont",   kbd_required_argument, 'O' },
+		{ "=S",  "snapshot",          kbd_required_argument, 'S' },
+		{ "=L",  "load-snapshot",     kbd_required_argument, 'L' },
 		{ "=m",  "consolemap",        kbd_required_argument, 'm' },
 		{ "=u",  "unicodemap",        kbd_required_argument, 'u' },
 		{ "=C",  "console",           kbd_required_argument, 'C' },
+		{ "=A",  "all-consoles",      kbd_no_argument,       'A' },
 		{ "+",   "default8x",         kbd_required_argument, 'N' },
 		{ NULL, NULL, 0, 0 },
 	};
@@ -263,9 +325,18 @@ int main(int argc, char *argv[])
 			case 'O':
 				Ofil = optarg;
 				break;
+			case 'S':
+				Sfil = optarg;
+				break;
+			case 'L':
+				Lfil = optarg;
+				break;
 			case 'C':
 				console = optarg;
 				break;
+			case 'A':
+				all_consoles = 1;
+				break;
 			case 'R':
 				restore = 1;
 				break;
@@ -301,11 +372,14 @@ int main(int argc, char *argv[])
 		kbd_error(EX_USAGE, 0, _("Cannot both restore from character ROM"
 					 " and from file. Font unchanged."));
 
+	if (Lfil && (ifilct || restore || mfil || ufil))
+		kbd_error(EX_USAGE, 0, _("A snapshot cannot be loaded together with a font or maps."));
+
 	if ((fd = getfd(console)) < 0)
 		kbd_error(EX_OSERR, 0, _("Couldn't get a file descriptor referring to the console."));
 
 	int kd_mode = -1;
-	if (!ioctl(fd, KDGETMODE, &kd_mode) && (kd_mode == KD_GRAPHICS)) {
+	if (!all_consoles && !ioctl(fd, KDGETMODE, &kd_mode) && (kd_mode == KD_GRAPHICS)) {
 		/*
 		 * PIO_FONT will fail on a console which is in foreground and in KD_GRAPHICS mode.
 		 * 2005-03-03, jw@suse.de.
@@ -317,7 +391,8 @@ int main(int argc, char *argv[])
 	}
 
 	if (!ifilct && !mfil && !ufil &&
-	    !Ofil && !ofil && !omfil && !oufil && !restore)
+	    !Ofil && !ofil && !omfil && !oufil && !restore &&
+	    !Sfil && !Lfil)
 		/* reset to some default */
 		ifiles[ifilct++] = "";
 
@@ -333,23 +408,46 @@ int main(int argc, char *argv[])
 	if (oufil && (ret = kfont_save_unicodemap(kfont, fd, oufil)) < 0)
 		return -ret;
 
+	if (Sfil && (ret = save_snapshot(kfont, fd, Sfil)) < 0)
+		return -ret;
+
+	if (all_consoles) {
+		nfds = open_all_consoles(kfont, fd, fds, sizeof(fds) / sizeof(fds[0]));
+	} else {
+		fds[0] = fd;
+		nfds   = 1;
+	}
+
 	if (mfil) {
-		if ((ret = kfont_load_consolemap(kfont, fd, mfil)) < 0)
+		if ((ret = kfont_load_consolemap_multi(kfont, fds, nfds, mfil)) < 0)
 			return -ret;
-		kfont_activatemap(fd);
+		for (i = 0; i < nfds; i++)
+			kfont_activatemap(fds[i]);
 		no_m = 1;
 	}
 
 	if (ufil)
 		no_u = 1;
 
-	if (restore)
-		kfont_restore_font(kfont, fd);
+	for (i = 0; restore && i < nfds; i++)
+		kfont_restore_font(kfont, fds[i]);
+
+	if (Lfil) {
+		snapshot = kbd_read_file(Lfil, &snapshot_size);
+
+		for (i = 0; i < nfds; i++) {
+			if ((ret = kfont_restore(kfont, fds[i], snapshot, snapshot_size)) < 0)
+				return -ret;
+			kfont_activatemap(fds[i]);
+		}
+
+		free(snapshot);
+	}
 
-	if (ifilct && (ret = kfont_load_fonts(kfont, fd, ifiles, ifilct, iunit, hwunit, no_m, no_u)) < 0)
+	if (ifilct && (ret = kfont_load_font_multi(kfont, fds, nfds, ifiles, ifilct, iunit, hwunit, no_m, no_u)) < 0)
 		return -ret;
 
-	if (ufil && (ret = kfont_load_unicodemap(kfont, fd, ufil)) < 0)
+	if (ufil && (ret = kfont_load_unicodemap_multi(kfont, fds, nfds, ufil)) < 0)
 		return -ret;
 
 	return EX_OK;
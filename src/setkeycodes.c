@@ -8,6 +8,7 @@
 #include "config.h"
 
 #include <stdio.h>
+#include <stdint.h>
 #include <stdlib.h>
 #include <string.h>
 #include <getopt.h>
@@ -20,6 +21,34 @@
 
 #include "libcommon.h"
 
+/*
+ * A precompiled table, as written by --output, is native-endian:
+ *
+ *   struct table_header
+ *   struct table_entry[nr_entries]
+ *
+ * The scancodes are in the kernel numbering, e0xx being 128 + xx.
+ */
+#define TABLE_MAGIC   "kbdkeyc"
+#define TABLE_VERSION 1
+
+struct table_header {
+	char magic[7];
+	uint8_t version;
+	uint32_t nr_entries;
+};
+
+struct table_entry {
+	uint32_t scancode;
+	uint32_t keycode;
+};
+
+struct table {
+	struct kbkeycode *entries;
+	size_t count;
+	size_t size;
+};
+
 static void KBD_ATTR_NORETURN
 usage(int rc, const struct kbd_help *options)
 {
@@ -67,24 +96,236 @@ str_to_uint(const char *str, int base, unsigned int *res)
 	return 0;
 }
 
+/* A later mapping of the same scancode replaces the earlier one. */
+static void
+table_add(struct table *t, unsigned int scancode, unsigned int keycode)
+{
+	size_t i;
+
+	for (i = 0; i < t->count; i++) {
+		if (t->entries[i].scancode == scancode) {
+			t->entries[i].keycode = keycode;
+			return;
+		}
+	}
+
+	if (t->count == t->size) {
+		t->size    = t->size ? t->size * 2 : 128;
+		t->entries = realloc(t->entries, t->size * sizeof(t->entries[0]));
+		if (!t->entries)
+			kbd_error(EX_OSERR, errno, "realloc");
+	}
+
+	t->entries[t->count].scancode = scancode;
+	t->entries[t->count].keycode  = keycode;
+	t->count++;
+}
+
+static int
+parse_pair(struct table *t, const char *scancode, const char *keycode)
+{
+	unsigned int sc, kc;
+
+	if (str_to_uint(scancode, 16, &sc) < 0)
+		return -1;
+
+	if (str_to_uint(keycode, 0, &kc) < 0)
+		return -1;
+
+	if (sc >= 0xe000) {
+		sc -= 0xe000;
+		sc += 128; /* some kernels needed +256 */
+	}
+#if 0
+	/* Test is OK up to 2.5.31--later kernels have more keycodes */
+	if (sc > 255 || kc > 127)
+		usage(_("code outside bounds"));
+
+	/* Both fields are unsigned int, so can be large;
+	   for current kernels the correct test might be
+	     (sc > 255 || kc > 239)
+	   but we can leave testing to the kernel. */
+#endif
+
+	table_add(t, sc, kc);
+	return 0;
+}
+
+static int
+read_binary_table(struct table *t, const unsigned char *data, size_t len)
+{
+	struct table_header hdr;
+	struct table_entry e;
+	uint32_t i;
+
+	if (len < sizeof(hdr))
+		return -1;
+
+	memcpy(&hdr, data, sizeof(hdr));
+	data += sizeof(hdr);
+	len -= sizeof(hdr);
+
+	if (memcmp(hdr.magic, TABLE_MAGIC, sizeof(hdr.magic)) ||
+	    hdr.version != TABLE_VERSION ||
+	    len != (size_t) hdr.nr_entries * sizeof(e))
+		return -1;
+
+	for (i = 0; i < hdr.nr_entries; i++) {
+		memcpy(&e, data, sizeof(e));
+		data += sizeof(e);
+		table_add(t, e.scancode, e.keycode);
+	}
+
+	return 0;
+}
+
+/* Lines of "scancode keycode", as given on the command line or printed by getkeycodes --raw. */
+static int
+read_text_table(struct table *t, FILE *fp, const char *filename)
+{
+	char *line = NULL, *p, *scancode, *keycode;
+	size_t linesz = 0;
+	unsigned int lineno = 0;
+	int rc = 0;
+
+	while (!rc && getline(&line, &linesz, fp) != -1) {
+		lineno++;
+
+		if ((p = strchr(line, '#')))
+			*p = '\0';
+
+		if (!(scancode = strtok(line, " \t\n")))
+			continue;
+
+		keycode = strtok(NULL, " \t\n");
+
+		if (!keycode || strtok(NULL, " \t\n")) {
+			kbd_warning(0, _("%s:%u: expected a scancode and a keycode"), filename, lineno);
+			rc = -1;
+		} else if (parse_pair(t, scancode, keycode) < 0) {
+			kbd_warning(0, _("%s:%u: invalid line"), filename, lineno);
+			rc = -1;
+		}
+	}
+
+	free(line);
+	return rc;
+}
+
+/* The input may be a pipe, so it is read whole before looking at the magic. */
+static int
+read_table(struct table *t, const char *filename)
+{
+	unsigned char *data;
+	size_t len;
+	FILE *fp;
+	int rc;
+
+	data = kbd_read_file(filename, &len);
+
+	if (len >= sizeof(TABLE_MAGIC) - 1 && !memcmp(data, TABLE_MAGIC, sizeof(TABLE_MAGIC) - 1)) {
+		if ((rc = read_binary_table(t, data, len)) < 0)
+			kbd_warning(0, _("%s: bad keycode table"), filename);
+	} else if (!(fp = fmemopen(data, len, "r"))) {
+		kbd_error(EX_OSERR, errno, "fmemopen");
+	} else {
+		rc = read_text_table(t, fp, filename);
+		fclose(fp);
+	}
+
+	free(data);
+	return rc;
+}
+
+static void
+write_table(const struct table *t, const char *filename)
+{
+	struct table_header hdr;
+	struct table_entry e;
+	size_t i;
+	FILE *fp;
+
+	if (!(fp = fopen(filename, "w")))
+		kbd_error(EX_CANTCREAT, errno, _("Unable to open file: %s"), filename);
+
+	memset(&hdr, 0, sizeof(hdr));
+	memcpy(hdr.magic, TABLE_MAGIC, sizeof(hdr.magic));
+	hdr.version    = TABLE_VERSION;
+	hdr.nr_entries = (uint32_t) t->count;
+
+	if (fwrite(&hdr, sizeof(hdr), 1, fp) != 1)
+		kbd_error(EX_IOERR, errno, "%s", filename);
+
+	for (i = 0; i < t->count; i++) {
+		e.scancode = t->entries[i].scancode;
+		e.keycode  = t->entries[i].keycode;
+
+		if (fwrite(&e, sizeof(e), 1, fp) != 1)
+			kbd_error(EX_IOERR, errno, "%s", filename);
+	}
+
+	if (fclose(fp))
+		kbd_error(EX_IOERR, errno, "%s", filename);
+}
+
+/*
+ * The kernel has no bulk interface for the scancode table, so the least
+ * work is to read back only the scancodes of the table and to set those
+ * whose keycode differs.
+ */
+static size_t
+apply_table(int fd, const struct table *t)
+{
+	struct kbkeycode a;
+	size_t i, changed = 0;
+
+	for (i = 0; i < t->count; i++) {
+		a.scancode = t->entries[i].scancode;
+		a.keycode  = 0;
+
+		if (!ioctl(fd, KDGETKEYCODE, &a) && a.keycode == t->entries[i].keycode)
+			continue;
+
+		a.keycode = t->entries[i].keycode;
+
+		if (ioctl(fd, KDSETKEYCODE, &a)) {
+			kbd_error(EXIT_FAILURE, errno,
+			          _("failed to set scancode %x to keycode %d: ioctl KDSETKEYCODE"),
+			          a.scancode, a.keycode);
+		}
+		changed++;
+	}
+
+	return changed;
+}
+
 int main(int argc, char **argv)
 {
 	int fd, c;
-	struct kbkeycode a;
+	struct table table = { NULL, 0, 0 };
 	char *console = NULL;
+	const char *file = NULL, *output = NULL;
+	int verbose = 0;
+	size_t changed;
 
 	set_progname(argv[0]);
 	setuplocale();
 
-	const char *short_opts = "C:hV";
+	const char *short_opts = "C:f:o:vhV";
 	const struct option long_opts[] = {
 		{ "console", required_argument, NULL, 'C' },
+		{ "file",    required_argument, NULL, 'f' },
+		{ "output",  required_argument, NULL, 'o' },
+		{ "verbose", no_argument,       NULL, 'v' },
 		{ "help",    no_argument,       NULL, 'h' },
 		{ "version", no_argument,       NULL, 'V' },
 		{ NULL,      0,                 NULL,  0  }
 	};
 	const struct kbd_help opthelp[] = {
 		{ "-C, --console=DEV", _("the console device to be used.") },
+		{ "-f, --file=TABLE",  _("read the scancode keycode pairs from TABLE (- for stdin).") },
+		{ "-o, --output=FILE", _("write a precompiled table to FILE instead of loading it.") },
+		{ "-v, --verbose",     _("report how many scancodes were changed.") },
 		{ "-V, --version",     _("print version number.")     },
 		{ "-h, --help",        _("print this usage message.") },
 		{ NULL, NULL }
@@ -97,6 +338,15 @@ int main(int argc, char **argv)
 					usage(EX_USAGE, opthelp);
 				console = optarg;
 				break;
+			case 'f':
+				file = optarg;
+				break;
+			case 'o':
+				output = optarg;
+				break;
+			case 'v':
+				verbose = 1;
+				break;
 			case 'V':
 				print_version_and_exit();
 				break;
@@ -109,42 +359,39 @@ int main(int argc, char **argv)
 		}
 	}
 
-	if (optind == argc) {
+	if (optind == argc && !file) {
 		kbd_warning(0, _("Not enough arguments."));
 		usage(EX_USAGE, opthelp);
 	}
 
-	if ((fd = getfd(console)) < 0)
-		kbd_error(EX_OSERR, 0, _("Couldn't get a file descriptor referring to the console."));
+	if (file && read_table(&table, file) < 0)
+		return EX_DATAERR;
 
-	while (argc > 2) {
-		if (str_to_uint(argv[1], 16, &a.scancode) < 0)
+	while (optind + 1 < argc) {
+		if (parse_pair(&table, argv[optind], argv[optind + 1]) < 0)
 			return EX_DATAERR;
+		optind += 2;
+	}
 
-		if (str_to_uint(argv[2], 0, &a.keycode) < 0)
-			return EX_DATAERR;
+	if (optind < argc) {
+		kbd_warning(0, _("Missing keycode for scancode: %s"), argv[optind]);
+		usage(EX_USAGE, opthelp);
+	}
 
-		if (a.scancode >= 0xe000) {
-			a.scancode -= 0xe000;
-			a.scancode += 128; /* some kernels needed +256 */
-		}
-#if 0
-		/* Test is OK up to 2.5.31--later kernels have more keycodes */
-		if (a.scancode > 255 || a.keycode > 127)
-			usage(_("code outside bounds"));
-
-		/* Both fields are unsigned int, so can be large;
-		   for current kernels the correct test might be
-		     (a.scancode > 255 || a.keycode > 239)
-		   but we can leave testing to the kernel. */
-#endif
-		if (ioctl(fd, KDSETKEYCODE, &a)) {
-			kbd_error(EXIT_FAILURE, errno,
-			          _("failed to set scancode %x to keycode %d: ioctl KDSETKEYCODE"),
-			          a.scancode, a.keycode);
-		}
-		argc -= 2;
-		argv += 2;
+	if (output) {
+		write_table(&table, output);
+		free(table.entries);
+		return EX_OK;
 	}
+
+	if ((fd = getfd(console)) < 0)
+		kbd_error(EX_OSERR, 0, _("Couldn't get a file descriptor referring to the console."));
+
+	changed = apply_table(fd, &table);
+
+	if (verbose)
+		printf(_("%zu of %zu scancodes changed\n"), changed, table.count);
+
+	free(table.entries);
 	return EX_OK;
 }
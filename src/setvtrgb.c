@@ -14,28 +14,6 @@
 
 static unsigned char cmap[3 * 16];
 
-/* Standard VGA terminal colors, matching those hardcoded in the Linux kernel's
- * drivers/char/vt.c
- */
-static unsigned char vga_colors[] = {
-	0x00, 0x00, 0x00,
-	0xaa, 0x00, 0x00,
-	0x00, 0xaa, 0x00,
-	0xaa, 0x55, 0x00,
-	0x00, 0x00, 0xaa,
-	0xaa, 0x00, 0xaa,
-	0x00, 0xaa, 0xaa,
-	0xaa, 0xaa, 0xaa,
-	0x55, 0x55, 0x55,
-	0xff, 0x55, 0x55,
-	0x55, 0xff, 0x55,
-	0xff, 0xff, 0x55,
-	0x55, 0x55, 0xff,
-	0xff, 0x55, 0xff,
-	0x55, 0xff, 0xff,
-	0xff, 0xff, 0xff,
-};
-
 static void KBD_ATTR_NORETURN
 usage(int rc, const struct kbd_help *options)
 {
@@ -65,82 +43,11 @@ usage(int rc, const struct kbd_help *options)
 	exit(rc);
 }
 
-static void
-parse_dec_file(FILE *fd, const char *filename)
-{
-	int c;
-	unsigned int rows, cols, val;
-
-	for (rows = 0; rows < 3; rows++) {
-		for (cols = 0; cols < 16; cols++) {
-			if ((c = fscanf(fd, "%u", &val)) != 1) {
-				if (c == EOF)
-					kbd_error(EXIT_FAILURE, errno, "fscanf");
-
-				kbd_error(EXIT_FAILURE, 0, _("Error: %s: Invalid value in field %u in line %u."),
-				          filename, rows + 1, cols + 1);
-			}
-
-			cmap[rows + cols * 3] = (unsigned char)val;
-
-			if (cols < 15 && fgetc(fd) != ',')
-				kbd_error(EXIT_FAILURE, 0, _("Error: %s: Insufficient number of fields in line %u."),
-				          filename, rows + 1);
-		}
-
-		if ((c = fgetc(fd)) == EOF)
-			kbd_error(EXIT_FAILURE, 0, _("Error: %s: Line %u has ended unexpectedly."),
-			          filename, rows + 1);
-
-		if (c != '\n')
-			kbd_error(EXIT_FAILURE, 0, _("Error: %s: Line %u is too long."),
-			          filename, rows + 1);
-	}
-}
-
-static void
-parse_hex_file(FILE *fd, const char *filename)
-{
-	int c,l;
-	unsigned int r, g, b;
-
-	for (l = 0; l < 16; l++) {
-		if ((c = fscanf(fd, "#%2x%2x%2x\n", &r, &g, &b)) != 3) {
-			if (c == EOF)
-				kbd_error(EXIT_FAILURE, 0, _("Error: %s: Insufficient number of colors/lines: %u"),
-				          filename, l);
-
-			kbd_error(EXIT_FAILURE, 0, _("Error: %s: Invalid value in line %u."),
-			          filename, l + 1);
-		}
-
-		cmap[l * 3]     = (unsigned char)r;
-		cmap[l * 3 + 1] = (unsigned char)g;
-		cmap[l * 3 + 2] = (unsigned char)b;
-	}
-}
-
-static void
-parse_file(FILE *fd, const char *filename)
-{
-	int c = fgetc(fd);
-
-	if (c == EOF)
-		kbd_error(EXIT_FAILURE, 0, _("Error: %s: File ended unexpectedly."),
-		          filename);
-	ungetc(c, fd);
-
-	if (c == '#')
-		parse_hex_file(fd, filename);
-	else
-		parse_dec_file(fd, filename);
-}
-
 int main(int argc, char **argv)
 {
 	int c, fd;
 	const char *file;
-	unsigned char *colormap = cmap;
+	const unsigned char *colormap = cmap;
 	FILE *f;
 	const char *console = NULL;
 
@@ -186,16 +93,16 @@ int main(int argc, char **argv)
 	file = argv[optind];
 
 	if (!strcmp(file, "vga")) {
-		colormap = vga_colors;
+		colormap = kbd_vga_colors;
 
 	} else if (!strcmp(file, "-")) {
-		parse_file(stdin, "stdin");
+		kbd_parse_vtrgb(stdin, "stdin", cmap);
 
 	} else {
 		if ((f = fopen(file, "r")) == NULL)
 			kbd_error(EXIT_FAILURE, errno, "fopen");
 
-		parse_file(f, file);
+		kbd_parse_vtrgb(f, file, cmap);
 		fclose(f);
 	}
 
@@ -83,6 +83,57 @@ watch_dog(int x KBD_ATTR_UNUSED)
 	exit(EXIT_SUCCESS);
 }
 
+static void
+print_event(const struct kbd_key_event *ev, void *data)
+{
+	unsigned long long *last = data;
+
+	printf(_("keycode %3d %s"), ev->keycode, ev->pressed ? _("press") : _("release"));
+	if (*last)
+		printf("  +%.3f ms", (double) (ev->time - *last) / 1000000.0);
+	printf("\n");
+	fflush(stdout);
+
+	*last = ev->time;
+}
+
+/*
+ * Reads the events in non-blocking batches as soon as poll() reports them
+ * and stamps each read with the monotonic clock. It needs the keycodes, so
+ * it cannot be used with --scancodes or --ascii. The program terminates
+ * when there is no input for TIMEOUT seconds and then prints the report.
+ */
+static void KBD_ATTR_NORETURN
+measure_latency(int timeout)
+{
+	struct kbd_key_timing kt;
+	struct kbd_series_stats st;
+	unsigned long long last = 0;
+
+	memset(&kt, 0, sizeof(kt));
+
+	if (fcntl(fd, F_SETFL, fcntl(fd, F_GETFL) | O_NONBLOCK) < 0)
+		kbd_error(EXIT_FAILURE, errno, "fcntl");
+
+	printf(_("press and hold keys (program terminates %ds after last keypress)...\n"), timeout);
+
+	if (kbd_key_timing_read(&kt, fd, timeout, print_event, &last) < 0)
+		kbd_error(EXIT_FAILURE, errno, "read");
+
+	clean_up();
+
+	printf("\n");
+	kbd_series_print(&kt.events, _("Interval between events"));
+	kbd_series_print(&kt.delays, _("Autorepeat delay"));
+	kbd_series_print(&kt.repeats, _("Autorepeat period"));
+
+	if (kbd_series_stats(&kt.repeats, &st) == 0 && st.mean > 0)
+		printf(_("Autorepeat rate %.1f cps\n"), 1000.0 / st.mean);
+
+	kbd_key_timing_free(&kt);
+	exit(EXIT_SUCCESS);
+}
+
 static void KBD_ATTR_NORETURN
 usage(int rc, const struct kbd_help *options)
 {
@@ -96,12 +147,13 @@ usage(int rc, const struct kbd_help *options)
 
 int main(int argc, char *argv[])
 {
-	const char *short_opts          = "haskVt:";
+	const char *short_opts          = "hasklVt:";
 	const struct option long_opts[] = {
 		{ "help", no_argument, NULL, 'h' },
 		{ "ascii", no_argument, NULL, 'a' },
 		{ "scancodes", no_argument, NULL, 's' },
 		{ "keycodes", no_argument, NULL, 'k' },
+		{ "latency", no_argument, NULL, 'l' },
 		{ "timeout", required_argument, NULL, 't' },
 		{ "version", no_argument, NULL, 'V' },
 		{ NULL, 0, NULL, 0 }
@@ -109,6 +161,7 @@ int main(int argc, char *argv[])
 	int c;
 	int show_keycodes = 1;
 	int print_ascii   = 0;
+	int latency       = 0;
 	int timeout = 10;
 
 	struct termios new = { 0 };
@@ -123,6 +176,7 @@ int main(int argc, char *argv[])
 		{ "-a, --ascii",     _("display the decimal/octal/hex values of the keys.") },
 		{ "-s, --scancodes", _("display only the raw scan-codes.") },
 		{ "-k, --keycodes",  _("display only the interpreted keycodes (default).") },
+		{ "-l, --latency",   _("measure the timing of the keycodes and the autorepeat (not with -s or -a).") },
 		{ "-t, --timeout",   _("set timeout, default 10")     },
 		{ "-h, --help",      _("print this usage message.") },
 		{ "-V, --version",   _("print version number.")     },
@@ -140,6 +194,9 @@ int main(int argc, char *argv[])
 			case 'a':
 				print_ascii = 1;
 				break;
+			case 'l':
+				latency = 1;
+				break;
 			case 'V':
 				print_version_and_exit();
 				break;
@@ -161,6 +218,10 @@ int main(int argc, char *argv[])
 	if (optind < argc)
 		usage(EX_USAGE, opthelp);
 
+	if (latency && (print_ascii || !show_keycodes))
+		kbd_error(EX_USAGE, 0, _("Options %s and %s are mutually exclusive."),
+		          "--latency", print_ascii ? "--ascii" : "--scancodes");
+
 	if (print_ascii) {
 		/* no mode and signal and timer stuff - just read stdin */
 		fd = 0;
@@ -240,12 +301,21 @@ int main(int argc, char *argv[])
 	new.c_cc[VMIN]  = sizeof(buf);
 	new.c_cc[VTIME] = 1; /* 0.1 sec intercharacter timeout */
 
+	/* wake up on the first byte, do not wait for more */
+	if (latency) {
+		new.c_cc[VMIN]  = 1;
+		new.c_cc[VTIME] = 0;
+	}
+
 	if (tcsetattr(fd, TCSAFLUSH, &new) == -1)
 		kbd_warning(errno, "tcsetattr");
 	if (ioctl(fd, KDSKBMODE, show_keycodes ? K_MEDIUMRAW : K_RAW)) {
 		kbd_error(EXIT_FAILURE, errno, "ioctl KDSKBMODE");
 	}
 
+	if (latency)
+		measure_latency(timeout);
+
 	printf(_("press any key (program terminates %ds after last keypress)...\n"), timeout);
 
 	/* show scancodes */
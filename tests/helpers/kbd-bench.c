@@ -0,0 +1,379 @@
+#define _GNU_SOURCE /* nftw() */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <errno.h>
+#include <limits.h>
+#include <ftw.h>
+#include <time.h>
+#include <sys/stat.h>
+
+#include <keymap.h>
+#include <kfont.h>
+
+#include "libcommon.h"
+
+/*
+ * Allocation counters. With glibc the allocator is replaced by thin wrappers
+ * around the libc one, so that the allocations made inside the libraries are
+ * counted too. Elsewhere the counters stay at zero.
+ */
+static unsigned long alloc_calls;
+static unsigned long alloc_bytes;
+
+#ifdef __GLIBC__
+extern void *__libc_malloc(size_t size);
+extern void *__libc_calloc(size_t nmemb, size_t size);
+extern void *__libc_realloc(void *ptr, size_t size);
+extern void __libc_free(void *ptr);
+
+void *
+malloc(size_t size)
+{
+	alloc_calls++;
+	alloc_bytes += size;
+	return __libc_malloc(size);
+}
+
+void *
+calloc(size_t nmemb, size_t size)
+{
+	alloc_calls++;
+	alloc_bytes += nmemb * size;
+	return __libc_calloc(nmemb, size);
+}
+
+void *
+realloc(void *ptr, size_t size)
+{
+	alloc_calls++;
+	alloc_bytes += size;
+	return __libc_realloc(ptr, size);
+}
+
+void
+free(void *ptr)
+{
+	__libc_free(ptr);
+}
+#endif
+
+struct bench {
+	const char *name;
+	unsigned long files;
+	unsigned long failed;
+	unsigned long long nsec;
+	unsigned long allocs;
+	unsigned long bytes;
+};
+
+struct sample {
+	struct timespec start;
+	unsigned long allocs;
+	unsigned long bytes;
+};
+
+static void
+sample_start(struct sample *s)
+{
+	s->allocs = alloc_calls;
+	s->bytes  = alloc_bytes;
+	clock_gettime(CLOCK_MONOTONIC, &s->start);
+}
+
+static void
+sample_stop(struct sample *s, struct bench *b, int ok)
+{
+	struct timespec end;
+
+	clock_gettime(CLOCK_MONOTONIC, &end);
+
+	b->nsec += (unsigned long long) (end.tv_sec - s->start.tv_sec) * 1000000000ULL;
+	b->nsec += (unsigned long long) end.tv_nsec;
+	b->nsec -= (unsigned long long) s->start.tv_nsec;
+
+	b->allocs += alloc_calls - s->allocs;
+	b->bytes += alloc_bytes - s->bytes;
+
+	b->files++;
+	if (!ok)
+		b->failed++;
+}
+
+static void
+print_bench(const struct bench *b, unsigned int iterations)
+{
+	printf("{\"bench\":\"%s\",\"iterations\":%u,\"files\":%lu,\"failed\":%lu,"
+	       "\"nsec\":%llu,\"allocs\":%lu,\"alloc_bytes\":%lu}\n",
+	       b->name, iterations, b->files, b->failed,
+	       b->nsec, b->allocs, b->bytes);
+}
+
+/* Files found by nftw(), sorted to get the same order on every run. */
+static char **files;
+static size_t nfiles;
+static size_t files_size;
+static const char *files_suffix;
+
+static int
+collect_file(const char *fpath, const struct stat *sb KBD_ATTR_UNUSED,
+             int typeflag, struct FTW *ftwbuf KBD_ATTR_UNUSED)
+{
+	size_t len;
+
+	if (typeflag != FTW_F)
+		return 0;
+
+	len = strlen(fpath);
+
+	if (files_suffix) {
+		size_t slen = strlen(files_suffix);
+
+		if (len < slen || strcmp(fpath + len - slen, files_suffix))
+			return 0;
+	} else if (strstr(fpath, "README")) {
+		return 0;
+	}
+
+	if (nfiles == files_size) {
+		files_size = files_size ? files_size * 2 : 256;
+		files = realloc(files, files_size * sizeof(char *));
+		if (!files)
+			kbd_error(EXIT_FAILURE, errno, "realloc");
+	}
+
+	if (!(files[nfiles++] = strdup(fpath)))
+		kbd_error(EXIT_FAILURE, errno, "strdup");
+
+	return 0;
+}
+
+static int
+compare_files(const void *a, const void *b)
+{
+	return strcmp(*(char *const *) a, *(char *const *) b);
+}
+
+static void
+collect_files(const char *datadir, const char *subdir, const char *suffix)
+{
+	char path[PATH_MAX];
+
+	while (nfiles > 0)
+		free(files[--nfiles]);
+
+	snprintf(path, sizeof(path), "%s/%s", datadir, subdir);
+
+	files_suffix = suffix;
+
+	if (nftw(path, collect_file, 16, FTW_PHYS) < 0)
+		kbd_error(EXIT_FAILURE, errno, "%s", path);
+
+	qsort(files, nfiles, sizeof(char *), compare_files);
+}
+
+static struct bench bench_keymaps = { .name = "keymaps" };
+static struct bench bench_bkeymap = { .name = "bkeymap" };
+static struct bench bench_ctable  = { .name = "ctable" };
+static struct bench bench_fonts   = { .name = "consolefonts" };
+static struct bench bench_unimaps = { .name = "unimaps" };
+static struct bench bench_trans   = { .name = "consoletrans" };
+
+static void
+run_keymaps(struct kbdfile_ctx *kbdfile_ctx, FILE *null)
+{
+	struct sample s;
+	struct lk_ctx *ctx;
+	struct kbdfile *fp;
+	size_t i;
+	int rc;
+
+	for (i = 0; i < nfiles; i++) {
+		sample_start(&s);
+
+		ctx = lk_init();
+		lk_set_log_fn(ctx, NULL, NULL);
+
+		fp = kbdfile_open(kbdfile_ctx, files[i]);
+		rc = fp ? lk_parse_keymap(ctx, fp) : -1;
+
+		sample_stop(&s, &bench_keymaps, rc == 0);
+
+		if (rc == 0) {
+			sample_start(&s);
+			rc = lk_dump_bkeymap(ctx, null);
+			sample_stop(&s, &bench_bkeymap, rc == 0);
+
+			sample_start(&s);
+			rc = lk_dump_ctable(ctx, null);
+			sample_stop(&s, &bench_ctable, rc == 0);
+		}
+
+		kbdfile_free(fp);
+		lk_free(ctx);
+	}
+}
+
+static void
+run_consolefonts(struct kfont_context *ctx, struct kbdfile_ctx *kbdfile_ctx)
+{
+	struct sample s;
+	struct kbdfile *fp;
+	unsigned char *buf, *fontbuf;
+	unsigned int bufsz, fontsz, width, height, fontlen;
+	struct unicode_list *uclistheads;
+	size_t i;
+	int rc;
+
+	for (i = 0; i < nfiles; i++) {
+		sample_start(&s);
+
+		buf         = NULL;
+		uclistheads = NULL;
+
+		fp = kbdfile_open(kbdfile_ctx, files[i]);
+		rc = fp ? kfont_read_psffont(ctx, kbdfile_get_file(fp), &buf, &bufsz,
+		                             &fontbuf, &fontsz, &width, &height,
+		                             &fontlen, 0, &uclistheads)
+		        : -1;
+
+		/* The sequences of the Unicode table are left behind, as in setfont. */
+		kbdfile_free(fp);
+		free(buf);
+		free(uclistheads);
+
+		sample_stop(&s, &bench_fonts, rc >= 0);
+	}
+}
+
+static void
+run_unimaps(struct kfont_context *ctx)
+{
+	struct sample s;
+	size_t i;
+	int rc;
+
+	for (i = 0; i < nfiles; i++) {
+		sample_start(&s);
+		rc = kfont_load_unicodemap(ctx, 0, files[i]);
+		sample_stop(&s, &bench_unimaps, rc >= 0);
+	}
+}
+
+static void
+run_consoletrans(struct kfont_context *ctx)
+{
+	struct sample s;
+	size_t i;
+	int rc;
+
+	for (i = 0; i < nfiles; i++) {
+		sample_start(&s);
+		rc = kfont_load_consolemap(ctx, 0, files[i]);
+		sample_stop(&s, &bench_trans, rc >= 0);
+	}
+}
+
+static void
+quiet_logger(struct kfont_context *ctx KBD_ATTR_UNUSED, int priority KBD_ATTR_UNUSED,
+             const char *file KBD_ATTR_UNUSED, int line KBD_ATTR_UNUSED,
+             const char *fn KBD_ATTR_UNUSED, const char *format KBD_ATTR_UNUSED,
+             va_list args KBD_ATTR_UNUSED)
+{
+}
+
+static const struct kfont_console_ops fake_console_ops = {
+	.ioctl = kbd_fake_console_ioctl,
+};
+
+static void KBD_ATTR_NORETURN
+usage(int rc)
+{
+	fprintf(stderr, "Usage: %s [-n iterations] datadir\n", get_progname());
+	exit(rc);
+}
+
+int main(int argc, char **argv)
+{
+	set_progname(argv[0]);
+
+	struct kbdfile_ctx *kbdfile_ctx;
+	struct kfont_context *kfont_ctx;
+	struct kbd_fake_console *con;
+	const char *datadir;
+	unsigned int n, iterations = 1;
+	FILE *null;
+	int c;
+
+	while ((c = getopt(argc, argv, "n:h")) != EOF) {
+		switch (c) {
+			case 'n':
+				iterations = (unsigned int) strtoul(optarg, NULL, 10);
+				if (!iterations)
+					usage(EXIT_FAILURE);
+				break;
+			case 'h':
+				usage(EXIT_SUCCESS);
+			default:
+				usage(EXIT_FAILURE);
+		}
+	}
+
+	if (optind + 1 != argc)
+		usage(EXIT_FAILURE);
+
+	datadir = argv[optind];
+
+	if ((kbdfile_ctx = kbdfile_context_new()) == NULL)
+		kbd_error(EXIT_FAILURE, errno, "kbdfile_context_new");
+
+	kbdfile_set_log_priority(kbdfile_ctx, 0);
+
+	if (kfont_init(get_progname(), &kfont_ctx) < 0)
+		kbd_error(EXIT_FAILURE, 0, "kfont_init");
+
+	kfont_set_logger(kfont_ctx, quiet_logger);
+
+	/* Maps are loaded into a fake console, so that no VT is needed. */
+	if ((con = kbd_fake_console_new()) == NULL)
+		kbd_error(EXIT_FAILURE, errno, "kbd_fake_console_new");
+
+	kfont_set_console_ops(kfont_ctx, &fake_console_ops, con);
+
+	if ((null = fopen("/dev/null", "w")) == NULL)
+		kbd_error(EXIT_FAILURE, errno, "/dev/null");
+
+	for (n = 0; n < iterations; n++) {
+		collect_files(datadir, "keymaps", ".map");
+		run_keymaps(kbdfile_ctx, null);
+
+		collect_files(datadir, "consolefonts", NULL);
+		run_consolefonts(kfont_ctx, kbdfile_ctx);
+
+		collect_files(datadir, "unimaps", NULL);
+		run_unimaps(kfont_ctx);
+
+		collect_files(datadir, "consoletrans", NULL);
+		run_consoletrans(kfont_ctx);
+	}
+
+	print_bench(&bench_keymaps, iterations);
+	print_bench(&bench_bkeymap, iterations);
+	print_bench(&bench_ctable, iterations);
+	print_bench(&bench_fonts, iterations);
+	print_bench(&bench_unimaps, iterations);
+	print_bench(&bench_trans, iterations);
+
+	while (nfiles > 0)
+		free(files[--nfiles]);
+	free(files);
+
+	fclose(null);
+	kbd_fake_console_free(con);
+	kfont_free(kfont_ctx);
+	kbdfile_context_free(kbdfile_ctx);
+
+	return EXIT_SUCCESS;
+}
@@ -0,0 +1,150 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <fcntl.h>
+
+#include "libcommon.h"
+
+#define MS 1000000ULL
+
+static void
+check_event(const struct kbd_key_event *ev, unsigned int keycode, int pressed)
+{
+	if (ev->keycode != keycode || ev->pressed != pressed)
+		kbd_error(EXIT_FAILURE, 0, "Got keycode %u %s, expected %u %s",
+		          ev->keycode, ev->pressed ? "press" : "release",
+		          keycode, pressed ? "press" : "release");
+}
+
+static void
+check_series(const struct kbd_series *s, size_t count, unsigned long long value)
+{
+	size_t i;
+
+	if (s->count != count)
+		kbd_error(EXIT_FAILURE, 0, "Got %zu samples, expected %zu", s->count, count);
+
+	for (i = 0; i < count; i++) {
+		if (s->values[i] != value)
+			kbd_error(EXIT_FAILURE, 0, "Sample %zu is %llu, expected %llu",
+			          i, s->values[i], value);
+	}
+}
+
+static void
+add(struct kbd_key_timing *kt, unsigned long long time, unsigned int keycode, int pressed)
+{
+	struct kbd_key_event ev;
+
+	ev.time    = time;
+	ev.keycode = keycode;
+	ev.pressed = pressed;
+
+	kbd_key_timing_add(kt, &ev);
+}
+
+static void
+count_event(const struct kbd_key_event *ev KBD_ATTR_UNUSED, void *data)
+{
+	(*(size_t *) data)++;
+}
+
+int
+main(int argc KBD_ATTR_UNUSED, char **argv)
+{
+	set_progname(argv[0]);
+
+	struct kbd_key_event events[16];
+	struct kbd_key_timing kt;
+	size_t n, used, nr_events;
+	int fds[2];
+
+	/* a 3-byte report for a keycode above 127, the last one cut short */
+	const unsigned char reports[] = {
+		0x1e, 0x9e,
+		0x00, 0x81, 0x00,
+		0x80, 0x82, 0x2c,
+		0x00, 0x81,
+	};
+	const unsigned char rest[] = { 0x01 };
+	unsigned char resumed[3];
+
+	n = kbd_decode_mediumraw(reports, sizeof(reports), &used, 5, events);
+
+	if (n != 4 || used != 8)
+		kbd_error(EXIT_FAILURE, 0, "Decoded %zu events from %zu bytes", n, used);
+
+	check_event(&events[0], 30, 1);
+	check_event(&events[1], 30, 0);
+	check_event(&events[2], 128, 1);
+	check_event(&events[3], 300, 0);
+
+	if (events[3].time != 5)
+		kbd_error(EXIT_FAILURE, 0, "Event was not stamped");
+
+	/* the unused bytes come first in the next read */
+	memcpy(resumed, reports + used, sizeof(reports) - used);
+	memcpy(resumed + sizeof(reports) - used, rest, sizeof(rest));
+
+	n = kbd_decode_mediumraw(resumed, sizeof(resumed), &used, 5, events);
+
+	if (n != 1 || used != 3)
+		kbd_error(EXIT_FAILURE, 0, "Decoded %zu events from the rest", n);
+
+	check_event(&events[0], 129, 1);
+
+	/* a held key: a delay, then two repeats; then a held 3-byte key */
+	memset(&kt, 0, sizeof(kt));
+
+	add(&kt, 1000 * MS, 30, 1);
+	add(&kt, 1250 * MS, 30, 1);
+	add(&kt, 1283 * MS, 30, 1);
+	add(&kt, 1316 * MS, 30, 1);
+	add(&kt, 1320 * MS, 30, 0);
+	add(&kt, 1400 * MS, 300, 1);
+	add(&kt, 1650 * MS, 300, 1);
+	add(&kt, 1683 * MS, 300, 1);
+	add(&kt, 1700 * MS, 300, 0);
+
+	/* a press after the release is not a repeat */
+	add(&kt, 1800 * MS, 300, 1);
+	add(&kt, 1900 * MS, 300, 0);
+
+	/* neither is a press of the first key again after another key */
+	add(&kt, 2000 * MS, 30, 1);
+	add(&kt, 2100 * MS, 31, 1);
+	add(&kt, 2200 * MS, 30, 1);
+
+	if (kt.events.count != 13)
+		kbd_error(EXIT_FAILURE, 0, "Got %zu intervals between events", kt.events.count);
+
+	check_series(&kt.delays, 2, 250 * MS);
+	check_series(&kt.repeats, 3, 33 * MS);
+
+	kbd_key_timing_free(&kt);
+
+	/* the reports of a pipe, up to its hangup */
+	if (pipe(fds) < 0 || fcntl(fds[0], F_SETFL, O_NONBLOCK) < 0)
+		kbd_error(EXIT_FAILURE, 0, "Unable to create pipe");
+
+	if (write(fds[1], reports, sizeof(reports)) != sizeof(reports) ||
+	    write(fds[1], rest, sizeof(rest)) != sizeof(rest))
+		kbd_error(EXIT_FAILURE, 0, "Unable to write to pipe");
+
+	close(fds[1]);
+
+	memset(&kt, 0, sizeof(kt));
+	nr_events = 0;
+
+	if (kbd_key_timing_read(&kt, fds[0], 1, count_event, &nr_events) < 0)
+		kbd_error(EXIT_FAILURE, 0, "Unable to read the pipe");
+
+	if (nr_events != 5 || kt.events.count != 4)
+		kbd_error(EXIT_FAILURE, 0, "Read %zu events", nr_events);
+
+	kbd_key_timing_free(&kt);
+	close(fds[0]);
+
+	return EXIT_SUCCESS;
+}
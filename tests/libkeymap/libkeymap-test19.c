@@ -0,0 +1,57 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+
+#include <keymap.h>
+#include "libcommon.h"
+
+int
+main(int argc KBD_ATTR_UNUSED, char **argv)
+{
+	set_progname(argv[0]);
+
+	int i;
+	char *buf   = NULL;
+	size_t size = 0;
+	ssize_t len;
+	char expect[65536];
+	size_t expect_len;
+	FILE *f;
+	struct lk_ctx *ctx;
+
+	ctx = lk_init();
+	lk_set_log_fn(ctx, NULL, NULL);
+
+	for (i = 1; i < 128; i++) {
+		lk_add_key(ctx, 0, i, K(KT_LATIN, i));
+		lk_add_key(ctx, 1, i, K(KT_LETTER, i));
+		lk_add_key(ctx, 4, i, (i % 3) ? K_HOLE : (0x20ac ^ 0xf000));
+	}
+
+	f = tmpfile();
+	if (!f)
+		kbd_error(EXIT_FAILURE, 0, "Unable to create temporary file: %s", strerror(errno));
+
+	lk_dump_keys(ctx, f, LK_SHAPE_FULL_TABLE, 0);
+
+	rewind(f);
+	expect_len = fread(expect, 1, sizeof(expect), f);
+	fclose(f);
+
+	/* the second call must reuse the buffer and produce the same text */
+	for (i = 0; i < 2; i++) {
+		len = lk_dump_keys_to_buffer(ctx, &buf, &size, LK_SHAPE_FULL_TABLE, 0);
+
+		if (len < 0)
+			kbd_error(EXIT_FAILURE, 0, "Unable to dump keys to buffer");
+
+		if ((size_t) len != expect_len || memcmp(buf, expect, expect_len) || buf[len])
+			kbd_error(EXIT_FAILURE, 0, "Unexpected buffer contents");
+	}
+
+	free(buf);
+	lk_free(ctx);
+
+	return EXIT_SUCCESS;
+}
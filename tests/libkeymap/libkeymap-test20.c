@@ -0,0 +1,70 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+
+#include <keymap.h>
+#include "libcommon.h"
+
+int
+main(int argc KBD_ATTR_UNUSED, char **argv)
+{
+	set_progname(argv[0]);
+
+	int i;
+	const char *s;
+	struct lk_ctx *ctx;
+	struct lk_frozen_keymap *km;
+
+	ctx = lk_init();
+	lk_set_log_fn(ctx, NULL, NULL);
+
+	if (lk_set_charset(ctx, "iso-8859-2") != 0)
+		kbd_error(EXIT_FAILURE, 0, "Unable to set charset");
+
+	for (i = 1; i < 64; i++) {
+		lk_add_key(ctx, 0, i, K(KT_LATIN, 'a' + i % 26));
+		lk_add_key(ctx, 2, i, K(KT_LATIN, 'A' + i % 26));
+	}
+	lk_add_key(ctx, 0, 100, 0x20ac ^ 0xf000);
+
+	km = lk_keymap_freeze(ctx);
+	if (!km)
+		kbd_error(EXIT_FAILURE, 0, "Unable to freeze keymap");
+
+	/* the frozen keymap must not depend on the context */
+	lk_free(ctx);
+
+	if (!lk_frozen_map_exists(km, 0) || lk_frozen_map_exists(km, 1) || !lk_frozen_map_exists(km, 2))
+		kbd_error(EXIT_FAILURE, 0, "Unexpected tables");
+
+	for (i = 1; i < 64; i++) {
+		if (lk_frozen_get_key(km, 0, i) != K(KT_LATIN, 'a' + i % 26) ||
+		    lk_frozen_get_key(km, 2, i) != K(KT_LATIN, 'A' + i % 26))
+			kbd_error(EXIT_FAILURE, 0, "Unexpected key %d", i);
+	}
+
+	if (lk_frozen_get_key(km, 0, 200) != K_HOLE)
+		kbd_error(EXIT_FAILURE, 0, "Expected a hole");
+
+	if (lk_frozen_get_key(km, 1, 10) != -1)
+		kbd_error(EXIT_FAILURE, 0, "Expected a missing table");
+
+	s = lk_frozen_code_to_ksym(km, lk_frozen_get_key(km, 0, 1));
+	if (!s || strcmp(s, "b"))
+		kbd_error(EXIT_FAILURE, 0, "Unexpected ksym: %s", s);
+
+	s = lk_frozen_code_to_ksym(km, lk_frozen_get_key(km, 0, 100));
+	if (!s || strcmp(s, "euro"))
+		kbd_error(EXIT_FAILURE, 0, "Unexpected ksym: %s", s);
+
+	/* 0xa3 is Lstroke in iso-8859-2 */
+	s = lk_frozen_code_to_ksym(km, K(KT_LATIN, 0xa3));
+	if (!s || strcmp(s, "Lstroke"))
+		kbd_error(EXIT_FAILURE, 0, "Unexpected ksym: %s", s);
+
+	lk_frozen_unref(lk_frozen_ref(km));
+	lk_frozen_unref(km);
+
+	return EXIT_SUCCESS;
+}
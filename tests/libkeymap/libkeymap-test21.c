@@ -0,0 +1,169 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+
+#include <keymap.h>
+#include "libcommon.h"
+
+#define KEY_A     30
+#define KEY_E     18
+#define KEY_ACUTE 40
+#define KEY_SHIFT 42
+#define KEY_ALT   56
+#define KEY_SPACE 57
+#define KEY_CAPS  58
+#define KEY_F1    59
+#define KEY_NUM   69
+
+static void
+expect(struct lk_translator *tr, int keycode, int down, const char *str)
+{
+	char buf[LK_TRANSLATE_BUFSIZE];
+	int len = lk_translate(tr, keycode, down, buf, sizeof(buf));
+
+	if (len < 0 || (size_t) len != strlen(str) || memcmp(buf, str, (size_t) len))
+		kbd_error(EXIT_FAILURE, 0, "Unexpected output for key %d (%d)", keycode, down);
+}
+
+static void
+type(struct lk_translator *tr, int keycode, const char *str)
+{
+	expect(tr, keycode, 1, str);
+	expect(tr, keycode, 0, "");
+}
+
+int
+main(int argc KBD_ATTR_UNUSED, char **argv)
+{
+	set_progname(argv[0]);
+
+	struct lk_ctx *ctx;
+	struct lk_translator *tr;
+	struct kbsentry kbs;
+	struct lk_kbdiacr dcr;
+	char buf[4];
+	int t;
+	const int tables[] = { 0, 1, 8 };
+
+	ctx = lk_init();
+	lk_set_log_fn(ctx, NULL, NULL);
+
+	/* plain, Shift and Alt, but no Shift+Alt table */
+	for (t = 0; t < 3; t++) {
+		lk_add_key(ctx, tables[t], KEY_SHIFT, K_SHIFT);
+		lk_add_key(ctx, tables[t], KEY_ALT, K_ALT);
+	}
+
+	lk_add_key(ctx, 0, KEY_A, K(KT_LETTER, 'a'));
+	lk_add_key(ctx, 1, KEY_A, K(KT_LETTER, 'A'));
+	lk_add_key(ctx, 8, KEY_A, K(KT_META, 'a'));
+	lk_add_key(ctx, 0, KEY_E, K(KT_LETTER, 'e'));
+	lk_add_key(ctx, 1, KEY_E, K(KT_LETTER, 'E'));
+	lk_add_key(ctx, 0, KEY_ACUTE, K_DACUTE);
+	lk_add_key(ctx, 0, KEY_SPACE, ' ');
+	lk_add_key(ctx, 0, KEY_CAPS, K_CAPS);
+	lk_add_key(ctx, 0, KEY_F1, K_F1);
+	lk_add_key(ctx, 0, KEY_NUM, K_NUM);
+
+	kbs.kb_func = KVAL(K_F1);
+	strcpy((char *) kbs.kb_string, "\033[[A");
+	lk_add_func(ctx, &kbs);
+
+	dcr.diacr  = '\'';
+	dcr.base   = 'e';
+	dcr.result = 0xe9;
+	lk_append_diacr(ctx, &dcr);
+
+	/* the kernel uses the first of duplicate entries */
+	dcr.result = 'x';
+	lk_add_diacr(ctx, 1, &dcr);
+
+	/* an entry after a hole in the accent table */
+	dcr.base   = 'E';
+	dcr.result = 0xc9;
+	lk_add_diacr(ctx, 3, &dcr);
+
+	tr = lk_translator_new(ctx, 0);
+	if (!tr)
+		kbd_error(EXIT_FAILURE, 0, "Unable to create translator");
+
+	type(tr, KEY_A, "a");
+
+	expect(tr, KEY_SHIFT, 1, "");
+	if (lk_translator_get_table(tr) != 1)
+		kbd_error(EXIT_FAILURE, 0, "Shift is not pressed");
+	type(tr, KEY_A, "A");
+	expect(tr, KEY_SHIFT, 0, "");
+
+	type(tr, KEY_CAPS, "");
+	if (lk_translator_get_leds(tr) != LED_CAP)
+		kbd_error(EXIT_FAILURE, 0, "CapsLock is not on");
+	type(tr, KEY_A, "A");
+	type(tr, KEY_CAPS, "");
+	type(tr, KEY_A, "a");
+
+	/* autorepeat does not toggle NumLock again */
+	expect(tr, KEY_NUM, 1, "");
+	expect(tr, KEY_NUM, 2, "");
+	expect(tr, KEY_NUM, 0, "");
+	if (lk_translator_get_leds(tr) != LED_NUM)
+		kbd_error(EXIT_FAILURE, 0, "NumLock is not on");
+	type(tr, KEY_NUM, "");
+	if (lk_translator_get_leds(tr) != 0)
+		kbd_error(EXIT_FAILURE, 0, "NumLock is not off");
+
+	type(tr, KEY_ACUTE, "");
+	type(tr, KEY_E, "\xe9");
+	type(tr, KEY_ACUTE, "");
+	expect(tr, KEY_SHIFT, 1, "");
+	type(tr, KEY_E, "\xc9");
+	expect(tr, KEY_SHIFT, 0, "");
+	type(tr, KEY_ACUTE, "");
+	type(tr, KEY_SPACE, "'");
+	type(tr, KEY_ACUTE, "");
+	type(tr, KEY_A, "'a");
+
+	type(tr, KEY_F1, "\033[[A");
+
+	expect(tr, KEY_ALT, 1, "");
+	type(tr, KEY_A, "\xe1");
+
+	/* Shift+Alt has no table, the state is computed from the pressed keys */
+	expect(tr, KEY_SHIFT, 1, "");
+	if (lk_translator_get_table(tr) != 9)
+		kbd_error(EXIT_FAILURE, 0, "Shift+Alt is not pressed");
+	type(tr, KEY_A, "");
+	expect(tr, KEY_ALT, 0, "");
+	if (lk_translator_get_table(tr) != 1)
+		kbd_error(EXIT_FAILURE, 0, "Unexpected table %d", lk_translator_get_table(tr));
+	expect(tr, KEY_SHIFT, 0, "");
+
+	/* the output is truncated, but its full length is reported */
+	if (lk_translate(tr, KEY_F1, 1, buf, 2) != 4 || memcmp(buf, "\033[", 2))
+		kbd_error(EXIT_FAILURE, 0, "Unexpected truncated output");
+	expect(tr, KEY_F1, 0, "");
+
+	if (lk_translate(tr, NR_KEYS, 1, buf, sizeof(buf)) != -1)
+		kbd_error(EXIT_FAILURE, 0, "Keycode out of range accepted");
+
+	lk_translator_free(tr);
+
+	tr = lk_translator_new(ctx, LK_TRANSLATE_UNICODE | LK_TRANSLATE_META_ESC);
+	if (!tr)
+		kbd_error(EXIT_FAILURE, 0, "Unable to create translator");
+
+	/* the context is no longer needed */
+	lk_free(ctx);
+
+	type(tr, KEY_ACUTE, "");
+	type(tr, KEY_E, "\xc3\xa9");
+
+	expect(tr, KEY_ALT, 1, "");
+	type(tr, KEY_A, "\033a");
+	expect(tr, KEY_ALT, 0, "");
+
+	lk_translator_free(tr);
+
+	return EXIT_SUCCESS;
+}
@@ -0,0 +1,85 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+
+#include <keymap.h>
+#include "libcommon.h"
+
+static void
+append(struct lk_ctx *ctx, unsigned int diacr, unsigned int base, unsigned int result)
+{
+	struct lk_kbdiacr dcr;
+
+	dcr.diacr  = diacr;
+	dcr.base   = base;
+	dcr.result = result;
+
+	if (lk_append_diacr(ctx, &dcr) != 0)
+		kbd_error(EXIT_FAILURE, 0, "Unable to add diacr");
+}
+
+static int
+find(struct lk_ctx *ctx, unsigned int diacr, unsigned int base, unsigned int *result)
+{
+	struct lk_kbdiacr dcr;
+	int i;
+
+	dcr.diacr  = diacr;
+	dcr.base   = base;
+	dcr.result = 0;
+
+	i = lk_find_compose(ctx, &dcr);
+	*result = dcr.result;
+
+	return i;
+}
+
+int
+main(int argc KBD_ATTR_UNUSED, char **argv)
+{
+	set_progname(argv[0]);
+
+	unsigned int i, result;
+	struct lk_ctx *ctx;
+
+	ctx = lk_init();
+	lk_set_log_fn(ctx, NULL, NULL);
+
+	if (find(ctx, '\'', 'e', &result) != -1)
+		kbd_error(EXIT_FAILURE, 0, "Found an entry in an empty table");
+
+	append(ctx, '\'', 'e', 1);
+	append(ctx, '`', 'e', 2);
+	append(ctx, '\'', 'e', 3);
+
+	if (lk_diacr_exists(ctx, 2))
+		kbd_error(EXIT_FAILURE, 0, "Duplicate entry was appended");
+
+	if (find(ctx, '\'', 'e', &result) != 0 || result != 3)
+		kbd_error(EXIT_FAILURE, 0, "The last definition must win");
+
+	if (find(ctx, '`', 'e', &result) != 1 || result != 2)
+		kbd_error(EXIT_FAILURE, 0, "Unable to find entry");
+
+	if (find(ctx, '^', 'e', &result) != -1)
+		kbd_error(EXIT_FAILURE, 0, "Found a missing entry");
+
+	if (lk_del_diacr(ctx, 1) != 0)
+		kbd_error(EXIT_FAILURE, 0, "Unable to remove entry");
+
+	if (find(ctx, '`', 'e', &result) != -1)
+		kbd_error(EXIT_FAILURE, 0, "Found a removed entry");
+
+	for (i = 0; i < MAX_DIACR + 10; i++)
+		append(ctx, 0x300 + i / 64, 0x41 + i % 64, i);
+
+	for (i = 0; i < MAX_DIACR + 10; i++) {
+		if (find(ctx, 0x300 + i / 64, 0x41 + i % 64, &result) < 0 || result != i)
+			kbd_error(EXIT_FAILURE, 0, "Unable to find entry %u", i);
+	}
+
+	lk_free(ctx);
+
+	return EXIT_SUCCESS;
+}
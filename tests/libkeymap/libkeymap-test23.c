@@ -0,0 +1,91 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+
+#include <keymap.h>
+#include "libcommon.h"
+
+static const struct lk_console_ops fake_ops = {
+	.ioctl = kbd_fake_console_ioctl,
+};
+
+int
+main(int argc KBD_ATTR_UNUSED, char **argv)
+{
+	set_progname(argv[0]);
+
+	int i;
+	struct lk_ctx *ctx;
+	struct kbd_fake_console *con;
+	struct kbsentry kbs;
+	struct lk_kbdiacr dcr;
+
+	con = kbd_fake_console_new();
+	if (!con)
+		kbd_error(EXIT_FAILURE, 0, "Unable to create fake console");
+
+	ctx = lk_init();
+	lk_set_log_fn(ctx, NULL, NULL);
+
+	if (lk_set_console_ops(ctx, &fake_ops, con) != 0)
+		kbd_error(EXIT_FAILURE, 0, "Unable to set console ops");
+
+	for (i = 1; i < 128; i++) {
+		lk_add_key(ctx, 0, i, K(KT_LATIN, 'a' + i % 26));
+		lk_add_key(ctx, 1, i, K(KT_LATIN, 'A' + i % 26));
+	}
+
+	kbs.kb_func = 0;
+	strcpy((char *) kbs.kb_string, "\033[[A");
+	lk_add_func(ctx, &kbs);
+
+	dcr.diacr  = '\'';
+	dcr.base   = 'e';
+	dcr.result = 0xe9;
+	lk_append_diacr(ctx, &dcr);
+
+	if (lk_load_keymap(ctx, 0, K_XLATE) != 0)
+		kbd_error(EXIT_FAILURE, 0, "Unable to load keymap");
+
+	if (kbd_fake_console_calls(con, KDSKBENT) != 2 * 127 ||
+	    kbd_fake_console_calls(con, KDSKBSENT) != 1 ||
+	    kbd_fake_console_calls(con, KDSKBDIACR) != 1)
+		kbd_error(EXIT_FAILURE, 0, "Unexpected number of calls");
+
+	lk_free(ctx);
+
+	/* read the keymap back from the fake console */
+	ctx = lk_init();
+	lk_set_log_fn(ctx, NULL, NULL);
+	lk_set_console_ops(ctx, &fake_ops, con);
+
+	kbd_fake_console_reset_calls(con);
+
+	if (lk_kernel_keymap(ctx, 0) != 0)
+		kbd_error(EXIT_FAILURE, 0, "Unable to read keymap");
+
+	if (kbd_fake_console_calls(con, 0) == 0 || kbd_fake_console_failures(con) != 0)
+		kbd_error(EXIT_FAILURE, 0, "Unexpected calls");
+
+	if (!lk_map_exists(ctx, 1) || lk_map_exists(ctx, 2))
+		kbd_error(EXIT_FAILURE, 0, "Unexpected tables");
+
+	for (i = 1; i < 128; i++) {
+		if (lk_get_key(ctx, 0, i) != K(KT_LATIN, 'a' + i % 26) ||
+		    lk_get_key(ctx, 1, i) != K(KT_LATIN, 'A' + i % 26))
+			kbd_error(EXIT_FAILURE, 0, "Unexpected key %d", i);
+	}
+
+	kbs.kb_func = 0;
+	if (lk_get_func(ctx, &kbs) != 0 || strcmp((char *) kbs.kb_string, "\033[[A"))
+		kbd_error(EXIT_FAILURE, 0, "Unexpected function string");
+
+	if (lk_get_diacr(ctx, 0, &dcr) != 0 || dcr.diacr != '\'' || dcr.base != 'e' || dcr.result != 0xe9)
+		kbd_error(EXIT_FAILURE, 0, "Unexpected compose definition");
+
+	lk_free(ctx);
+	kbd_fake_console_free(con);
+
+	return EXIT_SUCCESS;
+}
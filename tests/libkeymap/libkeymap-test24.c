@@ -0,0 +1,203 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <stdint.h>
+
+#include <keymap.h>
+#include "libcommon.h"
+
+static const struct lk_console_ops fake_ops = {
+	.ioctl = kbd_fake_console_ioctl,
+};
+
+static struct lk_ctx *
+fake_ctx(struct kbd_fake_console *con)
+{
+	struct lk_ctx *ctx = lk_init();
+
+	if (!ctx)
+		kbd_error(EXIT_FAILURE, 0, "Unable to create context");
+
+	lk_set_log_fn(ctx, NULL, NULL);
+
+	if (lk_set_console_ops(ctx, &fake_ops, con) != 0)
+		kbd_error(EXIT_FAILURE, 0, "Unable to set console ops");
+
+	return ctx;
+}
+
+static void
+load(struct kbd_fake_console *con, unsigned short first, const char *func)
+{
+	struct lk_ctx *ctx = fake_ctx(con);
+	struct kbsentry kbs;
+	int i;
+
+	for (i = 1; i < 128; i++) {
+		lk_add_key(ctx, 0, i, K(KT_LATIN, first + i % 26));
+		lk_add_key(ctx, 1, i, K(KT_LATIN, 'A' + i % 26));
+	}
+
+	kbs.kb_func = 0;
+	strcpy((char *) kbs.kb_string, func);
+	lk_add_func(ctx, &kbs);
+
+	if (lk_load_keymap(ctx, 0, K_XLATE) != 0)
+		kbd_error(EXIT_FAILURE, 0, "Unable to load keymap");
+
+	lk_free(ctx);
+}
+
+int
+main(int argc KBD_ATTR_UNUSED, char **argv)
+{
+	set_progname(argv[0]);
+
+	struct lk_ctx *ctx;
+	struct kbd_fake_console *con;
+	struct kbentry ke;
+	FILE *fp;
+
+	con = kbd_fake_console_new();
+	if (!con)
+		kbd_error(EXIT_FAILURE, 0, "Unable to create fake console");
+
+	load(con, 'a', "\033[[A");
+
+	fp = tmpfile();
+	if (!fp)
+		kbd_error(EXIT_FAILURE, errno, "tmpfile");
+
+	ctx = fake_ctx(con);
+
+	if (lk_kernel_snapshot(ctx, 0, fp) != 0)
+		kbd_error(EXIT_FAILURE, 0, "Unable to take snapshot");
+
+	/* restoring an unchanged console must not write anything */
+	kbd_fake_console_reset_calls(con);
+	rewind(fp);
+
+	if (lk_kernel_restore(ctx, 0, fp) != 0)
+		kbd_error(EXIT_FAILURE, 0, "Unable to restore snapshot");
+
+	if (kbd_fake_console_calls(con, KDSKBENT) != 0 ||
+	    kbd_fake_console_calls(con, KDSKBSENT) != 0 ||
+	    kbd_fake_console_calls(con, KDSKBDIACRUC) != 0 ||
+	    kbd_fake_console_calls(con, KDSKBMETA) != 0)
+		kbd_error(EXIT_FAILURE, 0, "Unchanged state was written");
+
+	/* change the plain table and the string, and add a table */
+	load(con, 'b', "\033[[B");
+
+	ke.kb_table = 2;
+	ke.kb_index = 1;
+	ke.kb_value = K(KT_LATIN, 'x');
+	if (kbd_fake_console_ioctl(con, 0, KDSKBENT, (unsigned long) &ke) != 0)
+		kbd_error(EXIT_FAILURE, 0, "Unable to add table");
+
+	kbd_fake_console_reset_calls(con);
+	rewind(fp);
+
+	if (lk_kernel_restore(ctx, 0, fp) != 0)
+		kbd_error(EXIT_FAILURE, 0, "Unable to restore snapshot");
+
+	/* 127 keys of the plain table, the string and the extra table */
+	if (kbd_fake_console_calls(con, KDSKBENT) != 127 + 1 ||
+	    kbd_fake_console_calls(con, KDSKBSENT) != 1 ||
+	    kbd_fake_console_failures(con) != 0)
+		kbd_error(EXIT_FAILURE, 0, "Unexpected number of calls");
+
+	lk_free(ctx);
+	fclose(fp);
+
+	/* read the keymap back from the fake console */
+	ctx = fake_ctx(con);
+
+	if (lk_kernel_keymap(ctx, 0) != 0)
+		kbd_error(EXIT_FAILURE, 0, "Unable to read keymap");
+
+	if (!lk_map_exists(ctx, 1) || lk_map_exists(ctx, 2))
+		kbd_error(EXIT_FAILURE, 0, "Unexpected tables");
+
+	for (int i = 1; i < 128; i++) {
+		if (lk_get_key(ctx, 0, i) != K(KT_LATIN, 'a' + i % 26) ||
+		    lk_get_key(ctx, 1, i) != K(KT_LATIN, 'A' + i % 26))
+			kbd_error(EXIT_FAILURE, 0, "Unexpected key %d", i);
+	}
+
+	struct kbsentry kbs;
+
+	kbs.kb_func = 0;
+	if (lk_get_func(ctx, &kbs) != 0 || strcmp((char *) kbs.kb_string, "\033[[A"))
+		kbd_error(EXIT_FAILURE, 0, "Unexpected function string");
+
+	lk_free(ctx);
+
+	/* a Unicode keysym is captured in K_RAW mode as well */
+	if (kbd_fake_console_ioctl(con, 0, KDSKBMODE, K_UNICODE) != 0)
+		kbd_error(EXIT_FAILURE, 0, "Unable to switch to Unicode mode");
+
+	ke.kb_table = 0;
+	ke.kb_index = 1;
+	ke.kb_value = 0xf3a9;
+	if (kbd_fake_console_ioctl(con, 0, KDSKBENT, (unsigned long) &ke) != 0)
+		kbd_error(EXIT_FAILURE, 0, "Unable to set Unicode key");
+
+	if (kbd_fake_console_ioctl(con, 0, KDSKBMODE, K_RAW) != 0)
+		kbd_error(EXIT_FAILURE, 0, "Unable to switch to raw mode");
+
+	fp = tmpfile();
+	if (!fp)
+		kbd_error(EXIT_FAILURE, errno, "tmpfile");
+
+	ctx = fake_ctx(con);
+
+	if (lk_kernel_snapshot(ctx, 0, fp) != 0)
+		kbd_error(EXIT_FAILURE, 0, "Unable to take snapshot");
+
+	int mode;
+
+	if (kbd_fake_console_ioctl(con, 0, KDGKBMODE, (unsigned long) &mode) != 0 || mode != K_RAW)
+		kbd_error(EXIT_FAILURE, 0, "Keyboard mode was not returned");
+
+	/* overwrite the key and get it back from the snapshot */
+	load(con, 'a', "\033[[A");
+
+	rewind(fp);
+
+	if (lk_kernel_restore(ctx, 0, fp) != 0)
+		kbd_error(EXIT_FAILURE, 0, "Unable to restore snapshot");
+
+	if (kbd_fake_console_ioctl(con, 0, KDSKBMODE, K_UNICODE) != 0)
+		kbd_error(EXIT_FAILURE, 0, "Unable to switch to Unicode mode");
+
+	ke.kb_table = 0;
+	ke.kb_index = 1;
+	if (kbd_fake_console_ioctl(con, 0, KDGKBENT, (unsigned long) &ke) != 0 || ke.kb_value != 0xf3a9)
+		kbd_error(EXIT_FAILURE, 0, "Unicode key was not restored");
+
+	/* snapshots with an unknown keyboard or meta mode are refused */
+	for (long off = 8; off <= 12; off += 4) {
+		uint32_t orig, bad = 42;
+
+		if (fseek(fp, off, SEEK_SET) || fread(&orig, sizeof(orig), 1, fp) != 1 ||
+		    fseek(fp, off, SEEK_SET) || fwrite(&bad, sizeof(bad), 1, fp) != 1)
+			kbd_error(EXIT_FAILURE, errno, "Unable to damage snapshot");
+
+		kbd_fake_console_reset_calls(con);
+		rewind(fp);
+
+		if (lk_kernel_restore(ctx, 0, fp) == 0 || kbd_fake_console_calls(con, 0) != 0)
+			kbd_error(EXIT_FAILURE, 0, "Bad mode at offset %ld was accepted", off);
+
+		if (fseek(fp, off, SEEK_SET) || fwrite(&orig, sizeof(orig), 1, fp) != 1)
+			kbd_error(EXIT_FAILURE, errno, "Unable to repair snapshot");
+	}
+
+	lk_free(ctx);
+	fclose(fp);
+	kbd_fake_console_free(con);
+
+	return EXIT_SUCCESS;
+}
@@ -0,0 +1,128 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <keymap.h>
+#include "libcommon.h"
+
+static const struct lk_console_ops fake_ops = {
+	.ioctl = kbd_fake_console_ioctl,
+};
+
+int
+main(int argc KBD_ATTR_UNUSED, char **argv)
+{
+	set_progname(argv[0]);
+
+	int i;
+	struct lk_ctx *ctx;
+	struct kbd_fake_console *con;
+	struct lk_kernel_keys_filter filter;
+
+	con = kbd_fake_console_new();
+	if (!con)
+		kbd_error(EXIT_FAILURE, 0, "Unable to create fake console");
+
+	ctx = lk_init();
+	lk_set_log_fn(ctx, NULL, NULL);
+
+	if (lk_set_console_ops(ctx, &fake_ops, con) != 0)
+		kbd_error(EXIT_FAILURE, 0, "Unable to set console ops");
+
+	for (i = 1; i < 128; i++) {
+		lk_add_key(ctx, 0, i, K(KT_LATIN, 'a' + i % 26));
+		lk_add_key(ctx, 1, i, K(KT_LATIN, 'A' + i % 26));
+		lk_add_key(ctx, 4, i, K(KT_LATIN, 'a' + i % 26));
+	}
+
+	if (lk_load_keymap(ctx, 0, K_XLATE) != 0)
+		kbd_error(EXIT_FAILURE, 0, "Unable to load keymap");
+
+	lk_free(ctx);
+
+	/* everything: one probe per table and the rest of the allocated ones */
+	ctx = lk_init();
+	lk_set_log_fn(ctx, NULL, NULL);
+	lk_set_console_ops(ctx, &fake_ops, con);
+
+	kbd_fake_console_reset_calls(con);
+
+	if (lk_kernel_keys_filtered(ctx, 0, NULL) != 0)
+		kbd_error(EXIT_FAILURE, 0, "Unable to read keymap");
+
+	if (kbd_fake_console_calls(con, KDGKBENT) != MAX_NR_KEYMAPS + 3 * (NR_KEYS - 1))
+		kbd_error(EXIT_FAILURE, 0, "Unexpected number of KDGKBENT: %lu",
+		          kbd_fake_console_calls(con, KDGKBENT));
+
+	lk_free(ctx);
+
+	/* keycode 0 only, as dumpkeys does for the summary */
+	ctx = lk_init();
+	lk_set_log_fn(ctx, NULL, NULL);
+	lk_set_console_ops(ctx, &fake_ops, con);
+
+	lk_kernel_keys_filter_init(&filter);
+	filter.last = 0;
+
+	kbd_fake_console_reset_calls(con);
+
+	if (lk_kernel_keys_filtered(ctx, 0, &filter) != 0)
+		kbd_error(EXIT_FAILURE, 0, "Unable to read keymap");
+
+	if (kbd_fake_console_calls(con, KDGKBENT) != MAX_NR_KEYMAPS)
+		kbd_error(EXIT_FAILURE, 0, "Unexpected number of KDGKBENT: %lu",
+		          kbd_fake_console_calls(con, KDGKBENT));
+
+	if (!lk_map_exists(ctx, 0) || !lk_map_exists(ctx, 1) || !lk_map_exists(ctx, 4) ||
+	    lk_map_exists(ctx, 2))
+		kbd_error(EXIT_FAILURE, 0, "Unexpected tables");
+
+	lk_free(ctx);
+
+	/* two tables and a keycode range */
+	ctx = lk_init();
+	lk_set_log_fn(ctx, NULL, NULL);
+	lk_set_console_ops(ctx, &fake_ops, con);
+
+	memset(filter.tables, 0, sizeof(filter.tables));
+	LK_FILTER_SET_TABLE(&filter, 1);
+	LK_FILTER_SET_TABLE(&filter, 2);
+	filter.first = 16;
+	filter.last  = 31;
+
+	kbd_fake_console_reset_calls(con);
+
+	if (lk_kernel_keys_filtered(ctx, 0, &filter) != 0)
+		kbd_error(EXIT_FAILURE, 0, "Unable to read keymap");
+
+	/* table 2 is not allocated and costs only the probe */
+	if (kbd_fake_console_calls(con, KDGKBENT) != 2 + 16)
+		kbd_error(EXIT_FAILURE, 0, "Unexpected number of KDGKBENT: %lu",
+		          kbd_fake_console_calls(con, KDGKBENT));
+
+	if (lk_map_exists(ctx, 0) || !lk_map_exists(ctx, 1) || lk_map_exists(ctx, 2))
+		kbd_error(EXIT_FAILURE, 0, "Unexpected tables");
+
+	for (i = 16; i < 32; i++) {
+		if (lk_get_key(ctx, 1, i) != K(KT_LATIN, 'A' + i % 26))
+			kbd_error(EXIT_FAILURE, 0, "Unexpected key %d", i);
+	}
+
+	/* an empty or out of range keycode range is refused */
+	filter.first = 32;
+	filter.last  = 31;
+
+	if (lk_kernel_keys_filtered(ctx, 0, &filter) == 0)
+		kbd_error(EXIT_FAILURE, 0, "Invalid range was accepted");
+
+	filter.first = 0;
+	filter.last  = NR_KEYS;
+
+	if (lk_kernel_keys_filtered(ctx, 0, &filter) == 0)
+		kbd_error(EXIT_FAILURE, 0, "Invalid range was accepted");
+
+	lk_free(ctx);
+	kbd_fake_console_free(con);
+
+	return EXIT_SUCCESS;
+}
@@ -0,0 +1,159 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+
+#include <keymap.h>
+#include "libcommon.h"
+
+#define NR_OUTPUTS 8
+
+static const lk_table_shape shapes[] = {
+	LK_SHAPE_DEFAULT,
+	LK_SHAPE_FULL_TABLE,
+	LK_SHAPE_SEPARATE_LINES,
+	LK_SHAPE_UNTIL_HOLE,
+};
+
+static struct lk_ctx *
+new_keymap(int variant)
+{
+	struct lk_ctx *ctx = lk_init();
+	struct kbsentry kbs;
+	int i;
+
+	if (!ctx)
+		kbd_error(EXIT_FAILURE, 0, "Unable to create context");
+
+	lk_set_log_fn(ctx, NULL, NULL);
+
+	for (i = 1; i < 128; i++) {
+		if (variant) {
+			/* letters with Meta on Alt, some holes and Unicode */
+			lk_add_key(ctx, 0, i, K(KT_LETTER, 'a' + i % 26));
+			lk_add_key(ctx, 1, i, K(KT_LETTER, 'A' + i % 26));
+			lk_add_key(ctx, 8, i, K(KT_META, 'a' + i % 26));
+			lk_add_key(ctx, 9, i, K(KT_META, 'A' + i % 26));
+			lk_add_key(ctx, 4, i, (i % 3) ? K_HOLE : (0x20ac ^ 0xf000));
+		} else {
+			lk_add_key(ctx, 0, i, K(KT_LATIN, i));
+			lk_add_key(ctx, 2, i, (i % 5) ? K(KT_FN, i % 20) : K_HOLE);
+		}
+	}
+
+	kbs.kb_func = 0;
+	strcpy((char *) kbs.kb_string, variant ? "\033[[A" : "\033[[B");
+	lk_add_func(ctx, &kbs);
+
+	return ctx;
+}
+
+static char *
+read_back(FILE *f)
+{
+	long len;
+	char *s;
+
+	if (fflush(f) || (len = ftell(f)) < 0)
+		kbd_error(EXIT_FAILURE, errno, "Unable to read temporary file");
+
+	s = calloc(1, (size_t) len + 1);
+	if (!s)
+		kbd_error(EXIT_FAILURE, errno, "calloc");
+
+	rewind(f);
+	if (fread(s, 1, (size_t) len, f) != (size_t) len)
+		kbd_error(EXIT_FAILURE, errno, "Unable to read temporary file");
+
+	fclose(f);
+	return s;
+}
+
+static FILE *
+new_file(void)
+{
+	FILE *f = tmpfile();
+
+	if (!f)
+		kbd_error(EXIT_FAILURE, errno, "Unable to create temporary file");
+	return f;
+}
+
+/* what lk_dump_keymap() prints, with the keys taken from the plan */
+static char *
+dump_with_plan(struct lk_ctx *ctx, const struct lk_dump_plan *plan,
+               lk_table_shape table, char numeric)
+{
+	FILE *f = new_file();
+
+	lk_dump_keymaps(ctx, f);
+	lk_dump_plan_keys(plan, f, table, numeric);
+	lk_dump_funcs(ctx, f);
+
+	return read_back(f);
+}
+
+static void
+check_plan(struct lk_ctx *ctx, const struct lk_dump_plan *plan, char **expect)
+{
+	size_t i;
+	char *s;
+
+	for (i = 0; i < NR_OUTPUTS; i++) {
+		s = dump_with_plan(ctx, plan, shapes[i / 2], (char) (i % 2));
+
+		if (strcmp(s, expect[i]))
+			kbd_error(EXIT_FAILURE, 0, "Plan output differs for shape %d, numeric %d",
+			          shapes[i / 2], (int) (i % 2));
+		free(s);
+	}
+}
+
+int
+main(int argc KBD_ATTR_UNUSED, char **argv)
+{
+	set_progname(argv[0]);
+
+	struct lk_ctx *ctx[2];
+	struct lk_dump_plan *plan[2];
+	char *expect[2][NR_OUTPUTS];
+	size_t i;
+	int k;
+	FILE *f;
+
+	for (k = 0; k < 2; k++) {
+		ctx[k] = new_keymap(k);
+
+		for (i = 0; i < NR_OUTPUTS; i++) {
+			f = new_file();
+			lk_dump_keymap(ctx[k], f, shapes[i / 2], (char) (i % 2));
+			expect[k][i] = read_back(f);
+		}
+
+		plan[k] = lk_dump_plan_new(ctx[k]);
+		if (!plan[k])
+			kbd_error(EXIT_FAILURE, 0, "Unable to build dump plan");
+	}
+
+	if (!strcmp(expect[0][0], expect[1][0]))
+		kbd_error(EXIT_FAILURE, 0, "The keymaps must differ");
+
+	/* each plan serves every shape of its own keymap */
+	for (k = 0; k < 2; k++)
+		check_plan(ctx[k], plan[k], expect[k]);
+
+	/* a plan is a copy, changing the keymap afterwards does not affect it */
+	for (i = 1; i < 128; i++)
+		lk_add_key(ctx[0], 0, (int) i, K(KT_LATIN, 'z'));
+
+	check_plan(ctx[0], plan[0], expect[0]);
+
+	for (k = 0; k < 2; k++) {
+		for (i = 0; i < NR_OUTPUTS; i++)
+			free(expect[k][i]);
+		lk_dump_plan_free(plan[k]);
+		lk_free(ctx[k]);
+	}
+
+	return EXIT_SUCCESS;
+}
@@ -0,0 +1,86 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/ioctl.h>
+
+#include <kfont.h>
+#include "libcommon.h"
+
+static const struct kfont_console_ops fake_ops = {
+	.ioctl = kbd_fake_console_ioctl,
+};
+
+static unsigned char buf[512 * 32 * 32 / 8];
+
+static unsigned int
+loaded_glyphs(struct kfont_context *ctx)
+{
+	unsigned int count = 512, width, height, vpitch;
+
+	if (kfont_get_font(ctx, 0, buf, &count, &width, &height, &vpitch) < 0)
+		kbd_error(EXIT_FAILURE, 0, "Unable to read font");
+
+	return count;
+}
+
+static unsigned short
+loaded_unimap_entries(struct kfont_context *ctx)
+{
+	struct unimapdesc ud;
+
+	if (kfont_get_unicodemap(ctx, 0, &ud) < 0)
+		kbd_error(EXIT_FAILURE, 0, "Unable to read unicode map");
+
+	free(ud.entries);
+	return ud.entry_ct;
+}
+
+int
+main(int argc KBD_ATTR_UNUSED, char **argv)
+{
+	set_progname(argv[0]);
+
+	struct kfont_context *ctx;
+	struct kbd_fake_console *con;
+	unsigned int count;
+	unsigned short entries;
+
+	const char *const files[] = {
+		TESTDIR "/data/consolefonts/UniCyrExt_8x16.psf",
+		TESTDIR "/data/consolefonts/UniCyrExt_8x16.psf",
+	};
+
+	con = kbd_fake_console_new();
+	if (!con)
+		kbd_error(EXIT_FAILURE, 0, "Unable to create fake console");
+
+	if (kfont_init(get_progname(), &ctx) < 0)
+		kbd_error(EXIT_FAILURE, 0, "Unable to create kfont context");
+
+	kfont_set_console_ops(ctx, &fake_ops, con);
+
+	if (kfont_load_fonts(ctx, 0, files, 1, 0, 0, 0, 0) < 0)
+		kbd_error(EXIT_FAILURE, 0, "Unable to load font");
+
+	count   = loaded_glyphs(ctx);
+	entries = loaded_unimap_entries(ctx);
+
+	/*
+	 * The second copy of the font only repeats glyphs of the first one,
+	 * so the merged font must be as large as a single copy and map the
+	 * same Unicode values.
+	 */
+	if (kfont_load_fonts(ctx, 0, files, 2, 0, 0, 0, 0) < 0)
+		kbd_error(EXIT_FAILURE, 0, "Unable to load merged fonts");
+
+	if (loaded_glyphs(ctx) != count)
+		kbd_error(EXIT_FAILURE, 0, "Duplicate glyphs were not merged");
+
+	if (loaded_unimap_entries(ctx) < entries)
+		kbd_error(EXIT_FAILURE, 0, "Unicode values were lost when merging");
+
+	kfont_free(ctx);
+	kbd_fake_console_free(con);
+
+	return EXIT_SUCCESS;
+}
@@ -0,0 +1,124 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/ioctl.h>
+#include <linux/kd.h>
+
+#include <kfont.h>
+#include "libcommon.h"
+
+static const struct kfont_console_ops fake_ops = {
+	.ioctl = kbd_fake_console_ioctl,
+};
+
+static unsigned long
+writes(struct kbd_fake_console *con)
+{
+	return kbd_fake_console_calls(con, PIO_UNIMAPCLR) +
+	       kbd_fake_console_calls(con, PIO_UNIMAP) +
+	       kbd_fake_console_calls(con, PIO_UNISCRNMAP) +
+	       kbd_fake_console_calls(con, PIO_CMAP);
+}
+
+int
+main(int argc KBD_ATTR_UNUSED, char **argv)
+{
+	set_progname(argv[0]);
+
+	struct kfont_context *ctx;
+	struct kbd_fake_console *con;
+	unsigned char *blob, *blob2;
+	size_t size, size2;
+	unsigned char cmap[3 * 16];
+
+	const char *const files[] = {
+		TESTDIR "/data/consolefonts/UniCyrExt_8x16.psf",
+	};
+
+	con = kbd_fake_console_new();
+	if (!con)
+		kbd_error(EXIT_FAILURE, 0, "Unable to create fake console");
+
+	if (kfont_init(get_progname(), &ctx) < 0)
+		kbd_error(EXIT_FAILURE, 0, "Unable to create kfont context");
+
+	kfont_set_logger(ctx, NULL);
+	kfont_set_console_ops(ctx, &fake_ops, con);
+
+	if (kfont_load_fonts(ctx, 0, files, 1, 0, 0, 0, 0) < 0)
+		kbd_error(EXIT_FAILURE, 0, "Unable to load font");
+
+	if (kfont_load_consolemap(ctx, 0, TESTDIR "/../data/consoletrans/8859-5_to_uni.trans") < 0)
+		kbd_error(EXIT_FAILURE, 0, "Unable to load screen map");
+
+	if (kfont_snapshot(ctx, 0, &blob, &size) < 0)
+		kbd_error(EXIT_FAILURE, 0, "Unable to take snapshot");
+
+	/* nothing has changed, so there is nothing to write */
+	kbd_fake_console_reset_calls(con);
+
+	if (kfont_restore(ctx, 0, blob, size) < 0)
+		kbd_error(EXIT_FAILURE, 0, "Unable to restore unchanged console");
+
+	if (writes(con))
+		kbd_error(EXIT_FAILURE, 0, "Restoring an unchanged console wrote %lu times",
+		          writes(con));
+
+	/* one read of each part and nothing else */
+	if (kbd_fake_console_calls(con, KDFONTOP) != 1 ||
+	    kbd_fake_console_calls(con, GIO_UNIMAP) != 1 ||
+	    kbd_fake_console_calls(con, GIO_UNISCRNMAP) != 1 ||
+	    kbd_fake_console_calls(con, GIO_CMAP) != 1 ||
+	    kbd_fake_console_calls(con, 0) != 4)
+		kbd_error(EXIT_FAILURE, 0, "Restoring an unchanged console took %lu ioctls",
+		          kbd_fake_console_calls(con, 0));
+
+	/* change every part of the state */
+	if (kfont_restore_font(ctx, 0) < 0)
+		kbd_error(EXIT_FAILURE, 0, "Unable to load default font");
+
+	if (kfont_load_unicodemap(ctx, 0, TESTDIR "/data/unimaps/cp866.uni") < 0)
+		kbd_error(EXIT_FAILURE, 0, "Unable to load unicode map");
+
+	if (kfont_load_consolemap(ctx, 0, TESTDIR "/../data/consoletrans/8859-2_to_uni.trans") < 0)
+		kbd_error(EXIT_FAILURE, 0, "Unable to load screen map");
+
+	memset(cmap, 0x55, sizeof(cmap));
+
+	if (kbd_fake_console_ioctl(con, 0, PIO_CMAP, (unsigned long) cmap) < 0)
+		kbd_error(EXIT_FAILURE, 0, "Unable to set palette");
+
+	kbd_fake_console_reset_calls(con);
+
+	if (kfont_restore(ctx, 0, blob, size) < 0)
+		kbd_error(EXIT_FAILURE, 0, "Unable to restore changed console");
+
+	if (!kbd_fake_console_calls(con, PIO_UNIMAP) ||
+	    kbd_fake_console_calls(con, PIO_UNISCRNMAP) != 1 ||
+	    kbd_fake_console_calls(con, PIO_CMAP) != 1)
+		kbd_error(EXIT_FAILURE, 0, "Changed parts were not restored");
+
+	/* the restored console must give the same snapshot */
+	if (kfont_snapshot(ctx, 0, &blob2, &size2) < 0)
+		kbd_error(EXIT_FAILURE, 0, "Unable to take second snapshot");
+
+	if (size != size2 || memcmp(blob, blob2, size))
+		kbd_error(EXIT_FAILURE, 0, "Restored console differs from the snapshot");
+
+	/* a damaged snapshot is refused */
+	blob[0] ^= 0xff;
+
+	if (kfont_restore(ctx, 0, blob, size) >= 0)
+		kbd_error(EXIT_FAILURE, 0, "Bad snapshot was accepted");
+
+	if (kfont_restore(ctx, 0, blob2, size2 - 1) >= 0)
+		kbd_error(EXIT_FAILURE, 0, "Truncated snapshot was accepted");
+
+	free(blob);
+	free(blob2);
+
+	kfont_free(ctx);
+	kbd_fake_console_free(con);
+
+	return EXIT_SUCCESS;
+}
@@ -0,0 +1,62 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/ioctl.h>
+#include <linux/kd.h>
+
+#include <kfont.h>
+#include "libcommon.h"
+
+static const struct kfont_console_ops fake_ops = {
+	.ioctl = kbd_fake_console_ioctl,
+};
+
+int
+main(int argc KBD_ATTR_UNUSED, char **argv)
+{
+	set_progname(argv[0]);
+
+	struct kfont_context *ctx;
+	struct kbd_fake_console *con;
+	unsigned short map[E_TABSZ];
+	const int fds[] = { 0, 0, 0 };
+
+	con = kbd_fake_console_new();
+	if (!con)
+		kbd_error(EXIT_FAILURE, 0, "Unable to create fake console");
+
+	if (kfont_init(get_progname(), &ctx) < 0)
+		kbd_error(EXIT_FAILURE, 0, "Unable to create kfont context");
+
+	kfont_set_logger(ctx, NULL);
+	kfont_set_console_ops(ctx, &fake_ops, con);
+
+	/* one parsed map is written to every console */
+	if (kfont_load_consolemap_multi(ctx, fds, 3, TESTDIR "/../data/consoletrans/8859-5_to_uni.trans") < 0)
+		kbd_error(EXIT_FAILURE, 0, "Unable to load screen map");
+
+	if (kbd_fake_console_calls(con, PIO_UNISCRNMAP) != 3 ||
+	    kbd_fake_console_calls(con, 0) != 3)
+		kbd_error(EXIT_FAILURE, 0, "Unexpected number of calls");
+
+	if (kfont_get_uniscrnmap(ctx, 0, map) < 0)
+		kbd_error(EXIT_FAILURE, 0, "Unable to read screen map");
+
+	/* CYRILLIC CAPITAL LETTER A */
+	if (map['A'] != 'A' || map[0xb0] != 0x0410)
+		kbd_error(EXIT_FAILURE, 0, "Unexpected screen map");
+
+	/* nothing is written when the map cannot be read */
+	kbd_fake_console_reset_calls(con);
+
+	if (kfont_load_consolemap_multi(ctx, fds, 3, TESTDIR "/data/does-not-exist.trans") >= 0)
+		kbd_error(EXIT_FAILURE, 0, "Missing screen map was loaded");
+
+	if (kbd_fake_console_calls(con, 0) != 0)
+		kbd_error(EXIT_FAILURE, 0, "Unexpected calls");
+
+	kfont_free(ctx);
+	kbd_fake_console_free(con);
+
+	return EXIT_SUCCESS;
+}
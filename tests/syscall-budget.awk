@@ -0,0 +1,89 @@
+#!/usr/bin/awk -f
+#
+# Usage: syscall-budget.awk <budget> <strace log>
+#
+# Counts the ioctls, file opens, forks and bytes read in a strace log and
+# fails if any of them exceeds the budget. The budget has one "<counter>
+# <limit>" pair per line, the counters are "ioctl", "open", "fork" and "read".
+#
+# The log is expected to be recorded without -f. Opens and reads of shared
+# libraries and locale files are not counted, since they depend on the system
+# rather than on the tool.
+
+FNR == NR {
+	if ($0 ~ /^[ \t]*(#|$)/)
+		next;
+	budget[$1] = $2;
+	next;
+}
+
+!/^[a-z0-9_]+\(/ {
+	next;
+}
+
+{
+	name = substr($0, 1, index($0, "(") - 1);
+
+	fd = -1;
+	if (match($0, /^[a-z0-9_]+\([0-9]+/))
+		fd = substr($0, length(name) + 2, RLENGTH - length(name) - 1) + 0;
+
+	rc = -1;
+	if (match($0, /\) += -?[0-9]+/)) {
+		s = substr($0, RSTART, RLENGTH);
+		rc = substr(s, index(s, "=") + 1) + 0;
+	}
+}
+
+name ~ /^open/ {
+	path = "";
+	if (match($0, /"[^"]*"/))
+		path = substr($0, RSTART + 1, RLENGTH - 2);
+
+	if (path ~ /(\.so(\.[0-9]+)*|\/ld\.so\.(cache|preload))$/ || path ~ /\/(locale|gconv)\//) {
+		if (rc >= 0)
+			ignored[rc] = 1;
+		next;
+	}
+
+	count["open"]++;
+	next;
+}
+
+name == "close" {
+	delete ignored[fd];
+	next;
+}
+
+name == "ioctl" {
+	count["ioctl"]++;
+	next;
+}
+
+name ~ /^(clone|clone3|fork|vfork)$/ {
+	count["fork"]++;
+	next;
+}
+
+name ~ /^p?readv?(64)?$/ {
+	if (rc > 0 && !(fd in ignored))
+		count["read"] += rc;
+	next;
+}
+
+END {
+	status = 0;
+
+	for (name in budget) {
+		value = count[name] + 0;
+
+		printf("%s %d (budget %d)\n", name, value, budget[name]);
+
+		if (value > budget[name] + 0) {
+			printf("%s: %d exceeds the budget of %d\n", name, value, budget[name]) > "/dev/stderr";
+			status = 1;
+		}
+	}
+
+	exit status;
+}